@@ -0,0 +1,63 @@
+#include "AccelerationStructure.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+
+// rough per-ray costs, in units of one primitive intersection test
+#define COST_INTERSECTION 1.0f
+#define COST_BVH_NODE 0.5f
+#define COST_GRID_STEP 0.2f
+#define BVH_LEAF_TESTS 4.0f
+
+AccelerationType Acceleration::Choose(size_t primitiveCount, const UniformGrid::Statistics &gridStatistics) {
+    float linearCost = COST_INTERSECTION * primitiveCount;
+
+    // a ray visits about two root to leaf paths and tests a few leaves
+    float bvhCost = COST_BVH_NODE * 2.0f * std::log2((float)primitiveCount + 1.0f) + COST_INTERSECTION * BVH_LEAF_TESTS;
+
+    // a ray crosses about one row of cells, but stops soon after meeting occupied cells; the primitives it tests
+    // come from the cells it stops in, which are the crowded ones
+    float gridCost = std::numeric_limits<float>::max();
+    if (gridStatistics.OccupiedCells > 0) {
+        const glm::ivec3 &resolution = gridStatistics.Resolution;
+        float occupancy = (float)gridStatistics.OccupiedCells / gridStatistics.CellCount;
+        float cellsAcross = (resolution.x + resolution.y + resolution.z) / 3.0f;
+        float cellsVisited = std::min(cellsAcross, 2.0f / occupancy);
+        float occupiedVisited = std::max(1.0f, cellsVisited * occupancy);
+
+        gridCost = COST_GRID_STEP * cellsVisited + COST_INTERSECTION * occupiedVisited * gridStatistics.HitCellPrimitives;
+    }
+
+    if (linearCost <= bvhCost && linearCost <= gridCost) {
+        return AccelerationType::Linear;
+    }
+    return gridCost < bvhCost ? AccelerationType::Grid : AccelerationType::BVH;
+}
+
+const char *Acceleration::ToString(AccelerationType type) {
+    switch (type) {
+    case AccelerationType::Auto:
+        return "auto";
+    case AccelerationType::Linear:
+        return "linear";
+    case AccelerationType::BVH:
+        return "bvh";
+    case AccelerationType::Grid:
+        return "grid";
+    }
+    return "unknown";
+}
+
+std::optional<AccelerationType> Acceleration::FromString(const std::string &name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    for (AccelerationType type : {AccelerationType::Auto, AccelerationType::Linear, AccelerationType::BVH, AccelerationType::Grid}) {
+        if (lower == ToString(type)) {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "UniformGrid.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/// Backend used to find the geometry hit by a ray.
+enum class AccelerationType {
+    Auto, // chosen from the scene content when it loads
+    Linear,
+    BVH,
+    Grid,
+};
+
+namespace Acceleration {
+/**
+ * Picks the backend with the lowest estimated per-ray cost.
+ * @param primitiveCount Number of bounded primitives.
+ * @param gridStatistics Statistics of a uniform grid built over those primitives.
+ */
+AccelerationType Choose(size_t primitiveCount, const UniformGrid::Statistics &gridStatistics);
+
+const char *ToString(AccelerationType type);
+std::optional<AccelerationType> FromString(const std::string &name);
+} // namespace Acceleration
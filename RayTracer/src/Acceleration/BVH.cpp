@@ -0,0 +1,127 @@
+#include "BVH.h"
+
+#include <algorithm>
+
+void BVH::Build(const std::vector<Bounds> &primitiveBounds, std::vector<uint32_t> primitiveIndices) {
+    m_Nodes.clear();
+    m_PrimitiveIndices = std::move(primitiveIndices);
+
+    if (m_PrimitiveIndices.empty()) {
+        return;
+    }
+
+    m_Nodes.reserve(2 * m_PrimitiveIndices.size());
+    BuildRecursive(primitiveBounds, 0, (uint32_t)m_PrimitiveIndices.size(), 0);
+}
+
+uint32_t BVH::BuildRecursive(const std::vector<Bounds> &primitiveBounds, uint32_t begin, uint32_t end, int depth) {
+    uint32_t nodeIndex = (uint32_t)m_Nodes.size();
+    m_Nodes.emplace_back();
+
+    Bounds nodeBounds;
+    Bounds centroidBounds;
+    for (uint32_t i = begin; i < end; i++) {
+        const Bounds &bounds = primitiveBounds[m_PrimitiveIndices[i]];
+        nodeBounds.Grow(bounds);
+        centroidBounds.Grow(bounds.Centroid());
+    }
+    m_Nodes[nodeIndex].NodeBounds = nodeBounds;
+
+    uint32_t count = end - begin;
+    int axis = centroidBounds.LargestAxis();
+    float axisMin = centroidBounds.Min[axis];
+    float axisExtent = centroidBounds.Max[axis] - axisMin;
+
+    auto makeLeaf = [&]() {
+        m_Nodes[nodeIndex].Offset = begin;
+        m_Nodes[nodeIndex].Count = count;
+        return nodeIndex;
+    };
+
+    // all centroids coincide, no split can separate them; the depth limit keeps the traversal stacks from overflowing
+    if (count <= 1 || axisExtent <= 0.0f || depth >= MAX_DEPTH - 1) {
+        return makeLeaf();
+    }
+
+    // binned SAH: place the centroids into buckets along the largest axis and evaluate the split between each pair
+    struct Bin {
+        Bounds BinBounds;
+        uint32_t Count = 0;
+    };
+    Bin bins[SAH_BINS];
+
+    auto binIndex = [&](const Bounds &bounds) {
+        int b = axisExtent > 0.0f ? (int)(SAH_BINS * (bounds.Centroid()[axis] - axisMin) / axisExtent) : 0;
+        return glm::clamp(b, 0, SAH_BINS - 1);
+    };
+
+    for (uint32_t i = begin; i < end; i++) {
+        const Bounds &bounds = primitiveBounds[m_PrimitiveIndices[i]];
+        Bin &bin = bins[binIndex(bounds)];
+        bin.BinBounds.Grow(bounds);
+        bin.Count++;
+    }
+
+    // sweep from the right to get the area and count to the right of each split
+    float rightArea[SAH_BINS];
+    uint32_t rightCount[SAH_BINS];
+    Bounds accumulated;
+    uint32_t accumulatedCount = 0;
+    for (int b = SAH_BINS - 1; b > 0; b--) {
+        accumulated.Grow(bins[b].BinBounds);
+        accumulatedCount += bins[b].Count;
+        rightArea[b] = accumulated.SurfaceArea();
+        rightCount[b] = accumulatedCount;
+    }
+
+    // sweep from the left and pick the cheapest split, cost is relative to the node area
+    float bestCost = std::numeric_limits<float>::max();
+    int bestSplit = -1;
+    accumulated = Bounds();
+    accumulatedCount = 0;
+    for (int b = 1; b < SAH_BINS; b++) {
+        accumulated.Grow(bins[b - 1].BinBounds);
+        accumulatedCount += bins[b - 1].Count;
+
+        if (accumulatedCount == 0 || rightCount[b] == 0) {
+            continue;
+        }
+
+        float cost = accumulated.SurfaceArea() * accumulatedCount + rightArea[b] * rightCount[b];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = b;
+        }
+    }
+
+    // traversal step costs about as much as one primitive test
+    float leafCost = (float)count;
+    float splitCost = 1.0f + bestCost / glm::max(nodeBounds.SurfaceArea(), std::numeric_limits<float>::min());
+
+    uint32_t middle;
+    if (bestSplit != -1 && (splitCost < leafCost || count > MAX_LEAF_SIZE)) {
+        uint32_t *first = m_PrimitiveIndices.data() + begin;
+        uint32_t *last = m_PrimitiveIndices.data() + end;
+        middle = (uint32_t)(std::partition(first, last,
+                                           [&](uint32_t primitive) {
+                                               return binIndex(primitiveBounds[primitive]) < bestSplit;
+                                           }) -
+                            m_PrimitiveIndices.data());
+    } else if (count <= MAX_LEAF_SIZE) {
+        return makeLeaf();
+    } else {
+        // no useful SAH split (e.g. all centroids in one bin), fall back to a median split
+        middle = begin + count / 2;
+        std::nth_element(m_PrimitiveIndices.begin() + begin, m_PrimitiveIndices.begin() + middle,
+                         m_PrimitiveIndices.begin() + end, [&](uint32_t a, uint32_t b) {
+                             return primitiveBounds[a].Centroid()[axis] < primitiveBounds[b].Centroid()[axis];
+                         });
+    }
+
+    m_Nodes[nodeIndex].Axis = (uint32_t)axis;
+    BuildRecursive(primitiveBounds, begin, middle, depth + 1);
+    uint32_t rightChild = BuildRecursive(primitiveBounds, middle, end, depth + 1);
+    m_Nodes[nodeIndex].Offset = rightChild;
+
+    return nodeIndex;
+}
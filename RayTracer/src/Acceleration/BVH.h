@@ -0,0 +1,208 @@
+#pragma once
+
+#include "../Geometry/Bounds.h"
+#include "../Geometry/Geometry.h"
+#include "../Ray.h"
+#include "../RayPacket.h"
+#include "../SIMD/Kernels.h"
+
+#include <cstdint>
+#include <vector>
+
+/// Bounding volume hierarchy built with the surface area heuristic. Primitives are referred to by index, the caller
+/// provides the intersection routine for a single primitive when traversing.
+class BVH {
+  public:
+    BVH() = default;
+
+    /**
+     * Builds the hierarchy over a subset of primitives.
+     * @param primitiveBounds Bounds of every primitive, indexed by primitive index.
+     * @param primitiveIndices Indices of the primitives to insert. Their bounds must be finite.
+     */
+    void Build(const std::vector<Bounds> &primitiveBounds, std::vector<uint32_t> primitiveIndices);
+
+    /**
+     * Finds the closest intersection along the ray.
+     * @param ray Ray to trace, its TMax is shrunk to every closer hit found.
+     * @param closestHit Closest intersection so far, updated if a closer one is found.
+     * @param intersect Callable taking a primitive index and returning the hit distance within the interval of the same
+     * ray, or a negative value on a miss.
+     * @return true if closestHit was updated.
+     */
+    template <typename IntersectFn> bool Intersect(Ray &ray, Intersection &closestHit, IntersectFn &&intersect) const {
+        return !m_Nodes.empty() && IntersectSubtree(0, ray, closestHit, intersect);
+    }
+
+    /**
+     * Finds the closest intersection of every ray of a packet. The packet descends together while at least two of its
+     * rays overlap a node; a ray left alone in a subtree finishes it as a single ray.
+     * @param packet Rays to trace, the interval of each ray is shrunk to every closer hit found.
+     * @param hits Closest intersection of each ray so far.
+     * @param intersectPacket Callable taking a primitive index and testing it against the packet, updating the packet's
+     * intervals and the hits.
+     * @param intersect Callable taking a primitive index and a ray, returning the hit distance within the ray's
+     * interval, or a negative value on a miss.
+     */
+    template <typename IntersectPacketFn, typename IntersectFn>
+    void Intersect(RayPacket &packet, Intersection *hits, IntersectPacketFn &&intersectPacket,
+                   IntersectFn &&intersect) const;
+
+    /**
+     * Checks if anything within the ray's interval is hit, stopping at the first hit found.
+     * @param ray Ray to trace.
+     * @param occluded Callable taking a primitive index and returning true if the primitive blocks the ray.
+     */
+    template <typename OccludedFn> bool Occluded(const Ray &ray, OccludedFn &&occluded) const;
+
+    bool IsEmpty() const { return m_Nodes.empty(); }
+    const Bounds &GetBounds() const { return m_Nodes.front().NodeBounds; }
+
+  private:
+    struct Node {
+        Bounds NodeBounds;
+        uint32_t Offset = 0; // index of the first primitive for leaves, index of the second child for interior nodes
+        uint32_t Count : 30; // number of primitives, 0 for interior nodes; wide enough that any node can be a leaf
+        uint32_t Axis : 2;   // split axis, used to order the traversal
+
+        Node() : Count(0), Axis(0) {}
+    };
+
+    uint32_t BuildRecursive(const std::vector<Bounds> &primitiveBounds, uint32_t begin, uint32_t end, int depth);
+    /// Intersect restricted to the subtree under the node.
+    template <typename IntersectFn>
+    bool IntersectSubtree(uint32_t root, Ray &ray, Intersection &closestHit, IntersectFn &&intersect) const;
+
+  private:
+    static constexpr int MAX_DEPTH = 64;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr int SAH_BINS = 16;
+
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_PrimitiveIndices;
+};
+
+template <typename IntersectFn>
+bool BVH::IntersectSubtree(uint32_t root, Ray &ray, Intersection &closestHit, IntersectFn &&intersect) const {
+    bool hit = false;
+    uint32_t stack[MAX_DEPTH];
+    int stackSize = 0;
+    uint32_t nodeIndex = root;
+
+    while (true) {
+        const Node &node = m_Nodes[nodeIndex];
+
+        if (node.NodeBounds.Intersect(ray)) {
+            if (node.Count > 0) {
+                for (uint32_t i = node.Offset; i < node.Offset + node.Count; i++) {
+                    uint32_t primitive = m_PrimitiveIndices[i];
+                    float t = intersect(primitive);
+
+                    if (t > ray.TMin && t < ray.TMax) {
+                        ray.TMax = t;
+                        closestHit.T = t;
+                        closestHit.GeometryIndex = (int)primitive;
+                        hit = true;
+                    }
+                }
+            } else {
+                // visit the near child first so that the far child can be culled by the closer hit
+                if (ray.Sign[node.Axis]) {
+                    stack[stackSize++] = nodeIndex + 1;
+                    nodeIndex = node.Offset;
+                } else {
+                    stack[stackSize++] = node.Offset;
+                    nodeIndex = nodeIndex + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return hit;
+}
+
+template <typename IntersectPacketFn, typename IntersectFn>
+void BVH::Intersect(RayPacket &packet, Intersection *hits, IntersectPacketFn &&intersectPacket, IntersectFn &&intersect) const {
+    if (m_Nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[MAX_DEPTH];
+    int stackSize = 0;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const Node &node = m_Nodes[nodeIndex];
+        uint32_t active = SIMD::Kernels().OverlapBoundsPacket(packet, node.NodeBounds);
+
+        if (active != 0 && (active & (active - 1)) == 0) {
+            // the packet has diverged, the single ray still inside the node doesn't need the other lanes
+            int lane = SIMD::FirstLane(active);
+            Ray ray = packet.GetRay(lane);
+            IntersectSubtree(nodeIndex, ray, hits[lane], [&](uint32_t primitive) { return intersect(primitive, ray); });
+            packet.TMax[lane] = ray.TMax;
+        } else if (active != 0) {
+            if (node.Count > 0) {
+                for (uint32_t i = node.Offset; i < node.Offset + node.Count; i++) {
+                    intersectPacket(m_PrimitiveIndices[i]);
+                }
+            } else {
+                // near child first for the first active ray, the others are nearly parallel to it
+                if (packet.IsNegative(SIMD::FirstLane(active), node.Axis)) {
+                    stack[stackSize++] = nodeIndex + 1;
+                    nodeIndex = node.Offset;
+                } else {
+                    stack[stackSize++] = node.Offset;
+                    nodeIndex = nodeIndex + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+}
+
+template <typename OccludedFn> bool BVH::Occluded(const Ray &ray, OccludedFn &&occluded) const {
+    if (m_Nodes.empty()) {
+        return false;
+    }
+
+    uint32_t stack[MAX_DEPTH];
+    int stackSize = 0;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const Node &node = m_Nodes[nodeIndex];
+
+        if (node.NodeBounds.Intersect(ray)) {
+            if (node.Count > 0) {
+                for (uint32_t i = node.Offset; i < node.Offset + node.Count; i++) {
+                    if (occluded(m_PrimitiveIndices[i])) {
+                        return true;
+                    }
+                }
+            } else {
+                stack[stackSize++] = node.Offset;
+                nodeIndex = nodeIndex + 1;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return false;
+}
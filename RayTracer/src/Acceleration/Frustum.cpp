@@ -0,0 +1,36 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::vec3 &origin, const glm::vec3 corners[4], float margin) {
+    glm::vec3 centre = corners[0] + corners[1] + corners[2] + corners[3];
+
+    for (int i = 0; i < 4; i++) {
+        glm::vec3 normal = glm::cross(corners[i], corners[(i + 1) % 4]);
+
+        // degenerate for tiles one pixel wide, the zero normal lets everything through
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normal /= length;
+        }
+        if (glm::dot(normal, centre) < 0.0f) {
+            normal = -normal;
+        }
+
+        m_Normals[i] = normal;
+        m_Distances[i] = glm::dot(normal, origin) - margin;
+    }
+}
+
+bool Frustum::Overlaps(const Bounds &bounds) const {
+    for (int i = 0; i < 4; i++) {
+        // corner of the bounds furthest along the normal, if it is outside the plane the whole box is
+        const glm::vec3 &normal = m_Normals[i];
+        glm::vec3 corner(normal.x >= 0.0f ? bounds.Max.x : bounds.Min.x, normal.y >= 0.0f ? bounds.Max.y : bounds.Min.y,
+                         normal.z >= 0.0f ? bounds.Max.z : bounds.Min.z);
+
+        if (glm::dot(normal, corner) < m_Distances[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
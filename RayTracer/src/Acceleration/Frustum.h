@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../Geometry/Bounds.h"
+
+#include <glm/glm.hpp>
+
+/// Pyramid with its apex at the camera, bounding every ray through a rectangle of pixels. Used to cull geometry that no
+/// primary ray of a screen tile can hit.
+class Frustum {
+  public:
+    Frustum() = default;
+
+    /**
+     * @param origin Apex shared by all rays.
+     * @param corners Directions of the rays through the four corner pixels, in order around the rectangle.
+     * @param margin Distance the planes are pushed outwards, to cover ray origins that are jittered around the apex.
+     */
+    Frustum(const glm::vec3 &origin, const glm::vec3 corners[4], float margin);
+
+    /// Conservative test, may report bounds that are just outside the corners of the frustum as overlapping.
+    bool Overlaps(const Bounds &bounds) const;
+
+  private:
+    // side planes through the apex, normals point inwards
+    glm::vec3 m_Normals[4];
+    float m_Distances[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+};
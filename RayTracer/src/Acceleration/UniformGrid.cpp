@@ -0,0 +1,137 @@
+#include "UniformGrid.h"
+
+#include <cmath>
+
+glm::ivec3 UniformGrid::ComputeResolution(const Bounds &bounds, size_t primitiveCount) {
+    // avoid a zero volume for flat scenes
+    glm::vec3 extent = bounds.Extent();
+    float largest = glm::max(extent.x, glm::max(extent.y, extent.z));
+    extent = glm::max(extent, glm::vec3(glm::max(1e-3f * largest, 1e-6f)));
+
+    // cubic cells sized so that there are CELLS_PER_PRIMITIVE cells per primitive
+    float volume = extent.x * extent.y * extent.z;
+    float cellsPerUnit = std::cbrt(CELLS_PER_PRIMITIVE * (float)primitiveCount / volume);
+
+    glm::ivec3 resolution;
+    for (int axis = 0; axis < 3; axis++) {
+        resolution[axis] = glm::clamp((int)(extent[axis] * cellsPerUnit), 1, MAX_RESOLUTION);
+    }
+
+    return resolution;
+}
+
+void UniformGrid::Build(const std::vector<Bounds> &primitiveBounds, const std::vector<uint32_t> &primitiveIndices) {
+    m_Bounds = Bounds();
+    m_CellOffsets.clear();
+    m_CellPrimitives.clear();
+    m_Statistics = Statistics();
+
+    if (primitiveIndices.empty()) {
+        return;
+    }
+
+    for (uint32_t primitive : primitiveIndices) {
+        m_Bounds.Grow(primitiveBounds[primitive]);
+    }
+
+    m_Resolution = ComputeResolution(m_Bounds, primitiveIndices.size());
+    m_CellSize = m_Bounds.Extent() / glm::vec3(m_Resolution.x, m_Resolution.y, m_Resolution.z);
+    m_CellSize = glm::max(m_CellSize, glm::vec3(1e-6f));
+    m_InverseCellSize = 1.0f / m_CellSize;
+
+    auto cellRange = [&](const Bounds &bounds, glm::ivec3 &first, glm::ivec3 &last) {
+        glm::ivec3 maxCell = m_Resolution - glm::ivec3(1);
+        first = glm::clamp(glm::ivec3(glm::floor((bounds.Min - m_Bounds.Min) * m_InverseCellSize)), glm::ivec3(0), maxCell);
+        last = glm::clamp(glm::ivec3(glm::floor((bounds.Max - m_Bounds.Min) * m_InverseCellSize)), glm::ivec3(0), maxCell);
+    };
+
+    // count the primitives overlapping each cell, then turn the counts into offsets
+    uint32_t cellCount = m_Resolution.x * m_Resolution.y * m_Resolution.z;
+    m_CellOffsets.assign(cellCount + 1, 0);
+
+    for (uint32_t primitive : primitiveIndices) {
+        glm::ivec3 first, last;
+        cellRange(primitiveBounds[primitive], first, last);
+
+        for (int z = first.z; z <= last.z; z++) {
+            for (int y = first.y; y <= last.y; y++) {
+                for (int x = first.x; x <= last.x; x++) {
+                    m_CellOffsets[CellIndex({x, y, z}) + 1]++;
+                }
+            }
+        }
+    }
+
+    double squaredCounts = 0.0;
+    m_Statistics.Resolution = m_Resolution;
+    m_Statistics.CellCount = cellCount;
+    for (uint32_t i = 1; i <= cellCount; i++) {
+        uint32_t count = m_CellOffsets[i];
+        m_Statistics.OccupiedCells += count > 0;
+        squaredCounts += (double)count * count;
+    }
+
+    for (uint32_t i = 0; i < cellCount; i++) {
+        m_CellOffsets[i + 1] += m_CellOffsets[i];
+    }
+
+    m_Statistics.References = m_CellOffsets[cellCount];
+    m_Statistics.HitCellPrimitives = (float)(squaredCounts / m_Statistics.References);
+
+    // fill the cells
+    m_CellPrimitives.resize(m_CellOffsets[cellCount]);
+    std::vector<uint32_t> fill(m_CellOffsets.begin(), m_CellOffsets.end() - 1);
+
+    for (uint32_t primitive : primitiveIndices) {
+        glm::ivec3 first, last;
+        cellRange(primitiveBounds[primitive], first, last);
+
+        for (int z = first.z; z <= last.z; z++) {
+            for (int y = first.y; y <= last.y; y++) {
+                for (int x = first.x; x <= last.x; x++) {
+                    m_CellPrimitives[fill[CellIndex({x, y, z})]++] = primitive;
+                }
+            }
+        }
+    }
+}
+
+bool UniformGrid::BeginWalk(const Ray &ray, Walk &walk) const {
+    if (m_CellPrimitives.empty()) {
+        return false;
+    }
+
+    const glm::vec3 &inverseDirection = ray.InverseDirection;
+    float tEntry, tExit;
+    if (!m_Bounds.Intersect(ray, tEntry, tExit)) {
+        return false;
+    }
+
+    glm::vec3 entry = ray.Origin + ray.Direction * tEntry;
+    walk.Cell = glm::clamp(glm::ivec3(glm::floor((entry - m_Bounds.Min) * m_InverseCellSize)), glm::ivec3(0),
+                           m_Resolution - glm::ivec3(1));
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.Direction[axis] > 0.0f) {
+            float boundary = m_Bounds.Min[axis] + (walk.Cell[axis] + 1) * m_CellSize[axis];
+            walk.TNext[axis] = (boundary - ray.Origin[axis]) * inverseDirection[axis];
+            walk.TDelta[axis] = m_CellSize[axis] * inverseDirection[axis];
+            walk.Step[axis] = 1;
+            walk.End[axis] = m_Resolution[axis];
+        } else if (ray.Direction[axis] < 0.0f) {
+            float boundary = m_Bounds.Min[axis] + walk.Cell[axis] * m_CellSize[axis];
+            walk.TNext[axis] = (boundary - ray.Origin[axis]) * inverseDirection[axis];
+            walk.TDelta[axis] = -m_CellSize[axis] * inverseDirection[axis];
+            walk.Step[axis] = -1;
+            walk.End[axis] = -1;
+        } else {
+            // never crosses a boundary on this axis
+            walk.TNext[axis] = std::numeric_limits<float>::infinity();
+            walk.TDelta[axis] = 0.0f;
+            walk.Step[axis] = 0;
+            walk.End[axis] = -1;
+        }
+    }
+
+    return true;
+}
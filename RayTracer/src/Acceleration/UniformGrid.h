@@ -0,0 +1,155 @@
+#pragma once
+
+#include "../Geometry/Bounds.h"
+#include "../Geometry/Geometry.h"
+#include "../Ray.h"
+
+#include <cstdint>
+#include <vector>
+
+/// Uniform grid traversed with a 3D-DDA. Cheaper to build and to traverse than a BVH when the primitives are small and
+/// evenly spread, but degrades badly when they are clustered. Same interface as BVH.
+class UniformGrid {
+  public:
+    /// Occupancy statistics gathered during the build, used to estimate the traversal cost.
+    struct Statistics {
+        glm::ivec3 Resolution{0};
+        uint32_t CellCount = 0;
+        uint32_t OccupiedCells = 0;
+        uint32_t References = 0;
+        // expected number of primitives in the cell where a ray hits something (cells weighted by their count)
+        float HitCellPrimitives = 0.0f;
+    };
+
+  public:
+    UniformGrid() = default;
+
+    /**
+     * Builds the grid over a subset of primitives.
+     * @param primitiveBounds Bounds of every primitive, indexed by primitive index.
+     * @param primitiveIndices Indices of the primitives to insert. Their bounds must be finite.
+     */
+    void Build(const std::vector<Bounds> &primitiveBounds, const std::vector<uint32_t> &primitiveIndices);
+
+    /**
+     * Finds the closest intersection along the ray.
+     * @param ray Ray to trace, its TMax is shrunk to every closer hit found.
+     * @param closestHit Closest intersection so far, updated if a closer one is found.
+     * @param intersect Callable taking a primitive index and returning the hit distance within the interval of the same
+     * ray, or a negative value on a miss.
+     * @return true if closestHit was updated.
+     */
+    template <typename IntersectFn> bool Intersect(Ray &ray, Intersection &closestHit, IntersectFn &&intersect) const;
+
+    /**
+     * Checks if anything within the ray's interval is hit, stopping at the first hit found.
+     * @param ray Ray to trace.
+     * @param occluded Callable taking a primitive index and returning true if the primitive blocks the ray.
+     */
+    template <typename OccludedFn> bool Occluded(const Ray &ray, OccludedFn &&occluded) const;
+
+    bool IsEmpty() const { return m_CellPrimitives.empty(); }
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+    /// Grid resolution that Build uses for the given primitives.
+    static glm::ivec3 ComputeResolution(const Bounds &bounds, size_t primitiveCount);
+
+  private:
+    /// State of a 3D-DDA walk through the cells.
+    struct Walk {
+        glm::ivec3 Cell;
+        glm::ivec3 Step;
+        glm::ivec3 End;
+        glm::vec3 TNext;
+        glm::vec3 TDelta;
+    };
+
+    bool BeginWalk(const Ray &ray, Walk &walk) const;
+    uint32_t CellIndex(const glm::ivec3 &cell) const { return (cell.z * m_Resolution.y + cell.y) * m_Resolution.x + cell.x; }
+
+  private:
+    static constexpr float CELLS_PER_PRIMITIVE = 3.0f;
+    static constexpr int MAX_RESOLUTION = 256;
+
+    Bounds m_Bounds;
+    glm::ivec3 m_Resolution{0};
+    glm::vec3 m_CellSize{0.0f};
+    glm::vec3 m_InverseCellSize{0.0f};
+
+    // primitives of cell i are m_CellPrimitives[m_CellOffsets[i]] to m_CellPrimitives[m_CellOffsets[i + 1] - 1]
+    std::vector<uint32_t> m_CellOffsets;
+    std::vector<uint32_t> m_CellPrimitives;
+
+    Statistics m_Statistics;
+};
+
+template <typename IntersectFn>
+bool UniformGrid::Intersect(Ray &ray, Intersection &closestHit, IntersectFn &&intersect) const {
+    Walk walk;
+    if (!BeginWalk(ray, walk)) {
+        return false;
+    }
+
+    bool hit = false;
+
+    while (true) {
+        uint32_t cell = CellIndex(walk.Cell);
+        for (uint32_t i = m_CellOffsets[cell]; i < m_CellOffsets[cell + 1]; i++) {
+            uint32_t primitive = m_CellPrimitives[i];
+            float t = intersect(primitive);
+
+            if (t > ray.TMin && t < ray.TMax) {
+                ray.TMax = t;
+                closestHit.T = t;
+                closestHit.GeometryIndex = (int)primitive;
+                hit = true;
+            }
+        }
+
+        // step to the neighbouring cell through the closest boundary
+        int axis = walk.TNext.x < walk.TNext.y ? (walk.TNext.x < walk.TNext.z ? 0 : 2) : (walk.TNext.y < walk.TNext.z ? 1 : 2);
+
+        // hits beyond the current cell may be beaten by primitives in later cells, hits before its exit can't
+        if (ray.TMax <= walk.TNext[axis]) {
+            break;
+        }
+
+        walk.Cell[axis] += walk.Step[axis];
+        if (walk.Cell[axis] == walk.End[axis]) {
+            break;
+        }
+        walk.TNext[axis] += walk.TDelta[axis];
+    }
+
+    return hit;
+}
+
+template <typename OccludedFn> bool UniformGrid::Occluded(const Ray &ray, OccludedFn &&occluded) const {
+    Walk walk;
+    if (!BeginWalk(ray, walk)) {
+        return false;
+    }
+
+    while (true) {
+        uint32_t cell = CellIndex(walk.Cell);
+        for (uint32_t i = m_CellOffsets[cell]; i < m_CellOffsets[cell + 1]; i++) {
+            if (occluded(m_CellPrimitives[i])) {
+                return true;
+            }
+        }
+
+        int axis = walk.TNext.x < walk.TNext.y ? (walk.TNext.x < walk.TNext.z ? 0 : 2) : (walk.TNext.y < walk.TNext.z ? 1 : 2);
+
+        if (ray.TMax <= walk.TNext[axis]) {
+            break;
+        }
+
+        walk.Cell[axis] += walk.Step[axis];
+        if (walk.Cell[axis] == walk.End[axis]) {
+            break;
+        }
+        walk.TNext[axis] += walk.TDelta[axis];
+    }
+
+    return false;
+}
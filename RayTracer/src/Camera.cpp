@@ -95,9 +95,11 @@ void Camera::RecalculateViewMatrix() {
 }
 
 void Camera::RecalculateRayDirections() {
-    m_RayDirections.resize(m_ViewportWidth * m_ViewportHeight);
+    if (m_RayDirections.Size() != (size_t)m_ViewportWidth * m_ViewportHeight) {
+        m_RayDirections.Allocate((size_t)m_ViewportWidth * m_ViewportHeight);
+    }
 
-    for (uint32_t y = 0; y < m_ViewportHeight; y++) {
+    auto row = [this](uint32_t y) {
         for (uint32_t x = 0; x < m_ViewportWidth; x++) {
             glm::vec2 coords = {(float)x / (float)m_ViewportWidth, (float)y / (float)m_ViewportHeight};
             coords = coords * 2.0f - 1.0f; // map to [-1, 1]
@@ -106,6 +108,14 @@ void Camera::RecalculateRayDirections() {
             glm::vec3 rayDir = glm::vec3(m_InverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0));
             m_RayDirections[y * m_ViewportWidth + x] = rayDir;
         }
+    };
+
+    if (m_RowExecutor) {
+        m_RowExecutor(m_ViewportHeight, row);
+    } else {
+        for (uint32_t y = 0; y < m_ViewportHeight; y++) {
+            row(y);
+        }
     }
 }
 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Scheduling/NUMA.h"
+
+#include <functional>
 #include <glm/glm.hpp>
-#include <vector>
 
 /// Camera class that handles the camera movement and projection matrices.
 class Camera {
@@ -47,7 +49,14 @@ class Camera {
     const glm::mat4 &GetInverseProjection() const { return m_InverseProjection; }
     const glm::mat4 &GetInverseView() const { return m_InverseView; }
 
-    const std::vector<glm::vec3> &GetRayDirections() const { return m_RayDirections; }
+    /// Direction of the ray through each pixel, row by row.
+    const glm::vec3 *GetRayDirections() const { return m_RayDirections.Data(); }
+
+    /// Runs a function over every row of the viewport, possibly on several threads. The directions of each row are
+    /// filled by whichever thread it gives the row to, so they end up in the memory of the node that renders it.
+    using RowExecutor = std::function<void(uint32_t rowCount, const std::function<void(uint32_t y)> &row)>;
+    /// Sets how the ray directions are filled, they are filled one row after another on the calling thread by default.
+    void SetRowExecutor(RowExecutor executor) { m_RowExecutor = std::move(executor); }
 
     CameraSettings &GetSettings() { return m_Settings; }
     const CameraSettings &GetSettings() const { return m_Settings; }
@@ -67,7 +76,8 @@ class Camera {
     glm::mat4 m_InverseProjection{1.0f};
     glm::mat4 m_InverseView{1.0f};
 
-    std::vector<glm::vec3> m_RayDirections;
+    NUMA::PageBuffer<glm::vec3> m_RayDirections;
+    RowExecutor m_RowExecutor;
 
     glm::vec2 m_LastMousePosition{0.0f, 0.0f};
 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+/// Bump allocator over a single block. Everything allocated from it is released at once when the arena is reset or
+/// destroyed; destructors are never run, so it only holds trivially destructible types.
+class Arena {
+  public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+
+    /// Releases all allocations and reserves a block of the given size, see SizeOf.
+    void Reset(size_t capacity) {
+        m_Memory = capacity > 0 ? std::make_unique<std::byte[]>(capacity + ALIGNMENT) : nullptr;
+        m_Capacity = capacity;
+        m_Used = 0;
+
+        // start of the block rounded up to the alignment, the block is over-allocated to leave room for it
+        uintptr_t address = reinterpret_cast<uintptr_t>(m_Memory.get());
+        m_Begin = m_Memory.get() + ((ALIGNMENT - address % ALIGNMENT) % ALIGNMENT);
+    }
+
+    /// Space needed in the block for count objects of type T, arrays are aligned to cache lines.
+    template <typename T> static size_t SizeOf(size_t count) {
+        return (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /// Copies count objects into the arena, the copies live until the next Reset.
+    template <typename T> T *Copy(const T *source, size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destructed");
+        assert(m_Used + SizeOf<T>(count) <= m_Capacity && "arena block too small, reserve more in Reset");
+
+        T *destination = reinterpret_cast<T *>(m_Begin + m_Used);
+        std::uninitialized_copy(source, source + count, destination);
+        m_Used += SizeOf<T>(count);
+
+        return destination;
+    }
+
+    /// Releases all allocations and copies the other arena's block, with the same layout. Pointers into the other arena
+    /// are carried over with Rebase.
+    void CopyFrom(const Arena &other) {
+        Reset(other.m_Capacity);
+        if (other.m_Used > 0) {
+            std::memcpy(m_Begin, other.m_Begin, other.m_Used);
+        }
+        m_Used = other.m_Used;
+    }
+
+    /// Pointer to the copy in this arena of an object allocated from the arena it was copied from.
+    template <typename T> T *Rebase(const Arena &source, T *pointer) const {
+        if (!pointer) {
+            return nullptr;
+        }
+        return reinterpret_cast<T *>(m_Begin + (reinterpret_cast<const std::byte *>(pointer) - source.m_Begin));
+    }
+
+    size_t GetCapacity() const { return m_Capacity; }
+
+  private:
+    static constexpr size_t ALIGNMENT = 64;
+
+    std::unique_ptr<std::byte[]> m_Memory;
+    std::byte *m_Begin = nullptr;
+    size_t m_Capacity = 0;
+    size_t m_Used = 0;
+};
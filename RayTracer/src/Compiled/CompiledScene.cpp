@@ -0,0 +1,433 @@
+#include "CompiledScene.h"
+
+#include "../SIMD/Kernels.h"
+
+#include "../Geometry/AABB.h"
+#include "../Geometry/Plane.h"
+#include "../Geometry/SDF/SDFGeometry.h"
+#include "../Geometry/Sphere.h"
+#include "../Geometry/Transform.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+namespace {
+using Handle = CompiledScene::Handle;
+using PrimitiveType = CompiledScene::PrimitiveType;
+
+/// Lowered geometry, collected in growable arrays before the arena can be sized.
+struct Lowering {
+    std::vector<SpherePrimitive> Spheres;
+    std::vector<BoxPrimitive> Boxes;
+    std::vector<PlanePrimitive> Planes;
+    std::vector<CompiledScene::SDFPrimitive> SDFs;
+    std::vector<CompiledScene::TransformPrimitive> Transforms;
+    std::vector<SDFInstruction> SDFProgram;
+
+    // children of transforms lowered so far, so prototypes shared by many instances are stored once
+    std::unordered_map<const Geometry *, Handle> Children;
+};
+
+template <typename T> Handle Append(std::vector<T> &array, PrimitiveType type, const T &primitive) {
+    array.push_back(primitive);
+    return Handle{type, (uint32_t)(array.size() - 1)};
+}
+
+std::optional<Handle> Lower(const Geometry &geometry, Lowering &lowering) {
+    if (auto sphere = dynamic_cast<const Sphere *>(&geometry)) {
+        return Append(lowering.Spheres, PrimitiveType::Sphere, sphere->GetPrimitive());
+    }
+    if (auto box = dynamic_cast<const AABB *>(&geometry)) {
+        return Append(lowering.Boxes, PrimitiveType::Box, box->GetPrimitive());
+    }
+    if (auto plane = dynamic_cast<const Plane *>(&geometry)) {
+        return Append(lowering.Planes, PrimitiveType::Plane, plane->GetPrimitive());
+    }
+
+    if (auto sdf = dynamic_cast<const SDFGeometry *>(&geometry)) {
+        std::vector<SDFInstruction> program;
+        if (sdf->Compile(program) > SDF_PROGRAM_STACK_SIZE) {
+            std::cerr << "SDF geometry too deeply nested to compile. skipping..." << std::endl;
+            return std::nullopt;
+        }
+
+        CompiledScene::SDFPrimitive primitive;
+        primitive.First = (uint32_t)lowering.SDFProgram.size();
+        primitive.Count = (uint32_t)program.size();
+        primitive.IsConvex = sdf->IsConvex();
+        primitive.SDFBounds = sdf->GetBounds();
+        primitive.Material = sdf->GetMaterial();
+        lowering.SDFProgram.insert(lowering.SDFProgram.end(), program.begin(), program.end());
+
+        return Append(lowering.SDFs, PrimitiveType::SDF, primitive);
+    }
+
+    if (auto transform = dynamic_cast<const Transform *>(&geometry)) {
+        const Geometry &child = *transform->GetChild();
+
+        auto it = lowering.Children.find(&child);
+        if (it == lowering.Children.end()) {
+            std::optional<Handle> childHandle = Lower(child, lowering);
+            if (!childHandle) {
+                return std::nullopt;
+            }
+            it = lowering.Children.emplace(&child, *childHandle).first;
+        }
+
+        CompiledScene::TransformPrimitive primitive;
+        primitive.TransformInverse = glm::mat4x3(transform->GetTransformInverse());
+        primitive.NormalMatrix = transform->GetNormalMatrix();
+        primitive.ChildBounds = transform->GetChildBounds();
+        primitive.Child = it->second;
+
+        return Append(lowering.Transforms, PrimitiveType::Transform, primitive);
+    }
+
+    std::cerr << "Unknown geometry type, can't compile it. skipping..." << std::endl;
+    return std::nullopt;
+}
+
+/// Copies the top-level primitives of one type into blocks, padding the last one with lanes that always miss.
+template <typename Block, typename Primitive>
+std::vector<Block> MakeBlocks(const std::vector<Handle> &primitives, uint32_t first, uint32_t count,
+                              const std::vector<Primitive> &lowered) {
+    std::vector<Block> blocks((count + SIMD_BLOCK_WIDTH - 1) / SIMD_BLOCK_WIDTH, Block::Empty());
+    for (uint32_t i = 0; i < count; i++) {
+        blocks[i / SIMD_BLOCK_WIDTH].Set(i % SIMD_BLOCK_WIDTH, lowered[primitives[first + i].Index]);
+    }
+    return blocks;
+}
+
+/// First top-level index of a type and the number of primitives of that type, which are contiguous after sorting.
+void FindRange(const std::vector<Handle> &primitives, PrimitiveType type, uint32_t &first, uint32_t &count) {
+    auto begin = std::find_if(primitives.begin(), primitives.end(), [&](const Handle &h) { return h.Type == type; });
+    auto end = std::find_if(begin, primitives.end(), [&](const Handle &h) { return h.Type != type; });
+    first = (uint32_t)(begin - primitives.begin());
+    count = (uint32_t)(end - begin);
+}
+
+const SphereBlock EMPTY_SPHERE_BLOCK = SphereBlock::Empty();
+const BoxBlock EMPTY_BOX_BLOCK = BoxBlock::Empty();
+} // namespace
+
+void CompiledScene::Compile(const std::vector<std::unique_ptr<Geometry>> &geometry) {
+    Lowering lowering;
+
+    struct TopLevel {
+        Handle Primitive;
+        Bounds PrimitiveBounds;
+    };
+    std::vector<TopLevel> topLevel;
+    topLevel.reserve(geometry.size());
+
+    for (const auto &g : geometry) {
+        if (std::optional<Handle> handle = Lower(*g, lowering)) {
+            topLevel.push_back({*handle, g->GetBounds()});
+        }
+    }
+
+    // group by type so that testing the primitives in order rarely changes the branch taken by the dispatch
+    std::stable_sort(topLevel.begin(), topLevel.end(),
+                     [](const TopLevel &a, const TopLevel &b) { return a.Primitive.Type < b.Primitive.Type; });
+
+    std::vector<Handle> primitives;
+    std::vector<Bounds> bounds;
+    primitives.reserve(topLevel.size());
+    bounds.reserve(topLevel.size());
+    for (const TopLevel &t : topLevel) {
+        primitives.push_back(t.Primitive);
+        bounds.push_back(t.PrimitiveBounds);
+    }
+
+    FindRange(primitives, PrimitiveType::Sphere, m_FirstSphere, m_SphereCount);
+    FindRange(primitives, PrimitiveType::Box, m_FirstBox, m_BoxCount);
+    std::vector<SphereBlock> sphereBlocks = MakeBlocks<SphereBlock>(primitives, m_FirstSphere, m_SphereCount, lowering.Spheres);
+    std::vector<BoxBlock> boxBlocks = MakeBlocks<BoxBlock>(primitives, m_FirstBox, m_BoxCount, lowering.Boxes);
+
+    // everything is copied into one block sized up front
+    size_t size = Arena::SizeOf<Handle>(primitives.size()) + Arena::SizeOf<Bounds>(bounds.size()) +
+                  Arena::SizeOf<SpherePrimitive>(lowering.Spheres.size()) +
+                  Arena::SizeOf<BoxPrimitive>(lowering.Boxes.size()) +
+                  Arena::SizeOf<PlanePrimitive>(lowering.Planes.size()) +
+                  Arena::SizeOf<SDFPrimitive>(lowering.SDFs.size()) +
+                  Arena::SizeOf<TransformPrimitive>(lowering.Transforms.size()) +
+                  Arena::SizeOf<SDFInstruction>(lowering.SDFProgram.size()) +
+                  Arena::SizeOf<SphereBlock>(sphereBlocks.size()) + Arena::SizeOf<BoxBlock>(boxBlocks.size());
+    m_Arena.Reset(size);
+
+    m_PrimitiveCount = (uint32_t)primitives.size();
+    m_Primitives = m_Arena.Copy(primitives.data(), primitives.size());
+    m_Bounds = m_Arena.Copy(bounds.data(), bounds.size());
+    m_Spheres = m_Arena.Copy(lowering.Spheres.data(), lowering.Spheres.size());
+    m_Boxes = m_Arena.Copy(lowering.Boxes.data(), lowering.Boxes.size());
+    m_Planes = m_Arena.Copy(lowering.Planes.data(), lowering.Planes.size());
+    m_SDFs = m_Arena.Copy(lowering.SDFs.data(), lowering.SDFs.size());
+    m_Transforms = m_Arena.Copy(lowering.Transforms.data(), lowering.Transforms.size());
+    m_SDFProgram = m_Arena.Copy(lowering.SDFProgram.data(), lowering.SDFProgram.size());
+    m_SphereBlocks = m_Arena.Copy(sphereBlocks.data(), sphereBlocks.size());
+    m_BoxBlocks = m_Arena.Copy(boxBlocks.data(), boxBlocks.size());
+}
+
+CompiledScene &CompiledScene::operator=(const CompiledScene &other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    m_Arena.CopyFrom(other.m_Arena);
+
+    m_PrimitiveCount = other.m_PrimitiveCount;
+    m_Primitives = m_Arena.Rebase(other.m_Arena, other.m_Primitives);
+    m_Bounds = m_Arena.Rebase(other.m_Arena, other.m_Bounds);
+    m_Spheres = m_Arena.Rebase(other.m_Arena, other.m_Spheres);
+    m_Boxes = m_Arena.Rebase(other.m_Arena, other.m_Boxes);
+    m_Planes = m_Arena.Rebase(other.m_Arena, other.m_Planes);
+    m_SDFs = m_Arena.Rebase(other.m_Arena, other.m_SDFs);
+    m_Transforms = m_Arena.Rebase(other.m_Arena, other.m_Transforms);
+    m_SDFProgram = m_Arena.Rebase(other.m_Arena, other.m_SDFProgram);
+
+    m_FirstSphere = other.m_FirstSphere;
+    m_SphereCount = other.m_SphereCount;
+    m_SphereBlocks = m_Arena.Rebase(other.m_Arena, other.m_SphereBlocks);
+    m_FirstBox = other.m_FirstBox;
+    m_BoxCount = other.m_BoxCount;
+    m_BoxBlocks = m_Arena.Rebase(other.m_Arena, other.m_BoxBlocks);
+
+    return *this;
+}
+
+void CompiledScene::Intersect(Ray &ray, Intersection &closestHit) const {
+    const SIMD::KernelTable &kernels = SIMD::Kernels();
+    auto record = [&](uint32_t primitive) {
+        closestHit.T = ray.TMax;
+        closestHit.GeometryIndex = (int)primitive;
+    };
+
+    int sphere = kernels.IntersectSpheres(m_SphereBlocks, BlockCount(m_SphereCount), ray);
+    if (sphere != -1) {
+        record(m_FirstSphere + sphere);
+    }
+    int box = kernels.IntersectBoxes(m_BoxBlocks, BlockCount(m_BoxCount), ray);
+    if (box != -1) {
+        record(m_FirstBox + box);
+    }
+
+    for (uint32_t i = 0; i < m_PrimitiveCount; i++) {
+        if (IsBlockedSphere(i) || IsBlockedBox(i)) {
+            continue;
+        }
+
+        float t = Intersect(i, ray);
+        if (t > ray.TMin && t < ray.TMax) {
+            ray.TMax = t;
+            record(i);
+        }
+    }
+}
+
+void CompiledScene::Intersect(const std::vector<uint32_t> &primitives, Ray &ray, Intersection &closestHit) const {
+    const SIMD::KernelTable &kernels = SIMD::Kernels();
+    auto record = [&](uint32_t primitive) {
+        closestHit.T = ray.TMax;
+        closestHit.GeometryIndex = (int)primitive;
+    };
+
+#ifndef NDEBUG
+    Ray scalarRay = ray;
+#endif
+    size_t i = 0;
+
+    // tests the run of up to SIMD_BLOCK_WIDTH primitives of one type starting at i, using the compiled block directly if
+    // the run is exactly one whole block of that type and gathering the lanes into a new one otherwise. A partial last
+    // block is always gathered, its padding lanes would otherwise stand in for the primitives of the next type.
+    auto intersectRun = [&](const auto *blocks, uint32_t first, uint32_t count, auto gathered, auto kernel) {
+        uint32_t offset = primitives[i] - first;
+        if (offset % SIMD_BLOCK_WIDTH == 0 && offset + SIMD_BLOCK_WIDTH <= count &&
+            i + SIMD_BLOCK_WIDTH <= primitives.size() &&
+            primitives[i + SIMD_BLOCK_WIDTH - 1] == primitives[i] + SIMD_BLOCK_WIDTH - 1) {
+            int lane = kernel(blocks + offset / SIMD_BLOCK_WIDTH, 1, ray);
+            if (lane != -1) {
+                record(primitives[i] + lane);
+            }
+            i += SIMD_BLOCK_WIDTH;
+            return;
+        }
+
+        uint32_t indices[SIMD_BLOCK_WIDTH];
+        int used = 0;
+        while (used < SIMD_BLOCK_WIDTH && i < primitives.size() && primitives[i] - first < count) {
+            offset = primitives[i] - first;
+            gathered.Set(used, blocks[offset / SIMD_BLOCK_WIDTH], offset % SIMD_BLOCK_WIDTH);
+            indices[used++] = primitives[i++];
+        }
+
+        int lane = kernel(&gathered, 1, ray);
+        if (lane != -1) {
+            record(indices[lane]);
+        }
+    };
+
+    while (i < primitives.size()) {
+        uint32_t primitive = primitives[i];
+
+        if (IsBlockedSphere(primitive)) {
+            intersectRun(m_SphereBlocks, m_FirstSphere, m_SphereCount, EMPTY_SPHERE_BLOCK, kernels.IntersectSpheres);
+        } else if (IsBlockedBox(primitive)) {
+            intersectRun(m_BoxBlocks, m_FirstBox, m_BoxCount, EMPTY_BOX_BLOCK, kernels.IntersectBoxes);
+        } else {
+            float t = Intersect(primitive, ray);
+            if (t > ray.TMin && t < ray.TMax) {
+                ray.TMax = t;
+                record(primitive);
+            }
+            i++;
+        }
+    }
+
+#ifndef NDEBUG
+    // the blocks must find the same closest hit as testing every candidate on its own
+    for (uint32_t primitive : primitives) {
+        float t = Intersect(primitive, scalarRay);
+        if (t > scalarRay.TMin && t < scalarRay.TMax) {
+            scalarRay.TMax = t;
+        }
+    }
+    assert((scalarRay.TMax == ray.TMax || std::abs(scalarRay.TMax - ray.TMax) <= 1e-4f * std::max(ray.TMax, 1.0f)) &&
+           "candidate blocks missed a primitive");
+#endif
+}
+
+int CompiledScene::FindOccluder(const Ray &ray) const {
+    const SIMD::KernelTable &kernels = SIMD::Kernels();
+
+    int sphere = kernels.OccludedSpheres(m_SphereBlocks, BlockCount(m_SphereCount), ray);
+    if (sphere != -1) {
+        return (int)m_FirstSphere + sphere;
+    }
+    int box = kernels.OccludedBoxes(m_BoxBlocks, BlockCount(m_BoxCount), ray);
+    if (box != -1) {
+        return (int)m_FirstBox + box;
+    }
+
+    for (uint32_t i = 0; i < m_PrimitiveCount; i++) {
+        if (!IsBlockedSphere(i) && !IsBlockedBox(i) && Occluded(i, ray)) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+void CompiledScene::Intersect(uint32_t primitive, RayPacket &packet, Intersection *hits) const {
+    const SIMD::KernelTable &kernels = SIMD::Kernels();
+    Handle handle = m_Primitives[primitive];
+
+    uint32_t bits;
+    switch (handle.Type) {
+    case PrimitiveType::Sphere:
+        bits = kernels.IntersectSpherePacket(packet, m_Spheres[handle.Index]);
+        break;
+    case PrimitiveType::Box:
+        bits = kernels.IntersectBoxPacket(packet, m_Boxes[handle.Index]);
+        break;
+    case PrimitiveType::Plane:
+        bits = kernels.IntersectPlanePacket(packet, m_Planes[handle.Index]);
+        break;
+    default:
+        for (int lane = 0; lane < packet.Count; lane++) {
+            float t = Intersect(handle, packet.GetRay(lane));
+            if (t > packet.TMin[lane] && t < packet.TMax[lane]) {
+                packet.TMax[lane] = t;
+                hits[lane].T = t;
+                hits[lane].GeometryIndex = (int)primitive;
+            }
+        }
+        return;
+    }
+
+    for (; bits != 0; bits &= bits - 1) {
+        int lane = SIMD::FirstLane(bits);
+        hits[lane].T = packet.TMax[lane];
+        hits[lane].GeometryIndex = (int)primitive;
+    }
+}
+
+void CompiledScene::Intersect(RayPacket &packet, Intersection *hits) const {
+    for (uint32_t i = 0; i < m_PrimitiveCount; i++) {
+        Intersect(i, packet, hits);
+    }
+}
+
+void CompiledScene::Intersect(const std::vector<uint32_t> &primitives, RayPacket &packet, Intersection *hits) const {
+    for (uint32_t i : primitives) {
+        Intersect(i, packet, hits);
+    }
+}
+
+SurfaceInteraction CompiledScene::GetSurfaceInteraction(Handle handle, const glm::vec3 &point) const {
+    switch (handle.Type) {
+    case PrimitiveType::Sphere: {
+        const SpherePrimitive &sphere = m_Spheres[handle.Index];
+        return SurfaceInteraction{point, sphere.GetNormal(point), point, sphere.MaterialIndex};
+    }
+    case PrimitiveType::Box: {
+        const BoxPrimitive &box = m_Boxes[handle.Index];
+        return SurfaceInteraction{point, box.GetNormal(point), point, box.MaterialIndex};
+    }
+    case PrimitiveType::Plane: {
+        const PlanePrimitive &plane = m_Planes[handle.Index];
+        return SurfaceInteraction{point, plane.GetNormal(), point, plane.GetMaterialIndex(point)};
+    }
+    case PrimitiveType::SDF: {
+        const SDFPrimitive &sdf = m_SDFs[handle.Index];
+        glm::vec3 normal = NormalSDF(sdf, point);
+        return SurfaceInteraction{point, normal, point, sdf.Material.GetMaterialIndex(point)};
+    }
+    case PrimitiveType::Transform: {
+        // the point is moved into the child's space once, and only the normal is moved back
+        const TransformPrimitive &transform = m_Transforms[handle.Index];
+        glm::vec3 transformedPoint = transform.TransformInverse * glm::vec4(point, 1.0f);
+
+        SurfaceInteraction interaction = GetSurfaceInteraction(transform.Child, transformedPoint);
+        interaction.Position = point;
+        interaction.Normal = glm::normalize(transform.NormalMatrix * interaction.Normal);
+        return interaction;
+    }
+    }
+
+    return SurfaceInteraction{point, glm::vec3(0.0f), point, 0};
+}
+
+glm::vec3 CompiledScene::NormalSDF(const SDFPrimitive &sdf, const glm::vec3 &point) const {
+    // the four corners of SDF::Normal's tetrahedron, evaluated together
+    const glm::vec3 k[4] = {{1.0f, -1.0f, -1.0f}, {-1.0f, -1.0f, 1.0f}, {-1.0f, 1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}};
+    glm::vec3 points[4];
+    for (int i = 0; i < 4; i++) {
+        points[i] = point + k[i] * SDF::NORMAL_EPSILON;
+    }
+
+    float distances[4];
+    SIMD::Kernels().EvaluateSDF(m_SDFProgram + sdf.First, sdf.Count, points, distances, 4);
+
+    return glm::normalize(k[0] * distances[0] + k[1] * distances[1] + k[2] * distances[2] + k[3] * distances[3]);
+}
+
+float CompiledScene::IntersectSDF(const SDFPrimitive &sdf, const Ray &ray) const {
+    float startDepth, maxDepth;
+    if (!SDF::Clip(ray, sdf.SDFBounds, startDepth, maxDepth)) {
+        return -1.0f;
+    }
+
+    return SDF::March(ray, startDepth, maxDepth, sdf.IsConvex, [&](const glm::vec3 &p) { return DistanceSDF(sdf, p); });
+}
+
+bool CompiledScene::TransformRay(const TransformPrimitive &transform, const Ray &ray, Ray &transformedRay) {
+    // the direction isn't normalised, so distances along the ray (and its interval) are the same in both spaces
+    transformedRay = Ray(transform.TransformInverse * glm::vec4(ray.Origin, 1.0f),
+                         transform.TransformInverse * glm::vec4(ray.Direction, 0.0f), ray.TMin, ray.TMax);
+
+    return !transform.ChildBounds.IsFinite() || transform.ChildBounds.Intersect(transformedRay);
+}
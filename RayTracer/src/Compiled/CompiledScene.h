@@ -0,0 +1,189 @@
+#pragma once
+
+#include "../Geometry/Bounds.h"
+#include "../Geometry/Checkerboard.h"
+#include "../Geometry/Geometry.h"
+#include "../Geometry/Primitives.h"
+#include "../Geometry/SDF/SDFProgram.h"
+#include "../Ray.h"
+#include "../RayPacket.h"
+#include "Arena.h"
+#include "PrimitiveBlocks.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Scene geometry lowered into flat arrays for tracing. Every primitive type is stored in its own contiguous array in a
+/// single arena and calls are dispatched with a switch on a type tag instead of virtual calls. Top-level primitives are
+/// sorted by type, so the switch takes the same branch for long runs when they are tested in order.
+///
+/// The geometry objects stay the editable form of the scene; recompile after changing them. Primitive indices used by
+/// the acceleration structures and hit records refer to the compiled order, not to the order of Scene::Geometry.
+///
+/// Top-level spheres and boxes are also copied into SIMD blocks, which the whole-scene and subset queries test a block at
+/// a time with the kernels picked for the CPU (see SIMD::KernelTable).
+class CompiledScene {
+  public:
+    enum class PrimitiveType : uint8_t { Sphere, Box, Plane, SDF, Transform };
+
+    /// Type tag and index into the array of that type.
+    struct Handle {
+        PrimitiveType Type;
+        uint32_t Index;
+    };
+
+    /// SDF tree flattened to program[First, First + Count).
+    struct SDFPrimitive {
+        uint32_t First = 0;
+        uint32_t Count = 0;
+        bool IsConvex = false;
+        Bounds SDFBounds;
+        Checkerboard Material;
+    };
+
+    /// Child geometry placed in the world, children shared between transforms (instances) are stored once. Only the
+    /// 3x4 affine world-to-child matrix is kept, plus the normal matrix to bring normals back out.
+    struct TransformPrimitive {
+        glm::mat4x3 TransformInverse;
+        glm::mat3 NormalMatrix;
+        Bounds ChildBounds; // in the child's space
+        Handle Child;
+    };
+
+  public:
+    CompiledScene() = default;
+    /// Copies the arena in one block, e.g. to keep a replica in the memory of each NUMA node.
+    CompiledScene(const CompiledScene &other) { *this = other; }
+    CompiledScene &operator=(const CompiledScene &other);
+    CompiledScene(CompiledScene &&) = default;
+    CompiledScene &operator=(CompiledScene &&) = default;
+
+    /// Lowers the geometry, replacing anything compiled before.
+    void Compile(const std::vector<std::unique_ptr<Geometry>> &geometry);
+
+    uint32_t GetPrimitiveCount() const { return m_PrimitiveCount; }
+    const Bounds &GetBounds(uint32_t primitive) const { return m_Bounds[primitive]; }
+    /// Size of the arena holding all compiled data, in bytes.
+    size_t GetMemorySize() const { return m_Arena.GetCapacity(); }
+
+    /// Same as Geometry::Intersect for the top-level primitive.
+    float Intersect(uint32_t primitive, const Ray &ray) const { return Intersect(m_Primitives[primitive], ray); }
+    /// Same as Geometry::Occluded for the top-level primitive.
+    bool Occluded(uint32_t primitive, const Ray &ray) const { return Occluded(m_Primitives[primitive], ray); }
+    /// The top-level primitive if it's a sphere, otherwise nullptr.
+    const SpherePrimitive *GetSphere(uint32_t primitive) const {
+        Handle handle = m_Primitives[primitive];
+        return handle.Type == PrimitiveType::Sphere ? &m_Spheres[handle.Index] : nullptr;
+    }
+    /// The top-level primitive if it's a box, otherwise nullptr.
+    const BoxPrimitive *GetBox(uint32_t primitive) const {
+        Handle handle = m_Primitives[primitive];
+        return handle.Type == PrimitiveType::Box ? &m_Boxes[handle.Index] : nullptr;
+    }
+    /// Same as Geometry::GetSurfaceInteraction for the top-level primitive.
+    SurfaceInteraction GetSurfaceInteraction(uint32_t primitive, const glm::vec3 &point) const {
+        return GetSurfaceInteraction(m_Primitives[primitive], point);
+    }
+
+    /**
+     * Finds the closest hit among all top-level primitives.
+     * @param ray Ray to trace, its interval is shrunk to the closest hit.
+     * @param closestHit Updated if a hit closer than the interval's end is found.
+     */
+    void Intersect(Ray &ray, Intersection &closestHit) const;
+    /// Same as Intersect, for the primitives at the given indices which must be in increasing order.
+    void Intersect(const std::vector<uint32_t> &primitives, Ray &ray, Intersection &closestHit) const;
+    /// Index of a top-level primitive blocking the ray, or -1.
+    int FindOccluder(const Ray &ray) const;
+
+    /**
+     * Tests every ray of a packet against the top-level primitive. Spheres, boxes and planes are tested with packet
+     * kernels, other primitives one ray at a time.
+     * @param packet Rays to trace, the interval of each ray that hits is shrunk to the hit.
+     * @param hits Closest hit of each ray, updated for the rays that hit.
+     */
+    void Intersect(uint32_t primitive, RayPacket &packet, Intersection *hits) const;
+    /// Packet version of Intersect(ray, closestHit).
+    void Intersect(RayPacket &packet, Intersection *hits) const;
+    /// Packet version of Intersect(primitives, ray, closestHit).
+    void Intersect(const std::vector<uint32_t> &primitives, RayPacket &packet, Intersection *hits) const;
+
+  private:
+    inline float Intersect(Handle handle, const Ray &ray) const;
+    inline bool Occluded(Handle handle, const Ray &ray) const;
+    SurfaceInteraction GetSurfaceInteraction(Handle handle, const glm::vec3 &point) const;
+
+    float IntersectSDF(const SDFPrimitive &sdf, const Ray &ray) const;
+    /// Same as SDF::Normal, with the four distances evaluated in one SIMD pass.
+    glm::vec3 NormalSDF(const SDFPrimitive &sdf, const glm::vec3 &point) const;
+    float DistanceSDF(const SDFPrimitive &sdf, const glm::vec3 &point) const {
+        return EvaluateSDFProgram(m_SDFProgram + sdf.First, sdf.Count, point);
+    }
+    /// Moves the ray into the child's space, false if it misses the child's bounds.
+    static bool TransformRay(const TransformPrimitive &transform, const Ray &ray, Ray &transformedRay);
+
+    bool IsBlockedSphere(uint32_t primitive) const { return primitive - m_FirstSphere < m_SphereCount; }
+    bool IsBlockedBox(uint32_t primitive) const { return primitive - m_FirstBox < m_BoxCount; }
+    static uint32_t BlockCount(uint32_t count) { return (count + SIMD_BLOCK_WIDTH - 1) / SIMD_BLOCK_WIDTH; }
+
+  private:
+    Arena m_Arena;
+
+    uint32_t m_PrimitiveCount = 0;
+    const Handle *m_Primitives = nullptr;
+    const Bounds *m_Bounds = nullptr;
+
+    const SpherePrimitive *m_Spheres = nullptr;
+    const BoxPrimitive *m_Boxes = nullptr;
+    const PlanePrimitive *m_Planes = nullptr;
+    const SDFPrimitive *m_SDFs = nullptr;
+    const TransformPrimitive *m_Transforms = nullptr;
+    const SDFInstruction *m_SDFProgram = nullptr;
+
+    // top-level spheres and boxes are contiguous after the sort, top-level index m_FirstSphere + i is lane
+    // i % SIMD_BLOCK_WIDTH of block i / SIMD_BLOCK_WIDTH; the last block is padded with lanes that always miss
+    uint32_t m_FirstSphere = 0;
+    uint32_t m_SphereCount = 0;
+    const SphereBlock *m_SphereBlocks = nullptr;
+    uint32_t m_FirstBox = 0;
+    uint32_t m_BoxCount = 0;
+    const BoxBlock *m_BoxBlocks = nullptr;
+};
+
+float CompiledScene::Intersect(Handle handle, const Ray &ray) const {
+    switch (handle.Type) {
+    case PrimitiveType::Sphere:
+        return m_Spheres[handle.Index].Intersect(ray);
+    case PrimitiveType::Box:
+        return m_Boxes[handle.Index].Intersect(ray);
+    case PrimitiveType::Plane:
+        return m_Planes[handle.Index].Intersect(ray);
+    case PrimitiveType::SDF:
+        return IntersectSDF(m_SDFs[handle.Index], ray);
+    case PrimitiveType::Transform: {
+        const TransformPrimitive &transform = m_Transforms[handle.Index];
+        Ray transformedRay;
+        if (!TransformRay(transform, ray, transformedRay)) {
+            return -1.0f;
+        }
+        return Intersect(transform.Child, transformedRay);
+    }
+    }
+
+    return -1.0f;
+}
+
+bool CompiledScene::Occluded(Handle handle, const Ray &ray) const {
+    switch (handle.Type) {
+    case PrimitiveType::Sphere:
+        return m_Spheres[handle.Index].Occluded(ray);
+    case PrimitiveType::Transform: {
+        const TransformPrimitive &transform = m_Transforms[handle.Index];
+        Ray transformedRay;
+        return TransformRay(transform, ray, transformedRay) && Occluded(transform.Child, transformedRay);
+    }
+    default:
+        return Intersect(handle, ray) > 0.0f;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Geometry/Primitives.h"
+
+#include <limits>
+
+/// Primitives per block. Fixed, so the layout doesn't depend on the instruction set the kernels were built for; narrower
+/// kernels process a block in several steps.
+#define SIMD_BLOCK_WIDTH 8
+
+// Spheres and boxes stored SIMD_BLOCK_WIDTH to a block, one array per coordinate, so one ray is tested against a whole
+// block with a few vector instructions. See SIMD::KernelTable for the kernels.
+
+struct alignas(32) SphereBlock {
+    float X[SIMD_BLOCK_WIDTH];
+    float Y[SIMD_BLOCK_WIDTH];
+    float Z[SIMD_BLOCK_WIDTH];
+    float RadiusSquared[SIMD_BLOCK_WIDTH];
+
+    /// Block where every lane misses, a negative squared radius keeps the discriminant negative.
+    static SphereBlock Empty() {
+        SphereBlock block;
+        for (int i = 0; i < SIMD_BLOCK_WIDTH; i++) {
+            block.X[i] = block.Y[i] = block.Z[i] = 0.0f;
+            block.RadiusSquared[i] = -1.0f;
+        }
+        return block;
+    }
+
+    void Set(int lane, const SpherePrimitive &sphere) {
+        X[lane] = sphere.Position.x;
+        Y[lane] = sphere.Position.y;
+        Z[lane] = sphere.Position.z;
+        RadiusSquared[lane] = sphere.Radius * sphere.Radius;
+    }
+
+    void Set(int lane, const SphereBlock &source, int sourceLane) {
+        X[lane] = source.X[sourceLane];
+        Y[lane] = source.Y[sourceLane];
+        Z[lane] = source.Z[sourceLane];
+        RadiusSquared[lane] = source.RadiusSquared[sourceLane];
+    }
+};
+
+struct alignas(32) BoxBlock {
+    // Min[axis] and Max[axis] for each axis, indexed so the near and far planes can be picked by the ray's sign
+    float Min[3][SIMD_BLOCK_WIDTH];
+    float Max[3][SIMD_BLOCK_WIDTH];
+
+    /// Block where every lane misses: inverted infinite boxes have their far planes in front of their near planes.
+    static BoxBlock Empty() {
+        BoxBlock block;
+        for (int axis = 0; axis < 3; axis++) {
+            for (int i = 0; i < SIMD_BLOCK_WIDTH; i++) {
+                block.Min[axis][i] = std::numeric_limits<float>::infinity();
+                block.Max[axis][i] = -std::numeric_limits<float>::infinity();
+            }
+        }
+        return block;
+    }
+
+    void Set(int lane, const BoxPrimitive &box) {
+        for (int axis = 0; axis < 3; axis++) {
+            Min[axis][lane] = box.Min[axis];
+            Max[axis][lane] = box.Max[axis];
+        }
+    }
+
+    void Set(int lane, const BoxBlock &source, int sourceLane) {
+        for (int axis = 0; axis < 3; axis++) {
+            Min[axis][lane] = source.Min[axis][sourceLane];
+            Max[axis][lane] = source.Max[axis][sourceLane];
+        }
+    }
+};
@@ -1,16 +1,19 @@
 #pragma once
 
 #include "Geometry.h"
+#include "Primitives.h"
 
 class AABB : public Geometry {
   public:
     AABB(const glm::vec3 &min, const glm::vec3 &max, int materialIndex)
-        : m_Min(min), m_Max(max), Geometry(materialIndex) {}
+        : m_Primitive{min, max, materialIndex}, Geometry(materialIndex) {}
 
-    float Intersect(const Ray &ray) const override;
-    glm::vec3 GetNormal(const glm::vec3 &point) const override;
+    float Intersect(const Ray &ray) const override { return m_Primitive.Intersect(ray); }
+    glm::vec3 GetNormal(const glm::vec3 &point) const override { return m_Primitive.GetNormal(point); }
+    Bounds GetBounds() const override { return m_Primitive.GetBounds(); }
+
+    const BoxPrimitive &GetPrimitive() const { return m_Primitive; }
 
   private:
-    glm::vec3 m_Min{0.0f};
-    glm::vec3 m_Max{1.0f};
+    BoxPrimitive m_Primitive;
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../Ray.h"
+
+#include <glm/glm.hpp>
+#include <limits>
+
+/// Axis-aligned bounding box used by the acceleration structures. Default constructed bounds are empty.
+struct Bounds {
+    glm::vec3 Min{std::numeric_limits<float>::max()};
+    glm::vec3 Max{-std::numeric_limits<float>::max()};
+
+    Bounds() = default;
+    Bounds(const glm::vec3 &min, const glm::vec3 &max) : Min(min), Max(max) {}
+
+    static Bounds Infinite() {
+        return Bounds(glm::vec3(-std::numeric_limits<float>::infinity()), glm::vec3(std::numeric_limits<float>::infinity()));
+    }
+
+    void Grow(const glm::vec3 &point) {
+        Min = glm::min(Min, point);
+        Max = glm::max(Max, point);
+    }
+
+    void Grow(const Bounds &other) {
+        Min = glm::min(Min, other.Min);
+        Max = glm::max(Max, other.Max);
+    }
+
+    bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+
+    bool IsFinite() const {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        return !IsEmpty() && Min.x > -inf && Min.y > -inf && Min.z > -inf && Max.x < inf && Max.y < inf && Max.z < inf;
+    }
+
+    glm::vec3 Centroid() const { return (Min + Max) * 0.5f; }
+    glm::vec3 Extent() const { return Max - Min; }
+
+    float SurfaceArea() const {
+        if (IsEmpty()) {
+            return 0.0f;
+        }
+        glm::vec3 e = Extent();
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    /// Index of the axis along which the bounds are largest.
+    int LargestAxis() const {
+        glm::vec3 e = Extent();
+        if (e.x > e.y && e.x > e.z) {
+            return 0;
+        }
+        return e.y > e.z ? 1 : 2;
+    }
+
+    /**
+     * Slab test against the bounds, branch free using the ray's reciprocal direction and sign bits.
+     * @param ray Ray to test, only its interval [TMin, TMax] is considered.
+     * @param tEntry Set to the distance at which the ray enters the bounds (clamped to the interval).
+     * @param tExit Set to the distance at which the ray leaves the bounds (clamped to the interval).
+     * @return true if the ray overlaps the bounds within its interval.
+     */
+    bool Intersect(const Ray &ray, float &tEntry, float &tExit) const {
+        float txNear = ((ray.Sign[0] ? Max.x : Min.x) - ray.Origin.x) * ray.InverseDirection.x;
+        float txFar = ((ray.Sign[0] ? Min.x : Max.x) - ray.Origin.x) * ray.InverseDirection.x;
+        float tyNear = ((ray.Sign[1] ? Max.y : Min.y) - ray.Origin.y) * ray.InverseDirection.y;
+        float tyFar = ((ray.Sign[1] ? Min.y : Max.y) - ray.Origin.y) * ray.InverseDirection.y;
+        float tzNear = ((ray.Sign[2] ? Max.z : Min.z) - ray.Origin.z) * ray.InverseDirection.z;
+        float tzFar = ((ray.Sign[2] ? Min.z : Max.z) - ray.Origin.z) * ray.InverseDirection.z;
+
+        tEntry = glm::max(glm::max(txNear, tyNear), glm::max(tzNear, ray.TMin));
+        tExit = glm::min(glm::min(txFar, tyFar), glm::min(tzFar, ray.TMax));
+
+        return tEntry <= tExit;
+    }
+
+    bool Intersect(const Ray &ray) const {
+        float tEntry, tExit;
+        return Intersect(ray, tEntry, tExit);
+    }
+};
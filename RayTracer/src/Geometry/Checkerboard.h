@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/// Material lookup for planes: alternates between two materials in unit squares, or uses the first material everywhere
+/// when there is no second one.
+struct Checkerboard {
+    glm::vec3 Position{0.0f};
+    glm::vec3 Normal{0.0f, 1.0f, 0.0f};
+    glm::vec3 WidthAxis{1.0f, 0.0f, 0.0f};
+    glm::vec3 HeightAxis{0.0f, 0.0f, 1.0f};
+    int MaterialIndex = 0;
+    int MaterialIndex2 = -1;
+
+    Checkerboard() = default;
+    explicit Checkerboard(int materialIndex) : MaterialIndex(materialIndex) {}
+
+    Checkerboard(const glm::vec3 &position, const glm::vec3 &normal, int materialIndex, int materialIndex2)
+        : Position(position), Normal(glm::normalize(normal)), MaterialIndex(materialIndex), MaterialIndex2(materialIndex2) {
+        // set axes
+        if (normal == glm::vec3(0.0f, 1.0f, 0.0f) || normal == glm::vec3(0.0f, -1.0f, 0.0f) ||
+            normal == glm::vec3(0.0f, 0.0f, 1.0f)) {
+            WidthAxis = glm::vec3(1.0f, 0.0f, 0.0f);
+        } else if (normal == glm::vec3(0.0f, 0.0f, -1.0f)) {
+            WidthAxis = glm::vec3(-1.0f, 0.0f, 0.0f);
+        } else if (normal == glm::vec3(1.0f, 0.0f, 0.0f)) {
+            WidthAxis = glm::vec3(0.0f, 0.0f, -1.0f);
+        } else if (normal == glm::vec3(-1.0f, 0.0f, 0.0f)) {
+            WidthAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        } else {
+            WidthAxis = glm::normalize(glm::cross(normal, glm::vec3(0.0f, 0.0f, 1.0f)));
+        }
+        HeightAxis = glm::cross(WidthAxis, normal);
+    }
+
+    int GetMaterialIndex(const glm::vec3 &point) const {
+        if (MaterialIndex2 == -1) {
+            return MaterialIndex;
+        }
+
+        float x = glm::dot(point - Position, WidthAxis);
+        float z = glm::dot(point - Position, HeightAxis);
+
+        float dx = glm::floor(Position.x - x);
+        float dz = glm::floor(Position.z - z);
+        int i = (int)(dx + dz);
+
+        if (i % 2) {
+            return MaterialIndex;
+        } else {
+            return MaterialIndex2;
+        }
+    }
+};
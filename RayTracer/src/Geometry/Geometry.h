@@ -1,20 +1,39 @@
 #pragma once
 
 #include "../Ray.h"
+#include "Bounds.h"
 
 struct Intersection {
     float T = 0.0f;
     int GeometryIndex = -1;
 };
 
+/// Everything shading needs about a hit point, computed in one pass so that transforms and SDF gradients are evaluated
+/// once per hit instead of once per query.
+struct SurfaceInteraction {
+    glm::vec3 Position{0.0f};      // world space
+    glm::vec3 Normal{0.0f};        // world space
+    glm::vec3 LocalPosition{0.0f}; // in the space of the primitive that was hit, below any transforms
+    int MaterialIndex = 0;
+};
+
 class Geometry {
   public:
     Geometry(int materialIndex) : m_MaterialIndex(materialIndex) {}
     virtual ~Geometry() = default;
 
+    /// Distance to the closest hit within the ray's interval (TMin, TMax), or -1 if there is none.
     virtual float Intersect(const Ray &ray) const = 0;
+    /// Any-hit query for shadow rays, true if Intersect would report a hit. Overrides may skip computing the distance.
+    virtual bool Occluded(const Ray &ray) const { return Intersect(ray) > 0.0f; }
     virtual glm::vec3 GetNormal(const glm::vec3 &point) const = 0;
     virtual int GetMaterialIndex(const glm::vec3 &point) const { return m_MaterialIndex; }
+    /// Normal, material and local position at a point on the surface.
+    virtual SurfaceInteraction GetSurfaceInteraction(const glm::vec3 &point) const {
+        return SurfaceInteraction{point, GetNormal(point), point, GetMaterialIndex(point)};
+    }
+    /// World space bounds of the geometry, infinite bounds keep the geometry out of the acceleration structures.
+    virtual Bounds GetBounds() const { return Bounds::Infinite(); }
 
   protected:
     int m_MaterialIndex = 0;
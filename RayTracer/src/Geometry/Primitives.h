@@ -0,0 +1,159 @@
+#pragma once
+
+#include "../Ray.h"
+#include "Bounds.h"
+#include "Checkerboard.h"
+
+#include <glm/glm.hpp>
+#include <utility>
+
+// Plain data and intersection kernels of the analytic primitives. They are shared by the geometry classes used for
+// editing and the compiled scene used for tracing, and are inline so the compiled scene's dispatch can inline them.
+
+struct SpherePrimitive {
+    glm::vec3 Position{0.0f};
+    float Radius = 0.5f;
+    int MaterialIndex = 0;
+
+    float Intersect(const Ray &ray) const {
+        glm::vec3 oc = ray.Origin - Position;
+        float a = glm::dot(ray.Direction, ray.Direction);
+        float halfB = glm::dot(ray.Direction, oc);
+        float c = glm::dot(oc, oc) - Radius * Radius;
+
+        // b^2 - ac computed from the closest approach to the centre, which doesn't cancel out for small or distant
+        // spheres
+        glm::vec3 closest = oc - (halfB / a) * ray.Direction;
+        float discriminant = a * (Radius * Radius - glm::dot(closest, closest));
+
+        if (discriminant < 0.0f) {
+            return -1.0f;
+        }
+
+        // roots computed without subtracting nearly equal values
+        float q = -(halfB + (halfB >= 0.0f ? 1.0f : -1.0f) * glm::sqrt(discriminant));
+        float t0 = q / a;
+        float t1 = q != 0.0f ? c / q : t0;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+
+        if (t0 > ray.TMin && t0 < ray.TMax) {
+            return t0;
+        }
+        if (t1 > ray.TMin && t1 < ray.TMax) {
+            return t1;
+        }
+
+        return -1.0f;
+    }
+
+    bool Occluded(const Ray &ray) const {
+        glm::vec3 oc = ray.Origin - Position;
+        float a = glm::dot(ray.Direction, ray.Direction);
+        float halfB = glm::dot(ray.Direction, oc);
+        float c = glm::dot(oc, oc) - Radius * Radius;
+
+        // p(t) = a t^2 + 2 halfB t + c is negative inside the sphere, the surface is crossed in the interval if p
+        // changes sign between its ends, or if both ends are outside and the ray dips inside in between. No square root
+        // is needed.
+        float pMin = (a * ray.TMin + 2.0f * halfB) * ray.TMin + c;
+        float pMax = (a * ray.TMax + 2.0f * halfB) * ray.TMax + c;
+
+        if ((pMin < 0.0f) != (pMax < 0.0f)) {
+            return true;
+        }
+        if (pMin < 0.0f) {
+            return false; // inside for the whole interval
+        }
+
+        float tClosest = -halfB / a;
+        return tClosest > ray.TMin && tClosest < ray.TMax && halfB * halfB >= a * c;
+    }
+
+    glm::vec3 GetNormal(const glm::vec3 &point) const { return glm::normalize(point - Position); }
+    Bounds GetBounds() const { return Bounds(Position - Radius, Position + Radius); }
+};
+
+struct BoxPrimitive {
+    glm::vec3 Min{0.0f};
+    glm::vec3 Max{1.0f};
+    int MaterialIndex = 0;
+
+    float Intersect(const Ray &ray) const {
+        // slab test with the cached reciprocal direction, near and far planes selected by the direction's sign
+        float t_x_low = ((ray.Sign[0] ? Max.x : Min.x) - ray.Origin.x) * ray.InverseDirection.x;
+        float t_x_high = ((ray.Sign[0] ? Min.x : Max.x) - ray.Origin.x) * ray.InverseDirection.x;
+        float t_y_low = ((ray.Sign[1] ? Max.y : Min.y) - ray.Origin.y) * ray.InverseDirection.y;
+        float t_y_high = ((ray.Sign[1] ? Min.y : Max.y) - ray.Origin.y) * ray.InverseDirection.y;
+        float t_z_low = ((ray.Sign[2] ? Max.z : Min.z) - ray.Origin.z) * ray.InverseDirection.z;
+        float t_z_high = ((ray.Sign[2] ? Min.z : Max.z) - ray.Origin.z) * ray.InverseDirection.z;
+
+        float t_low = glm::max(glm::max(t_x_low, t_y_low), t_z_low);
+        float t_high = glm::min(glm::min(t_x_high, t_y_high), t_z_high);
+
+        if (t_low > t_high) {
+            return -1.0f;
+        }
+
+        // entering the box, or leaving it if the ray starts inside
+        if (t_low > ray.TMin && t_low < ray.TMax) {
+            return t_low;
+        }
+        if (t_high > ray.TMin && t_high < ray.TMax) {
+            return t_high;
+        }
+
+        return -1.0f;
+    }
+
+    glm::vec3 GetNormal(const glm::vec3 &point) const {
+        float dx_min = glm::abs(point.x - Min.x);
+        float dx_max = glm::abs(point.x - Max.x);
+        float dy_min = glm::abs(point.y - Min.y);
+        float dy_max = glm::abs(point.y - Max.y);
+        float dz_min = glm::abs(point.z - Min.z);
+        float dz_max = glm::abs(point.z - Max.z);
+
+        float min = glm::min(glm::min(glm::min(dx_min, dy_min), dz_min), glm::min(glm::min(dx_max, dy_max), dz_max));
+
+        if (min == dx_min) {
+            return glm::vec3(-1.0f, 0.0f, 0.0f);
+        } else if (min == dx_max) {
+            return glm::vec3(1.0f, 0.0f, 0.0f);
+        } else if (min == dy_min) {
+            return glm::vec3(0.0f, -1.0f, 0.0f);
+        } else if (min == dy_max) {
+            return glm::vec3(0.0f, 1.0f, 0.0f);
+        } else if (min == dz_min) {
+            return glm::vec3(0.0f, 0.0f, -1.0f);
+        } else {
+            return glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    }
+
+    Bounds GetBounds() const { return Bounds(Min, Max); }
+};
+
+struct PlanePrimitive {
+    glm::vec3 Position{0.0f};
+    glm::vec3 Normal{0.0f, 1.0f, 0.0f};
+    Checkerboard Material;
+
+    float Intersect(const Ray &ray) const {
+        float denom = glm::dot(ray.Direction, Normal);
+
+        if (glm::abs(denom) > 1e-6f) {
+            glm::vec3 p0l0 = Position - ray.Origin;
+            float t = glm::dot(p0l0, Normal) / denom;
+            if (t > ray.TMin && t < ray.TMax) {
+                return t;
+            }
+        }
+
+        return -1.0f;
+    }
+
+    glm::vec3 GetNormal() const { return Normal; }
+    int GetMaterialIndex(const glm::vec3 &point) const { return Material.GetMaterialIndex(point); }
+};
@@ -12,13 +12,16 @@ class SDFAABB : public SDFGeometry {
         m_R = (max - min) / 2.0f;
     }
 
-  private:
-    float Distance(const glm::vec3 &point) const override {
-        glm::vec3 q = glm::abs(point - m_Center) - m_R + m_Rounded;
-        return glm::length(glm::max(q, glm::vec3(0.0f))) +
-               glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f) - m_Rounded;
+    Bounds GetBounds() const override { return Bounds(m_Center - m_R, m_Center + m_R); }
+
+    int Compile(std::vector<SDFInstruction> &program) const override {
+        program.push_back({SDFInstruction::Opcode::Box, false, m_Center, glm::vec4(m_R, m_Rounded)});
+        return 1;
     }
 
+  private:
+    float Distance(const glm::vec3 &point) const override { return SDF::Box(point, m_Center, m_R, m_Rounded); }
+
   private:
     glm::vec3 m_Center{0.0f};
     glm::vec3 m_R{0.0f};
@@ -28,22 +28,78 @@ class SDFConstructive : public SDFGeometry {
         case Operation::Union:
             return glm::min(leftDistance, rightDistance);
         case Operation::SmoothUnion:
-            return SmoothMin(leftDistance, rightDistance, m_Smoothing);
+            return SDF::SmoothMin(leftDistance, rightDistance, m_Smoothing);
         case Operation::Intersection:
             return glm::max(leftDistance, rightDistance);
         case Operation::SmoothIntersection:
-            return SmoothMax(leftDistance, rightDistance, m_Smoothing);
+            return SDF::SmoothMax(leftDistance, rightDistance, m_Smoothing);
         case Operation::Difference:
             return glm::max(leftDistance, -rightDistance);
         case Operation::SmoothDifference:
-            return SmoothMax(leftDistance, -rightDistance, m_Smoothing);
+            return SDF::SmoothMax(leftDistance, -rightDistance, m_Smoothing);
         }
     }
 
-  private:
-    float SmoothMax(float a, float b, float k) const { return log2(exp2(k * a) + exp2(k * b)) / k; }
-    float SmoothMin(float a, float b, float k) const {
-        return -log2(exp2(-k * a) + exp2(-k * b)) / k;
+    Bounds GetBounds() const override {
+        Bounds left = m_Left->GetBounds();
+        Bounds right = m_Right->GetBounds();
+
+        switch (m_Operation) {
+        case Operation::Union:
+            left.Grow(right);
+            return left;
+        case Operation::SmoothUnion: {
+            // the smooth minimum is at most 1 / k below the regular minimum, so the surface can bulge out by that much
+            left.Grow(right);
+            float bulge = 1.0f / m_Smoothing;
+            return Bounds(left.Min - bulge, left.Max + bulge);
+        }
+        case Operation::Intersection:
+        case Operation::SmoothIntersection:
+            return Bounds(glm::max(left.Min, right.Min), glm::min(left.Max, right.Max));
+        case Operation::Difference:
+        case Operation::SmoothDifference:
+            return left;
+        }
+        return Bounds::Infinite();
+    }
+
+    int Compile(std::vector<SDFInstruction> &program) const override {
+        std::vector<SDFInstruction> left, right;
+        int leftDepth = m_Left->Compile(left);
+        int rightDepth = m_Right->Compile(right);
+
+        // evaluating the deeper child first keeps only one value on the stack while it runs
+        bool swapped = rightDepth > leftDepth;
+        const std::vector<SDFInstruction> &first = swapped ? right : left;
+        const std::vector<SDFInstruction> &second = swapped ? left : right;
+        program.insert(program.end(), first.begin(), first.end());
+        program.insert(program.end(), second.begin(), second.end());
+
+        SDFInstruction::Opcode opcode = SDFInstruction::Opcode::Union;
+        switch (m_Operation) {
+        case Operation::Union:
+            opcode = SDFInstruction::Opcode::Union;
+            break;
+        case Operation::SmoothUnion:
+            opcode = SDFInstruction::Opcode::SmoothUnion;
+            break;
+        case Operation::Intersection:
+            opcode = SDFInstruction::Opcode::Intersection;
+            break;
+        case Operation::SmoothIntersection:
+            opcode = SDFInstruction::Opcode::SmoothIntersection;
+            break;
+        case Operation::Difference:
+            opcode = SDFInstruction::Opcode::Difference;
+            break;
+        case Operation::SmoothDifference:
+            opcode = SDFInstruction::Opcode::SmoothDifference;
+            break;
+        }
+        program.push_back({opcode, swapped, glm::vec3(0.0f), glm::vec4(m_Smoothing, 0.0f, 0.0f, 0.0f)});
+
+        return leftDepth == rightDepth ? leftDepth + 1 : glm::max(leftDepth, rightDepth);
     }
 
   private:
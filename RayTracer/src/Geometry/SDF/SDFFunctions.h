@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../../Ray.h"
+#include "../Bounds.h"
+
+#include <glm/glm.hpp>
+#include <limits>
+
+/// Distance functions and sphere tracing shared by the SDF geometry classes and the compiled SDF programs.
+namespace SDF {
+constexpr int MAX_ITERATIONS = 500;
+constexpr float EPSILON = 0.001f;
+constexpr float MAX_DEPTH = 1000.0f;
+constexpr float NORMAL_EPSILON = 0.0001f;
+
+inline float Sphere(const glm::vec3 &point, const glm::vec3 &position, float radius) {
+    return glm::length(point - position) - radius;
+}
+
+inline float Box(const glm::vec3 &point, const glm::vec3 &center, const glm::vec3 &halfExtent, float rounded) {
+    glm::vec3 q = glm::abs(point - center) - halfExtent + rounded;
+    return glm::length(glm::max(q, glm::vec3(0.0f))) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f) - rounded;
+}
+
+/// Sphere cut off at height with a shell of the given thickness, w is the radius of the opening.
+inline float HollowSphere(const glm::vec3 &point, const glm::vec3 &position, float radius, float thickness, float height,
+                          float w) {
+    glm::vec3 movedPoint = point - position;
+    glm::vec2 q = {glm::length(glm::vec2(movedPoint.x, movedPoint.z)), movedPoint.y};
+
+    return (height * q.x < w * q.y) ? (glm::length(q - glm::vec2(w, height)))
+                                    : (glm::abs(glm::length(q) - radius) - thickness);
+}
+
+inline float Plane(const glm::vec3 &point, const glm::vec3 &position, const glm::vec3 &normal) {
+    return glm::dot(point - position, normal);
+}
+
+inline float SmoothMax(float a, float b, float k) { return log2(exp2(k * a) + exp2(k * b)) / k; }
+inline float SmoothMin(float a, float b, float k) { return -log2(exp2(-k * a) + exp2(-k * b)) / k; }
+
+/**
+ * Part of the ray's interval worth marching: inside the bounds and no further than MAX_DEPTH.
+ * @return false if the ray misses the bounds.
+ */
+inline bool Clip(const Ray &ray, const Bounds &bounds, float &startDepth, float &maxDepth) {
+    Ray clipped = ray;
+    clipped.TMax = glm::min(ray.TMax, MAX_DEPTH);
+
+    if (bounds.IsFinite()) {
+        return bounds.Intersect(clipped, startDepth, maxDepth);
+    }
+
+    startDepth = clipped.TMin;
+    maxDepth = clipped.TMax;
+    return true;
+}
+
+/**
+ * Sphere traces from startDepth.
+ * @param convex Stop as soon as the distance grows, which can only mean moving away from a convex shape.
+ * @param distance Callable returning the signed distance at a point.
+ * @return Depth of the first step closer than EPSILON, or -1.
+ */
+template <typename DistanceFn>
+float March(const Ray &ray, float startDepth, float maxDepth, bool convex, DistanceFn &&distance) {
+    float depth = startDepth;
+    float lastDist = std::numeric_limits<float>::max();
+
+    for (int _i = 0; _i < MAX_ITERATIONS; _i++) {
+        float dist = distance(ray.Origin + ray.Direction * depth);
+
+        if (dist < EPSILON) {
+            // a hit at the start of the interval is the surface the ray leaves from
+            return depth > ray.TMin ? depth : -1.0f;
+        }
+
+        depth += dist;
+
+        if (depth >= maxDepth || (convex && dist >= lastDist)) {
+            return -1.0f;
+        }
+
+        lastDist = dist;
+    }
+
+    return -1.0f;
+}
+
+/// Normal from the gradient of the distance function, sampled at the corners of a tetrahedron around the point: four
+/// distance evaluations instead of the six of central differences.
+template <typename DistanceFn> glm::vec3 Normal(const glm::vec3 &point, DistanceFn &&distance) {
+    const glm::vec3 k0(1.0f, -1.0f, -1.0f);
+    const glm::vec3 k1(-1.0f, -1.0f, 1.0f);
+    const glm::vec3 k2(-1.0f, 1.0f, -1.0f);
+    const glm::vec3 k3(1.0f, 1.0f, 1.0f);
+
+    glm::vec3 normal = k0 * distance(point + k0 * NORMAL_EPSILON) + k1 * distance(point + k1 * NORMAL_EPSILON) +
+                       k2 * distance(point + k2 * NORMAL_EPSILON) + k3 * distance(point + k3 * NORMAL_EPSILON);
+
+    return glm::normalize(normal);
+}
+} // namespace SDF
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "../Checkerboard.h"
 #include "../Geometry.h"
+#include "SDFProgram.h"
+
+#include <vector>
 
 class SDFGeometry : public Geometry {
   public:
@@ -11,6 +15,16 @@ class SDFGeometry : public Geometry {
 
     virtual float Distance(const glm::vec3 &point) const = 0;
 
+    /**
+     * Appends the distance function, flattened into instructions, to the program.
+     * @return Stack depth needed to evaluate the appended instructions.
+     */
+    virtual int Compile(std::vector<SDFInstruction> &program) const = 0;
+    /// Material lookup of the surface, only planes use more than one material.
+    virtual Checkerboard GetMaterial() const { return Checkerboard(m_MaterialIndex); }
+
+    bool IsConvex() const { return m_IsConvex; }
+
   protected:
     bool m_IsConvex = false;
 };
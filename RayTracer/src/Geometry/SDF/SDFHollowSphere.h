@@ -12,11 +12,18 @@ class SDFHollowSphere : public SDFGeometry {
     }
 
     float Distance(const glm::vec3 &point) const override {
-        glm::vec3 movedPoint = point - m_Position;
-        glm::vec2 q = {glm::length(glm::vec2(movedPoint.x, movedPoint.z)), movedPoint.y};
+        return SDF::HollowSphere(point, m_Position, m_Radius, m_Thickness, m_Height, m_w);
+    }
+
+    int Compile(std::vector<SDFInstruction> &program) const override {
+        program.push_back(
+            {SDFInstruction::Opcode::HollowSphere, false, m_Position, glm::vec4(m_Radius, m_Thickness, m_Height, m_w)});
+        return 1;
+    }
 
-        return (m_Height * q.x < m_w * q.y) ? (glm::length(q - glm::vec2(m_w, m_Height)))
-                                            : (glm::abs(glm::length(q) - m_Radius) - m_Thickness);
+    Bounds GetBounds() const override {
+        float extent = m_Radius + m_Thickness;
+        return Bounds(m_Position - extent, m_Position + extent);
     }
 
   private:
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "SDFFunctions.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+
+/// One step of a flattened SDF tree. Leaves push their distance on a stack, operations pop two distances and push the
+/// combined one.
+struct SDFInstruction {
+    enum class Opcode : uint8_t {
+        Sphere,
+        Box,
+        HollowSphere,
+        Plane,
+        Union,
+        SmoothUnion,
+        Intersection,
+        SmoothIntersection,
+        Difference,
+        SmoothDifference
+    };
+
+    Opcode Op = Opcode::Sphere;
+    bool Swapped = false; // the right operand was evaluated first and is below the left one on the stack
+    // sphere: position; box: center; hollow sphere: position; plane: position
+    glm::vec3 Position{0.0f};
+    // sphere: radius; box: half extent, rounding; hollow sphere: radius, thickness, height, w; plane: normal;
+    // operations: smoothing
+    glm::vec4 Parameters{0.0f};
+};
+
+/// Deepest stack an SDF program may need. Children are ordered so the deeper one is evaluated first, which keeps the
+/// depth logarithmic in the number of leaves.
+#define SDF_PROGRAM_STACK_SIZE 32
+
+/// Evaluates the distance of the flattened SDF tree in program[0, count) at a point.
+inline float EvaluateSDFProgram(const SDFInstruction *program, uint32_t count, const glm::vec3 &point) {
+    using Opcode = SDFInstruction::Opcode;
+
+    float stack[SDF_PROGRAM_STACK_SIZE];
+    int top = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SDFInstruction &instruction = program[i];
+        const glm::vec4 &p = instruction.Parameters;
+
+        switch (instruction.Op) {
+        case Opcode::Sphere:
+            stack[top++] = SDF::Sphere(point, instruction.Position, p.x);
+            continue;
+        case Opcode::Box:
+            stack[top++] = SDF::Box(point, instruction.Position, glm::vec3(p), p.w);
+            continue;
+        case Opcode::HollowSphere:
+            stack[top++] = SDF::HollowSphere(point, instruction.Position, p.x, p.y, p.z, p.w);
+            continue;
+        case Opcode::Plane:
+            stack[top++] = SDF::Plane(point, instruction.Position, glm::vec3(p));
+            continue;
+        default:
+            break;
+        }
+
+        float right = stack[--top];
+        float left = stack[top - 1];
+        if (instruction.Swapped) {
+            std::swap(left, right);
+        }
+
+        float &result = stack[top - 1];
+        switch (instruction.Op) {
+        case Opcode::Union:
+            result = glm::min(left, right);
+            break;
+        case Opcode::SmoothUnion:
+            result = SDF::SmoothMin(left, right, p.x);
+            break;
+        case Opcode::Intersection:
+            result = glm::max(left, right);
+            break;
+        case Opcode::SmoothIntersection:
+            result = SDF::SmoothMax(left, right, p.x);
+            break;
+        case Opcode::Difference:
+            result = glm::max(left, -right);
+            break;
+        case Opcode::SmoothDifference:
+            result = SDF::SmoothMax(left, -right, p.x);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return stack[0];
+}
@@ -9,10 +9,15 @@ class SDFSphere : public SDFGeometry {
         m_IsConvex = true;
     }
 
-    float Distance(const glm::vec3 &point) const override {
-        return glm::length(point - m_Position) - m_Radius;
+    float Distance(const glm::vec3 &point) const override { return SDF::Sphere(point, m_Position, m_Radius); }
+
+    int Compile(std::vector<SDFInstruction> &program) const override {
+        program.push_back({SDFInstruction::Opcode::Sphere, false, m_Position, glm::vec4(m_Radius, 0.0f, 0.0f, 0.0f)});
+        return 1;
     }
 
+    Bounds GetBounds() const override { return Bounds(m_Position - m_Radius, m_Position + m_Radius); }
+
   private:
     glm::vec3 m_Position{0.0f};
     float m_Radius = 1.0f;
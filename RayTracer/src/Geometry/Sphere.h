@@ -1,16 +1,20 @@
 #pragma once
 
 #include "Geometry.h"
+#include "Primitives.h"
 
 class Sphere : public Geometry {
   public:
     Sphere(const glm::vec3 &position, float radius, int materialIndex = 0)
-        : m_Position(position), m_Radius(radius), Geometry(materialIndex) {}
+        : m_Primitive{position, radius, materialIndex}, Geometry(materialIndex) {}
 
-    float Intersect(const Ray &ray) const override;
-    glm::vec3 GetNormal(const glm::vec3 &point) const override;
+    float Intersect(const Ray &ray) const override { return m_Primitive.Intersect(ray); }
+    bool Occluded(const Ray &ray) const override { return m_Primitive.Occluded(ray); }
+    glm::vec3 GetNormal(const glm::vec3 &point) const override { return m_Primitive.GetNormal(point); }
+    Bounds GetBounds() const override { return m_Primitive.GetBounds(); }
+
+    const SpherePrimitive &GetPrimitive() const { return m_Primitive; }
 
   private:
-    glm::vec3 m_Position{0.0f};
-    float m_Radius = 0.5f;
+    SpherePrimitive m_Primitive;
 };
@@ -2,33 +2,81 @@
 
 #include "glm/gtc/matrix_transform.hpp"
 
+namespace {
+glm::mat4 ComposeTransform(glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale) {
+    glm::mat4 transform = glm::mat4(1.0f);
+    transform = glm::translate(transform, translation);
+    transform = glm::rotate(transform, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(transform, scale);
+}
+} // namespace
+
 Transform::Transform(glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale,
-                     std::unique_ptr<Geometry> child)
-    : m_Child(std::move(child)), Geometry(-1) {
-    m_Transform = glm::mat4(1.0f);
-    m_Transform = glm::translate(m_Transform, translation);
-    m_Transform = glm::rotate(m_Transform, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    m_Transform = glm::rotate(m_Transform, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    m_Transform = glm::rotate(m_Transform, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    m_Transform = glm::scale(m_Transform, scale);
+                     std::shared_ptr<const Geometry> child)
+    : Transform(ComposeTransform(translation, rotation, scale), std::move(child)) {}
+
+Transform::Transform(const glm::mat4 &transform, std::shared_ptr<const Geometry> child)
+    : m_Transform(transform), m_Child(std::move(child)), Geometry(-1) {
     m_TransformInverse = glm::inverse(m_Transform);
+    m_NormalMatrix = glm::transpose(glm::mat3(m_TransformInverse));
+
+    // the child can't change, so its bounds are computed once
+    m_ChildBounds = m_Child->GetBounds();
+    if (!m_ChildBounds.IsFinite()) {
+        m_Bounds = m_ChildBounds;
+        return;
+    }
+
+    // bounds of the eight transformed corners
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = {(i & 1) ? m_ChildBounds.Max.x : m_ChildBounds.Min.x,
+                            (i & 2) ? m_ChildBounds.Max.y : m_ChildBounds.Min.y,
+                            (i & 4) ? m_ChildBounds.Max.z : m_ChildBounds.Min.z};
+        m_Bounds.Grow(glm::vec3(m_Transform * glm::vec4(corner, 1.0f)));
+    }
+}
+
+bool Transform::TransformRay(const Ray &ray, Ray &transformedRay) const {
+    // the direction isn't normalised, so distances along the ray (and its interval) are the same in both spaces
+    transformedRay = Ray(glm::vec3(m_TransformInverse * glm::vec4(ray.Origin, 1.0f)),
+                         glm::vec3(m_TransformInverse * glm::vec4(ray.Direction, 0.0f)), ray.TMin, ray.TMax);
+
+    // cheap rejection against the child's local bounds before running its (possibly expensive) intersection
+    return !m_ChildBounds.IsFinite() || m_ChildBounds.Intersect(transformedRay);
 }
 
 float Transform::Intersect(const Ray &ray) const {
     Ray transformedRay;
-    transformedRay.Origin = glm::vec3(m_TransformInverse * glm::vec4(ray.Origin, 1.0f));
-    transformedRay.Direction = glm::vec3(m_TransformInverse * glm::vec4(ray.Direction, 0.0f));
+    if (!TransformRay(ray, transformedRay)) {
+        return -1.0f;
+    }
 
     return m_Child->Intersect(transformedRay);
 }
 
+bool Transform::Occluded(const Ray &ray) const {
+    Ray transformedRay;
+    return TransformRay(ray, transformedRay) && m_Child->Occluded(transformedRay);
+}
+
 glm::vec3 Transform::GetNormal(const glm::vec3 &point) const {
     glm::vec3 transformedPoint = glm::vec3(m_TransformInverse * glm::vec4(point, 1.0f));
     glm::vec3 localNormal = m_Child->GetNormal(transformedPoint);
-    return glm::vec3(m_Transform * glm::vec4(localNormal, 0.0f));
+    return glm::normalize(m_NormalMatrix * localNormal);
 }
 
 int Transform::GetMaterialIndex(const glm::vec3 &point) const {
     glm::vec3 transformedPoint = glm::vec3(m_TransformInverse * glm::vec4(point, 1.0f));
     return m_Child->GetMaterialIndex(transformedPoint);
 }
+
+SurfaceInteraction Transform::GetSurfaceInteraction(const glm::vec3 &point) const {
+    glm::vec3 transformedPoint = glm::vec3(m_TransformInverse * glm::vec4(point, 1.0f));
+
+    SurfaceInteraction interaction = m_Child->GetSurfaceInteraction(transformedPoint);
+    interaction.Position = point;
+    interaction.Normal = glm::normalize(m_NormalMatrix * interaction.Normal);
+    return interaction;
+}
@@ -4,17 +4,39 @@
 
 #include <memory>
 
+/// Places a child geometry in the world. The child can be shared between several transforms, which is how prototype
+/// instances are represented: only the ray is moved into the child's space, the child itself is stored once.
 class Transform : public Geometry {
   public:
     Transform(glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale,
-              std::unique_ptr<Geometry> child);
+              std::shared_ptr<const Geometry> child);
+    /// Transform from an affine matrix, e.g. a chain of transforms collapsed into one.
+    Transform(const glm::mat4 &transform, std::shared_ptr<const Geometry> child);
 
     float Intersect(const Ray &ray) const override;
+    bool Occluded(const Ray &ray) const override;
     glm::vec3 GetNormal(const glm::vec3 &point) const override;
     int GetMaterialIndex(const glm::vec3 &point) const override;
+    SurfaceInteraction GetSurfaceInteraction(const glm::vec3 &point) const override;
+    Bounds GetBounds() const override { return m_Bounds; }
+
+    const glm::mat4 &GetTransform() const { return m_Transform; }
+    const glm::mat4 &GetTransformInverse() const { return m_TransformInverse; }
+    const std::shared_ptr<const Geometry> &GetChild() const { return m_Child; }
+    /// Inverse transpose of the linear part, keeps normals perpendicular under non-uniform scale.
+    const glm::mat3 &GetNormalMatrix() const { return m_NormalMatrix; }
+    const Bounds &GetChildBounds() const { return m_ChildBounds; }
+
+  private:
+    /// Moves the ray into the child's space, false if it misses the child's bounds.
+    bool TransformRay(const Ray &ray, Ray &transformedRay) const;
 
   private:
     glm::mat4 m_Transform;
     glm::mat4 m_TransformInverse;
-    std::unique_ptr<Geometry> m_Child;
+    glm::mat3 m_NormalMatrix;
+    std::shared_ptr<const Geometry> m_Child;
+
+    Bounds m_ChildBounds; // bounds of the child in its own space
+    Bounds m_Bounds;      // world space bounds
 };
@@ -0,0 +1,177 @@
+#include "DirectionTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+// levels of the quadtree below the root, the smallest leaves cover 4 pi / 4^MAX_DEPTH steradians
+#define MAX_DEPTH 20
+// largest float below 1, remapped random numbers are clamped to it
+#define ONE_MINUS_EPSILON 0.99999994f
+
+namespace {
+/// Cylindrical coordinates (cos theta, phi) of the direction, scaled to [0, 1)^2.
+glm::vec2 ToSquare(const glm::vec3 &direction) {
+    float cosTheta = std::min(std::max(direction.z, -1.0f), 1.0f);
+    float phi = std::atan2(direction.y, direction.x);
+    if (phi < 0.0f) {
+        phi += glm::two_pi<float>();
+    }
+    return glm::min(glm::vec2((cosTheta + 1.0f) * 0.5f, phi * glm::one_over_two_pi<float>()),
+                    glm::vec2(ONE_MINUS_EPSILON));
+}
+
+glm::vec3 ToDirection(const glm::vec2 &point) {
+    float cosTheta = 2.0f * point.x - 1.0f;
+    float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+    float phi = glm::two_pi<float>() * point.y;
+    return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+/// Quadrant of the unit square holding the point, and the point moved into that quadrant's own unit square.
+int Descend(glm::vec2 &point) {
+    int quadrant = (point.x >= 0.5f ? 1 : 0) | (point.y >= 0.5f ? 2 : 0);
+    point = point * 2.0f - glm::vec2((float)(quadrant & 1), (float)(quadrant >> 1));
+    return quadrant;
+}
+} // namespace
+
+DirectionTree::DirectionTree() : m_Nodes(1) {}
+
+void DirectionTree::Record(const glm::vec3 &direction, float amount) {
+    glm::vec2 point = ToSquare(direction);
+    uint32_t node = 0;
+    while (true) {
+        int quadrant = Descend(point);
+        uint32_t child = m_Nodes[node].Children[quadrant];
+        if (child == 0) {
+            m_Nodes[node].Sums[quadrant].Add(amount);
+            return;
+        }
+        node = child;
+    }
+}
+
+void DirectionTree::Build() {
+    // children always come after their parent, so going backwards sums every node before its parent reads it
+    for (size_t node = m_Nodes.size(); node-- > 0;) {
+        Node &current = m_Nodes[node];
+        for (int quadrant = 0; quadrant < 4; quadrant++) {
+            if (current.Children[quadrant] != 0) {
+                current.Sums[quadrant].Store(m_Nodes[current.Children[quadrant]].GetTotal());
+            }
+        }
+    }
+}
+
+float DirectionTree::GetTotal() const {
+    return m_Nodes[0].GetTotal();
+}
+
+glm::vec3 DirectionTree::Sample(glm::vec2 u) const {
+    glm::vec2 origin(0.0f);
+    float size = 1.0f;
+    uint32_t node = 0;
+    while (true) {
+        const Node &current = m_Nodes[node];
+        float sums[4] = {current.Sums[0].Load(), current.Sums[1].Load(), current.Sums[2].Load(), current.Sums[3].Load()};
+
+        // the column by its light, then the quadrant within it, each reusing what is left of its random number
+        float total = sums[0] + sums[1] + sums[2] + sums[3];
+        float left = total > 0.0f ? (sums[0] + sums[2]) / total : 0.5f;
+        int quadrant = 0;
+        if (u.x < left) {
+            u.x = u.x / left;
+        } else {
+            u.x = (u.x - left) / (1.0f - left);
+            quadrant |= 1;
+        }
+        float column = sums[quadrant] + sums[quadrant | 2];
+        float bottom = column > 0.0f ? sums[quadrant] / column : 0.5f;
+        if (u.y < bottom) {
+            u.y = u.y / bottom;
+        } else {
+            u.y = (u.y - bottom) / (1.0f - bottom);
+            quadrant |= 2;
+        }
+        u = glm::min(u, glm::vec2(ONE_MINUS_EPSILON));
+
+        size *= 0.5f;
+        origin += glm::vec2((float)(quadrant & 1), (float)(quadrant >> 1)) * size;
+        if (current.Children[quadrant] == 0) {
+            return ToDirection(origin + u * size);
+        }
+        node = current.Children[quadrant];
+    }
+}
+
+float DirectionTree::Pdf(const glm::vec3 &direction) const {
+    // density over the unit square, which is 4 pi times larger than the sphere
+    float pdf = 0.25f * glm::one_over_pi<float>();
+    glm::vec2 point = ToSquare(direction);
+    uint32_t node = 0;
+    while (true) {
+        const Node &current = m_Nodes[node];
+        float total = current.GetTotal();
+        int quadrant = Descend(point);
+        if (total <= 0.0f) {
+            return 0.0f;
+        }
+        pdf *= 4.0f * current.Sums[quadrant].Load() / total;
+        node = current.Children[quadrant];
+        if (node == 0 || pdf <= 0.0f) {
+            return pdf;
+        }
+    }
+}
+
+glm::vec3 DirectionTree::SampleHemisphere(glm::vec2 u, const glm::vec3 &normal) const {
+    glm::vec3 direction = Sample(u);
+    float cosine = glm::dot(direction, normal);
+    return cosine < 0.0f ? direction - 2.0f * cosine * normal : direction;
+}
+
+float DirectionTree::HemispherePdf(const glm::vec3 &direction, const glm::vec3 &normal) const {
+    // the direction is reached by sampling it or its mirror image below the surface
+    float cosine = glm::dot(direction, normal);
+    if (cosine < 0.0f) {
+        return 0.0f;
+    }
+    return Pdf(direction) + Pdf(direction - 2.0f * cosine * normal);
+}
+
+DirectionTree DirectionTree::Refine(float threshold) const {
+    // with nothing recorded the light is taken as uniform, which subdivides the first few levels evenly
+    float total = GetTotal();
+    float fractions[4];
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        fractions[quadrant] = total > 0.0f ? m_Nodes[0].Sums[quadrant].Load() / total : 0.25f;
+    }
+
+    DirectionTree refined;
+    Subdivide(refined, 0, 0, fractions, 1, total, threshold);
+    return refined;
+}
+
+void DirectionTree::Subdivide(DirectionTree &refined, uint32_t node, int source, const float fractions[4], int depth,
+                              float total, float threshold) const {
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        if (depth >= MAX_DEPTH || fractions[quadrant] <= threshold) {
+            continue;
+        }
+
+        uint32_t child = (uint32_t)refined.m_Nodes.size();
+        refined.m_Nodes.emplace_back();
+        refined.m_Nodes[node].Children[quadrant] = child;
+
+        // the quadrant's light is split as this tree's children split it, evenly below its leaves
+        uint32_t sourceChild = source >= 0 ? m_Nodes[source].Children[quadrant] : 0;
+        float childFractions[4];
+        for (int i = 0; i < 4; i++) {
+            childFractions[i] = sourceChild != 0 && total > 0.0f ? m_Nodes[sourceChild].Sums[i].Load() / total
+                                                                 : fractions[quadrant] * 0.25f;
+        }
+        Subdivide(refined, child, sourceChild != 0 ? (int)sourceChild : -1, childFractions, depth + 1, total,
+                  threshold);
+    }
+}
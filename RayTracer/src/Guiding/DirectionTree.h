@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/// Float that several threads add to at once. Copies take a snapshot and are only made between frames.
+struct AtomicFloat {
+    std::atomic<float> Value{0.0f};
+
+    AtomicFloat() = default;
+    AtomicFloat(const AtomicFloat &other) : Value(other.Load()) {}
+    AtomicFloat &operator=(const AtomicFloat &other) {
+        Store(other.Load());
+        return *this;
+    }
+
+    float Load() const { return Value.load(std::memory_order_relaxed); }
+    void Store(float value) { Value.store(value, std::memory_order_relaxed); }
+    void Add(float amount) {
+        float current = Value.load(std::memory_order_relaxed);
+        while (!Value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+/// Light arriving at a region of space over the directions of the sphere, learnt from the paths through it. A quadtree
+/// over the cylindrical coordinates (cos theta, phi) of the directions, which map the sphere onto the unit square
+/// without changing areas: each quadrant is picked by its share of the light recorded in it, and a uniform point in a
+/// leaf is a uniform direction in the part of the sphere it covers.
+class DirectionTree {
+  public:
+    DirectionTree();
+
+    /// Adds light arriving from the direction to the leaf holding it, thread safe.
+    void Record(const glm::vec3 &direction, float amount);
+    /// Sums the light recorded in the leaves up to the root, must be called before the tree is sampled or refined.
+    void Build();
+    /// Light recorded over the whole sphere.
+    float GetTotal() const;
+
+    /**
+     * Direction picked in proportion to the light recorded, the tree must have some.
+     * @param u Uniform random numbers in [0, 1).
+     */
+    glm::vec3 Sample(glm::vec2 u) const;
+    /// Probability per unit solid angle of Sample returning the direction.
+    float Pdf(const glm::vec3 &direction) const;
+    /**
+     * Direction picked like Sample, folded into the hemisphere around the normal: directions below the surface are
+     * mirrored above it, so none are spent where a surface can't scatter light.
+     * @param u Uniform random numbers in [0, 1).
+     */
+    glm::vec3 SampleHemisphere(glm::vec2 u, const glm::vec3 &normal) const;
+    /// Probability per unit solid angle of SampleHemisphere returning the direction, 0 below the surface.
+    float HemispherePdf(const glm::vec3 &direction, const glm::vec3 &normal) const;
+
+    /**
+     * Empty tree subdivided where this one recorded light: down to the quadrants holding at most the given share of its
+     * total, so the next recordings resolve the directions light comes from more finely.
+     */
+    DirectionTree Refine(float threshold) const;
+
+    size_t GetNodeCount() const { return m_Nodes.size(); }
+
+  private:
+    struct Node {
+        AtomicFloat Sums[4];                 // light recorded in each quadrant, x is the low bit of their index
+        uint32_t Children[4] = {0, 0, 0, 0}; // 0 for quadrants that are leaves, the root is never a child
+
+        float GetTotal() const { return Sums[0].Load() + Sums[1].Load() + Sums[2].Load() + Sums[3].Load(); }
+    };
+
+    /**
+     * Adds the children of a node of the refined tree.
+     * @param source Node of this tree covering the same square, -1 if this tree stops above it.
+     * @param fractions Share of this tree's total in each quadrant of the node.
+     */
+    void Subdivide(DirectionTree &refined, uint32_t node, int source, const float fractions[4], int depth, float total,
+                   float threshold) const;
+
+  private:
+    std::vector<Node> m_Nodes; // the root first
+};
@@ -0,0 +1,127 @@
+#include "GuidingField.h"
+
+#include <algorithm>
+#include <cmath>
+
+// regions are split once they record more than this many samples times the square root of the iteration's frames, so
+// they get smaller as the estimates get better (Müller et al. use 12000 at their default sample counts)
+#define REGION_SPLIT_SAMPLES 4000.0f
+// direction trees are subdivided where a quadrant received more than this share of the light
+#define DIRECTION_SPLIT_SHARE 0.01f
+// limits the memory of the field, each region holds two direction trees of a few hundred nodes
+#define MAX_REGIONS 4096
+// iterations last 2^iteration frames, the last one runs forever
+#define MAX_ITERATION 30
+
+void GuidingField::Reset(const Bounds &bounds) {
+    // a cube, so halving along alternating axes keeps the regions close to cubes
+    Bounds finite = bounds.IsFinite() ? bounds : Bounds(glm::vec3(-1.0f), glm::vec3(1.0f));
+    glm::vec3 extent = finite.Extent();
+    float size = std::max(std::max(extent.x, std::max(extent.y, extent.z)), 0.001f);
+    m_Bounds = Bounds(finite.Centroid() - glm::vec3(size * 0.5f), finite.Centroid() + glm::vec3(size * 0.5f));
+
+    m_Nodes.assign(1, Node());
+    m_Regions.clear();
+    m_Regions.emplace_back();
+    m_Iteration = 0;
+    m_IterationFrames = 0;
+}
+
+uint32_t GuidingField::FindRegion(const glm::vec3 &position) const {
+    // points outside the bounds stay on the side of each split nearest to them
+    uint32_t node = 0;
+    while (m_Nodes[node].Children[0] != 0) {
+        const Node &current = m_Nodes[node];
+        node = current.Children[position[current.Axis] >= current.Split ? 1 : 0];
+    }
+    return m_Nodes[node].Region;
+}
+
+const DirectionTree *GuidingField::GetGuide(uint32_t region) const {
+    const DirectionTree &tree = m_Regions[region].Sampling;
+    return tree.GetTotal() > 0.0f ? &tree : nullptr;
+}
+
+void GuidingField::Record(uint32_t region, const glm::vec3 &direction, float radiance, float pdf) {
+    if (!(pdf > 0.0f) || !std::isfinite(radiance)) {
+        return;
+    }
+    m_Regions[region].Building.Record(direction, std::max(radiance, 0.0f) / pdf);
+    m_Regions[region].Samples.Add(1.0f);
+}
+
+bool GuidingField::EndFrame() {
+    if (m_Nodes.empty()) {
+        return false;
+    }
+    m_IterationFrames++;
+    return m_Iteration < MAX_ITERATION && m_IterationFrames >= (1u << m_Iteration);
+}
+
+void GuidingField::Refine(ThreadPool &threads) {
+    float threshold = REGION_SPLIT_SAMPLES * std::sqrt((float)(1u << m_Iteration));
+    SplitLeaves(0, m_Bounds, threshold);
+
+    threads.ParallelFor((uint32_t)m_Regions.size(), [&](uint32_t i) {
+        Region &region = m_Regions[i];
+        region.Building.Build();
+        region.Sampling = region.Building;
+        region.Building = region.Sampling.Refine(DIRECTION_SPLIT_SHARE);
+        region.Samples.Store(0.0f);
+    });
+
+    m_Iteration++;
+    m_IterationFrames = 0;
+}
+
+void GuidingField::SplitLeaves(uint32_t node, const Bounds &bounds, float threshold) {
+    const Node &current = m_Nodes[node];
+    if (current.Children[0] == 0) {
+        Split(node, bounds, threshold);
+        return;
+    }
+
+    Bounds lower = bounds, upper = bounds;
+    lower.Max[current.Axis] = current.Split;
+    upper.Min[current.Axis] = current.Split;
+    uint32_t children[2] = {current.Children[0], current.Children[1]};
+    SplitLeaves(children[0], lower, threshold);
+    SplitLeaves(children[1], upper, threshold);
+}
+
+void GuidingField::Split(uint32_t node, const Bounds &bounds, float threshold) {
+    if (m_Regions[m_Nodes[node].Region].Samples.Load() <= threshold || m_Regions.size() >= MAX_REGIONS) {
+        return;
+    }
+
+    // both halves start from the whole region's trees, and are taken to have recorded half its samples each
+    uint32_t region = m_Nodes[node].Region;
+    float samples = m_Regions[region].Samples.Load() * 0.5f;
+    m_Regions[region].Samples.Store(samples);
+    m_Regions.push_back(m_Regions[region]);
+
+    uint32_t axis = m_Nodes[node].Axis;
+    uint32_t first = (uint32_t)m_Nodes.size();
+    m_Nodes.resize(first + 2);
+    m_Nodes[first].Axis = (axis + 1) % 3;
+    m_Nodes[first].Region = region;
+    m_Nodes[first + 1].Axis = (axis + 1) % 3;
+    m_Nodes[first + 1].Region = (uint32_t)m_Regions.size() - 1;
+    m_Nodes[node].Children[0] = first;
+    m_Nodes[node].Children[1] = first + 1;
+    m_Nodes[node].Split = bounds.Centroid()[axis];
+
+    Bounds lower = bounds, upper = bounds;
+    lower.Max[axis] = m_Nodes[node].Split;
+    upper.Min[axis] = m_Nodes[node].Split;
+    Split(first, lower, threshold);
+    Split(first + 1, upper, threshold);
+}
+
+size_t GuidingField::GetDirectionNodeCount() const {
+    size_t count = 0;
+    for (const Region &region : m_Regions) {
+        count += region.Sampling.GetNodeCount() + region.Building.GetNodeCount();
+    }
+    return count;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Geometry/Bounds.h"
+#include "../Scheduling/ThreadPool.h"
+#include "DirectionTree.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/// Light arriving at every point of the scene from every direction, learnt from the paths of earlier frames so bounces
+/// can be sampled towards where light comes from ("Practical Path Guiding for Efficient Light-Transport Simulation",
+/// Müller et al. 2017). A binary tree splits the scene's bounds in half along alternating axes, and each of its leaves
+/// (a region) holds a DirectionTree of the light recorded in it.
+///
+/// Training runs in iterations of 1, 2, 4, ... frames. During one, paths sample what the regions learnt in the previous
+/// one while recording into a copy, which Refine turns into the new sampling trees at its end: regions through which
+/// many paths went are split, and each region's next copy is subdivided where the light came from. Recording is thread
+/// safe, everything else is called between frames.
+class GuidingField {
+  public:
+    GuidingField() = default;
+
+    /// Drops everything learnt and starts over with a single region covering the bounds.
+    void Reset(const Bounds &bounds);
+    bool IsEmpty() const { return m_Nodes.empty(); }
+
+    /// Region holding the position, points outside the bounds belong to the nearest one. The field must not be empty.
+    uint32_t FindRegion(const glm::vec3 &position) const;
+    /// Distribution learnt for the region, nullptr if no light was recorded there during the previous iteration.
+    const DirectionTree *GetGuide(uint32_t region) const;
+    /**
+     * Adds light arriving in the region from the direction to the region's current copy, thread safe.
+     * @param radiance Light found by a bounce in the direction.
+     * @param pdf Probability of the bounce's direction per unit solid angle.
+     */
+    void Record(uint32_t region, const glm::vec3 &direction, float radiance, float pdf);
+
+    /// Counts a finished frame, true when it ends an iteration and Refine must be called before the next one.
+    bool EndFrame();
+    /// Starts the next iteration, the regions' trees are rebuilt in parallel on the threads.
+    void Refine(ThreadPool &threads);
+
+    /// Completed iterations, the regions have sampled light once it is above 0.
+    uint32_t GetIteration() const { return m_Iteration; }
+    uint32_t GetRegionCount() const { return (uint32_t)m_Regions.size(); }
+    /// Nodes of all the direction trees, sampled and recorded into.
+    size_t GetDirectionNodeCount() const;
+
+  private:
+    struct Node {
+        uint32_t Children[2] = {0, 0}; // halves below and above Split along Axis, 0 for leaves
+        uint32_t Axis = 0;
+        float Split = 0.0f;
+        uint32_t Region = 0; // for leaves
+    };
+    struct Region {
+        DirectionTree Sampling; // learnt during the previous iteration
+        DirectionTree Building; // recorded into during this one
+        AtomicFloat Samples;    // recorded during this iteration
+    };
+
+    /// Splits the leaf, and its halves in turn, until none of them recorded more than the given number of samples.
+    void Split(uint32_t node, const Bounds &bounds, float threshold);
+    /// Splits the leaves below the node like Split.
+    void SplitLeaves(uint32_t node, const Bounds &bounds, float threshold);
+
+  private:
+    std::vector<Node> m_Nodes; // the root first
+    std::vector<Region> m_Regions;
+    Bounds m_Bounds; // cube covered by the root
+
+    uint32_t m_Iteration = 0;
+    uint32_t m_IterationFrames = 0; // frames recorded in the current iteration
+};
@@ -0,0 +1,66 @@
+#include "AliasTable.h"
+
+#include <algorithm>
+
+void AliasTable::Build(const std::vector<float> &weights) {
+    m_Entries.clear();
+    m_Pdf.clear();
+
+    double total = 0.0;
+    for (float weight : weights) {
+        total += weight;
+    }
+    if (weights.empty() || total <= 0.0) {
+        return;
+    }
+
+    uint32_t count = (uint32_t)weights.size();
+    m_Entries.resize(count);
+    m_Pdf.resize(count);
+
+    // each column holds 1/count of the probability, split between its own index and one alias
+    std::vector<double> scaled(count);
+    std::vector<uint32_t> small, large;
+    for (uint32_t i = 0; i < count; i++) {
+        m_Pdf[i] = (float)(weights[i] / total);
+        scaled[i] = weights[i] / total * count;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        uint32_t column = small.back();
+        uint32_t donor = large.back();
+        small.pop_back();
+
+        m_Entries[column] = {(float)scaled[column], donor};
+        scaled[donor] -= 1.0 - scaled[column];
+        if (scaled[donor] < 1.0) {
+            large.pop_back();
+            small.push_back(donor);
+        }
+    }
+
+    // whatever is left is 1 up to rounding
+    for (uint32_t i : small) {
+        m_Entries[i] = {1.0f, i};
+    }
+    for (uint32_t i : large) {
+        m_Entries[i] = {1.0f, i};
+    }
+}
+
+int AliasTable::Sample(float u, float &pdf) const {
+    if (m_Entries.empty()) {
+        pdf = 0.0f;
+        return -1;
+    }
+
+    float scaled = u * m_Entries.size();
+    uint32_t column = std::min((uint32_t)scaled, (uint32_t)m_Entries.size() - 1);
+    const Entry &entry = m_Entries[column];
+
+    uint32_t index = scaled - column < entry.Threshold ? column : entry.Alias;
+    pdf = m_Pdf[index];
+    // rounding can leave a zero weight index in a column of its own
+    return pdf > 0.0f ? (int)index : -1;
+}
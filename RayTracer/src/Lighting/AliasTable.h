@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// Discrete distribution sampled in constant time with Vose's alias method.
+class AliasTable {
+  public:
+    AliasTable() = default;
+
+    /**
+     * Builds the distribution.
+     * @param weights Relative probability of each index, non-negative. Indices with weight 0 are never picked.
+     */
+    void Build(const std::vector<float> &weights);
+
+    /**
+     * Picks an index.
+     * @param u Uniform random number in [0, 1].
+     * @param pdf Set to the probability of the index picked.
+     * @return The index, or -1 if every weight is 0.
+     */
+    int Sample(float u, float &pdf) const;
+
+    float GetPdf(uint32_t index) const { return m_Pdf[index]; }
+    bool IsEmpty() const { return m_Entries.empty(); }
+
+  private:
+    struct Entry {
+        float Threshold = 1.0f; // the column's own index is picked below this, its alias above
+        uint32_t Alias = 0;
+    };
+
+    std::vector<Entry> m_Entries;
+    std::vector<float> m_Pdf;
+};
@@ -0,0 +1,182 @@
+#include "EmitterSampler.h"
+
+#include "../SIMD/Kernels.h"
+#include "../Sampling/Warp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <iostream>
+
+void EmitterSampler::Build(const CompiledScene &compiled, const std::vector<Material> &materials) {
+    m_Emitters.clear();
+    m_PrimitiveEmitters.assign(compiled.GetPrimitiveCount(), -1);
+
+    auto isEmissive = [&](int materialIndex) {
+        return materialIndex >= 0 && materialIndex < (int)materials.size() &&
+               SIMD::Luminance(materials[materialIndex].GetEmission()) > 0.0f;
+    };
+
+    std::vector<float> powers;
+    for (uint32_t i = 0; i < compiled.GetPrimitiveCount(); i++) {
+        Emitter emitter{};
+        float area;
+        if (const SpherePrimitive *sphere = compiled.GetSphere(i); sphere && isEmissive(sphere->MaterialIndex)) {
+            emitter.IsSphere = true;
+            emitter.Sphere = *sphere;
+            emitter.Emission = materials[sphere->MaterialIndex].GetEmission();
+            area = 4.0f * glm::pi<float>() * sphere->Radius * sphere->Radius;
+        } else if (const BoxPrimitive *box = compiled.GetBox(i); box && isEmissive(box->MaterialIndex)) {
+            emitter.IsSphere = false;
+            emitter.Box = *box;
+            emitter.Emission = materials[box->MaterialIndex].GetEmission();
+            area = Bounds(box->Min, box->Max).SurfaceArea();
+        } else {
+            continue;
+        }
+
+        m_PrimitiveEmitters[i] = (int)m_Emitters.size();
+        m_Emitters.push_back(emitter);
+        powers.push_back(SIMD::Luminance(emitter.Emission) * area);
+    }
+
+    m_Selection.Build(powers);
+    if (m_Selection.IsEmpty()) {
+        m_Emitters.clear(); // only degenerate ones, which can't be sampled
+        std::fill(m_PrimitiveEmitters.begin(), m_PrimitiveEmitters.end(), -1);
+    }
+
+    std::cout << "Sampled emitters: " << m_Emitters.size() << std::endl;
+}
+
+bool EmitterSampler::Sample(const glm::vec3 &position, float uEmitter, const glm::vec2 &u, EmitterSample &sample) const {
+    float selectionPdf;
+    int index = m_Selection.Sample(uEmitter, selectionPdf);
+    if (index == -1) {
+        return false;
+    }
+    const Emitter &emitter = m_Emitters[index];
+    sample.Emitter = (uint32_t)index;
+    sample.Emission = emitter.Emission;
+
+    if (emitter.IsSphere) {
+        const SpherePrimitive &sphere = emitter.Sphere;
+        float conePdf = SpherePdf(sphere, position);
+        if (conePdf <= 0.0f) {
+            return false;
+        }
+
+        // uniform direction in the cone around the centre, 1 - cos of its half angle is 1 / (2 pi pdf)
+        glm::vec3 toCentre = sphere.Position - position;
+        float distanceSquared = glm::dot(toCentre, toCentre);
+        glm::vec3 w = toCentre / std::sqrt(distanceSquared);
+        float cosTheta = 1.0f - u.x / (2.0f * glm::pi<float>() * conePdf);
+        float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        float phi = 2.0f * glm::pi<float>() * u.y;
+
+        glm::vec3 tangent, bitangent;
+        Warp::TangentFrame(w, tangent, bitangent);
+
+        sample.Direction = glm::normalize((tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta + w * cosTheta);
+
+        // near side of the sphere along the direction, grazing directions are clamped onto the silhouette
+        float along = glm::dot(sample.Direction, toCentre);
+        float discriminant = sphere.Radius * sphere.Radius - (distanceSquared - along * along);
+        sample.Distance = along - std::sqrt(std::max(0.0f, discriminant));
+        sample.Pdf = selectionPdf * conePdf;
+        return sample.Distance > 0.0f;
+    }
+
+    const BoxPrimitive &box = emitter.Box;
+    float faceAreas[6];
+    float visibleArea = VisibleArea(box, position, faceAreas);
+    if (visibleArea <= 0.0f) {
+        return false;
+    }
+
+    // pick a face by area, reusing what's left of u.x for the point on it; rounding past the end keeps the last face
+    float target = u.x * visibleArea;
+    int face = -1;
+    for (int f = 0; f < 6; f++) {
+        if (faceAreas[f] <= 0.0f) {
+            continue;
+        }
+        face = f;
+        if (target < faceAreas[f]) {
+            break;
+        }
+        target -= faceAreas[f];
+    }
+    float s = std::min(target / faceAreas[face], 1.0f);
+
+    int axis = face / 2;
+    int axisU = (axis + 1) % 3;
+    int axisV = (axis + 2) % 3;
+    glm::vec3 point;
+    point[axis] = face % 2 ? box.Max[axis] : box.Min[axis];
+    point[axisU] = box.Min[axisU] + s * (box.Max[axisU] - box.Min[axisU]);
+    point[axisV] = box.Min[axisV] + u.y * (box.Max[axisV] - box.Min[axisV]);
+
+    glm::vec3 toPoint = point - position;
+    float distanceSquared = glm::dot(toPoint, toPoint);
+    sample.Distance = std::sqrt(distanceSquared);
+    sample.Direction = toPoint / sample.Distance;
+
+    // uniform over the area, converted to solid angle
+    float cosLight = std::abs(sample.Direction[axis]);
+    if (cosLight <= 0.0f) {
+        return false;
+    }
+    sample.Pdf = selectionPdf * distanceSquared / (cosLight * visibleArea);
+    return true;
+}
+
+float EmitterSampler::Pdf(uint32_t primitive, const glm::vec3 &origin, const glm::vec3 &point,
+                          const glm::vec3 &normal) const {
+    if (primitive >= m_PrimitiveEmitters.size() || m_PrimitiveEmitters[primitive] == -1) {
+        return 0.0f;
+    }
+    int index = m_PrimitiveEmitters[primitive];
+    const Emitter &emitter = m_Emitters[index];
+    float selectionPdf = m_Selection.GetPdf(index);
+
+    if (emitter.IsSphere) {
+        return selectionPdf * SpherePdf(emitter.Sphere, origin);
+    }
+
+    float faceAreas[6];
+    float visibleArea = VisibleArea(emitter.Box, origin, faceAreas);
+    glm::vec3 toPoint = point - origin;
+    float distanceSquared = glm::dot(toPoint, toPoint);
+    float cosLight = std::abs(glm::dot(normal, toPoint)) / std::sqrt(distanceSquared);
+    if (visibleArea <= 0.0f || cosLight <= 0.0f) {
+        return 0.0f;
+    }
+    return selectionPdf * distanceSquared / (cosLight * visibleArea);
+}
+
+float EmitterSampler::SpherePdf(const SpherePrimitive &sphere, const glm::vec3 &position) {
+    glm::vec3 toCentre = sphere.Position - position;
+    float distanceSquared = glm::dot(toCentre, toCentre);
+    float radiusSquared = sphere.Radius * sphere.Radius;
+    if (distanceSquared <= radiusSquared) {
+        return 0.0f;
+    }
+
+    // 1 - cos written without the cancellation for small or distant spheres
+    float sinSquared = radiusSquared / distanceSquared;
+    float oneMinusCos = sinSquared / (1.0f + std::sqrt(1.0f - sinSquared));
+    return 1.0f / (2.0f * glm::pi<float>() * oneMinusCos);
+}
+
+float EmitterSampler::VisibleArea(const BoxPrimitive &box, const glm::vec3 &position, float faceAreas[6]) {
+    glm::vec3 extent = box.Max - box.Min;
+    float total = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float area = extent[(axis + 1) % 3] * extent[(axis + 2) % 3];
+        faceAreas[axis * 2] = position[axis] < box.Min[axis] ? area : 0.0f;
+        faceAreas[axis * 2 + 1] = position[axis] > box.Max[axis] ? area : 0.0f;
+        total += faceAreas[axis * 2] + faceAreas[axis * 2 + 1];
+    }
+    return total;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../Compiled/CompiledScene.h"
+#include "../Geometry/Primitives.h"
+#include "../Material.h"
+#include "AliasTable.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/// Emissive top-level spheres and boxes, sampled by solid angle for next event estimation. An emitter is picked in
+/// proportion to its power, then a sphere is sampled uniformly over the cone it subtends and a box uniformly over the
+/// area of the faces turned towards the point. Emissive geometry of other types is only found by bounce rays.
+class EmitterSampler {
+  public:
+    /// Point picked on an emitter, as seen from the point being lit.
+    struct EmitterSample {
+        glm::vec3 Direction; // unit length, towards the emitter
+        float Distance;      // to the point on the emitter
+        glm::vec3 Emission;  // radiance leaving the emitter
+        float Pdf;           // per unit solid angle, including the chance of picking the emitter
+        uint32_t Emitter;
+    };
+
+  public:
+    EmitterSampler() = default;
+
+    /// Collects the emitters, must be called whenever the compiled geometry or the materials change.
+    void Build(const CompiledScene &compiled, const std::vector<Material> &materials);
+
+    /**
+     * Picks a point on an emitter.
+     * @param position Point being lit.
+     * @param uEmitter Uniform random number in [0, 1] picking the emitter.
+     * @param u Uniform random numbers in [0, 1] picking the point on it.
+     * @return false if no emitter can be sampled from the position, e.g. it's inside the one picked.
+     */
+    bool Sample(const glm::vec3 &position, float uEmitter, const glm::vec2 &u, EmitterSample &sample) const;
+
+    /**
+     * Probability per unit solid angle of Sample picking a point that a ray hit, 0 if the primitive isn't an emitter.
+     * @param primitive Top-level primitive hit.
+     * @param origin Where the ray started.
+     * @param point Hit point.
+     * @param normal Surface normal at the hit point.
+     */
+    float Pdf(uint32_t primitive, const glm::vec3 &origin, const glm::vec3 &point, const glm::vec3 &normal) const;
+
+    bool IsEmpty() const { return m_Emitters.empty(); }
+    uint32_t GetCount() const { return (uint32_t)m_Emitters.size(); }
+
+  private:
+    struct Emitter {
+        bool IsSphere;
+        SpherePrimitive Sphere;
+        BoxPrimitive Box;
+        glm::vec3 Emission;
+    };
+
+    /// Per unit solid angle, for the cone of directions from the position to the sphere; 0 from inside it.
+    static float SpherePdf(const SpherePrimitive &sphere, const glm::vec3 &position);
+    /**
+     * Area of the box's faces turned towards the position, 0 from inside it.
+     * @param faceAreas Set to the area of each face seen, indexed by axis * 2 + (1 for the face at Max).
+     */
+    static float VisibleArea(const BoxPrimitive &box, const glm::vec3 &position, float faceAreas[6]);
+
+  private:
+    std::vector<Emitter> m_Emitters;
+    std::vector<int> m_PrimitiveEmitters; // emitter of each top-level primitive, -1 for the others
+    AliasTable m_Selection;
+};
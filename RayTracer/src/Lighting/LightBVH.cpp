@@ -0,0 +1,144 @@
+#include "LightBVH.h"
+
+#include "../Geometry/Bounds.h"
+#include "../SIMD/Kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LightBVH::Build(const std::vector<Light> &lights) {
+    m_Nodes.clear();
+    m_Directional.clear();
+    m_Positions.assign(lights.size(), glm::vec3(0.0f));
+    m_Powers.assign(lights.size(), 0.0f);
+
+    std::vector<uint32_t> pointLights;
+    for (uint32_t i = 0; i < lights.size(); i++) {
+        const Light &light = lights[i];
+        m_Powers[i] = SIMD::Luminance(light.Colour) * light.Intensity;
+        if (m_Powers[i] <= 0.0f) {
+            continue; // never lights anything
+        }
+
+        if (light.Type == LightType::Point) {
+            m_Positions[i] = light.Position;
+            pointLights.push_back(i);
+        } else if (light.Type == LightType::Directional) {
+            m_Directional.push_back({light.Direction, m_Powers[i], i});
+        }
+    }
+
+    if (!pointLights.empty()) {
+        m_Nodes.reserve(2 * pointLights.size() - 1);
+        BuildRecursive(pointLights, 0, (uint32_t)pointLights.size());
+    }
+}
+
+uint32_t LightBVH::BuildRecursive(std::vector<uint32_t> &lights, uint32_t begin, uint32_t end) {
+    uint32_t nodeIndex = (uint32_t)m_Nodes.size();
+    m_Nodes.emplace_back();
+
+    Bounds bounds;
+    float power = 0.0f;
+    for (uint32_t i = begin; i < end; i++) {
+        bounds.Grow(m_Positions[lights[i]]);
+        power += m_Powers[lights[i]];
+    }
+
+    // one light per leaf, so the probability of a light is exact once its leaf is reached
+    if (end - begin == 1) {
+        m_Nodes[nodeIndex] = {bounds.Centroid(), 0.0f, power, lights[begin], true};
+        return nodeIndex;
+    }
+
+    // median split along the widest axis keeps the tree balanced, and with it the cost of a descent
+    int axis = bounds.LargestAxis();
+    uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(lights.begin() + begin, lights.begin() + middle, lights.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return m_Positions[a][axis] < m_Positions[b][axis]; });
+
+    BuildRecursive(lights, begin, middle);
+    uint32_t second = BuildRecursive(lights, middle, end);
+    m_Nodes[nodeIndex] = {bounds.Centroid(), glm::length(bounds.Extent()) * 0.5f, power, second, false};
+    return nodeIndex;
+}
+
+float LightBVH::Importance(const Node &node, const glm::vec3 &position, const glm::vec3 &normal) const {
+    // bound the cosine between the normal and any direction into the node's bounding sphere
+    glm::vec3 toCentre = node.Centre - position;
+    float distance = glm::length(toCentre);
+    if (distance <= node.Radius) {
+        return node.Power;
+    }
+
+    float cosCentre = glm::dot(normal, toCentre) / distance;
+    if (node.Radius == 0.0f) {
+        return node.Power * std::max(0.0f, cosCentre); // a single light
+    }
+    float sinSpread = node.Radius / distance;
+    float cosSpread = std::sqrt(std::max(0.0f, 1.0f - sinSpread * sinSpread));
+    if (cosCentre >= cosSpread) {
+        return node.Power; // the normal points into the sphere
+    }
+
+    // cos(centre angle - spread angle)
+    float sinCentre = std::sqrt(std::max(0.0f, 1.0f - cosCentre * cosCentre));
+    float cosBound = cosCentre * cosSpread + sinCentre * sinSpread;
+    return node.Power * std::max(0.0f, cosBound);
+}
+
+int LightBVH::Sample(const glm::vec3 &position, const glm::vec3 &normal, float u, float &pdf) const {
+    pdf = 0.0f;
+
+    // directional lights and the tree as a whole compete at the top
+    float rootImportance = m_Nodes.empty() ? 0.0f : Importance(m_Nodes[0], position, normal);
+    float total = rootImportance;
+    for (const DirectionalLight &light : m_Directional) {
+        total += light.Power * std::max(0.0f, glm::dot(normal, -light.Direction));
+    }
+    if (total <= 0.0f) {
+        return -1;
+    }
+
+    float target = u * total;
+    for (const DirectionalLight &light : m_Directional) {
+        float importance = light.Power * std::max(0.0f, glm::dot(normal, -light.Direction));
+        if (target < importance) {
+            pdf = importance / total;
+            return (int)light.Index;
+        }
+        target -= importance;
+    }
+    if (rootImportance <= 0.0f) {
+        return -1; // rounding ran past the last directional light
+    }
+
+    // descend, choosing each child in proportion to its importance and reusing what's left of u
+    pdf = rootImportance / total;
+    u = std::min(target / rootImportance, 1.0f);
+    uint32_t nodeIndex = 0;
+    while (!m_Nodes[nodeIndex].Leaf) {
+        uint32_t first = nodeIndex + 1;
+        uint32_t second = m_Nodes[nodeIndex].Offset;
+        float firstImportance = Importance(m_Nodes[first], position, normal);
+        float secondImportance = Importance(m_Nodes[second], position, normal);
+        float sum = firstImportance + secondImportance;
+        if (sum <= 0.0f) {
+            pdf = 0.0f;
+            return -1;
+        }
+
+        float firstProbability = firstImportance / sum;
+        if (u < firstProbability || secondImportance <= 0.0f) {
+            pdf *= firstProbability;
+            u = std::min(u / firstProbability, 1.0f);
+            nodeIndex = first;
+        } else {
+            pdf *= 1.0f - firstProbability;
+            u = std::min((u - firstProbability) / (1.0f - firstProbability), 1.0f);
+            nodeIndex = second;
+        }
+    }
+
+    return (int)m_Nodes[nodeIndex].Offset;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../Light.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/// Hierarchy over the lights for picking one in proportion to an estimate of its contribution at a point, in
+/// logarithmic time. A node's estimate is its power times the largest cosine its bounds can make with the surface
+/// normal, so lights behind the surface are never picked. Directional lights are kept beside the tree and weighed the
+/// same way at the top.
+class LightBVH {
+  public:
+    LightBVH() = default;
+
+    void Build(const std::vector<Light> &lights);
+
+    /**
+     * Picks a light to sample at a surface point.
+     * @param position Point being lit.
+     * @param normal Surface normal at the point.
+     * @param u Uniform random number in [0, 1].
+     * @param pdf Set to the probability of the light picked.
+     * @return Index of the light, or -1 if none can reach the point.
+     */
+    int Sample(const glm::vec3 &position, const glm::vec3 &normal, float u, float &pdf) const;
+
+    bool IsEmpty() const { return m_Nodes.empty() && m_Directional.empty(); }
+
+  private:
+    struct Node {
+        glm::vec3 Centre{0.0f}; // of the sphere bounding the node's lights, cheaper to test than their box
+        float Radius = 0.0f;
+        float Power = 0.0f;
+        uint32_t Offset = 0; // index of the light for leaves, index of the second child for interior nodes
+        bool Leaf = false;
+    };
+    struct DirectionalLight {
+        glm::vec3 Direction;
+        float Power;
+        uint32_t Index;
+    };
+
+    uint32_t BuildRecursive(std::vector<uint32_t> &lights, uint32_t begin, uint32_t end);
+    float Importance(const Node &node, const glm::vec3 &position, const glm::vec3 &normal) const;
+
+  private:
+    std::vector<Node> m_Nodes;
+    std::vector<glm::vec3> m_Positions; // of every light, indexed by light index
+    std::vector<float> m_Powers;        // of every light, indexed by light index
+    std::vector<DirectionalLight> m_Directional;
+};
@@ -0,0 +1,73 @@
+#include "LightSampler.h"
+
+#include "../SIMD/Kernels.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+// up to this many lights every one gets a shadow ray, beyond it a few are picked at random
+#define MAX_ALL_LIGHTS 4
+// up to this many lights the power table is used, beyond it the hierarchy also skips lights behind the surface
+#define MAX_POWER_LIGHTS 64
+
+void LightSampler::Build(const std::vector<Light> &lights, LightSamplingType requested) {
+    m_Type = requested == LightSamplingType::Auto ? LightSampling::Choose(lights.size()) : requested;
+    m_PowerTable = AliasTable();
+    m_Hierarchy = LightBVH();
+
+    if (m_Type == LightSamplingType::Power) {
+        std::vector<float> powers(lights.size());
+        for (size_t i = 0; i < lights.size(); i++) {
+            powers[i] = SIMD::Luminance(lights[i].Colour) * lights[i].Intensity;
+        }
+        m_PowerTable.Build(powers);
+    } else if (m_Type == LightSamplingType::BVH) {
+        m_Hierarchy.Build(lights);
+    }
+
+    std::cout << "Light sampling: " << LightSampling::ToString(m_Type)
+              << (requested == LightSamplingType::Auto ? " (auto)" : "") << " over " << lights.size() << " lights"
+              << std::endl;
+}
+
+int LightSampler::Sample(const glm::vec3 &position, const glm::vec3 &normal, float u, float &pdf) const {
+    if (m_Type == LightSamplingType::BVH) {
+        return m_Hierarchy.Sample(position, normal, u, pdf);
+    }
+    return m_PowerTable.Sample(u, pdf);
+}
+
+LightSamplingType LightSampling::Choose(size_t lightCount) {
+    if (lightCount <= MAX_ALL_LIGHTS) {
+        return LightSamplingType::All;
+    }
+    return lightCount <= MAX_POWER_LIGHTS ? LightSamplingType::Power : LightSamplingType::BVH;
+}
+
+const char *LightSampling::ToString(LightSamplingType type) {
+    switch (type) {
+    case LightSamplingType::Auto:
+        return "auto";
+    case LightSamplingType::All:
+        return "all";
+    case LightSamplingType::Power:
+        return "power";
+    case LightSamplingType::BVH:
+        return "bvh";
+    }
+    return "unknown";
+}
+
+std::optional<LightSamplingType> LightSampling::FromString(const std::string &name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    for (LightSamplingType type :
+         {LightSamplingType::Auto, LightSamplingType::All, LightSamplingType::Power, LightSamplingType::BVH}) {
+        if (lower == ToString(type)) {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
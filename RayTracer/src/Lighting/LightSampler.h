@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../Light.h"
+#include "AliasTable.h"
+#include "LightBVH.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// How the lights to sample at each bounce are chosen.
+enum class LightSamplingType {
+    Auto,  // chosen from the number of lights when the scene loads
+    All,   // every light, one shadow ray each
+    Power, // a few lights picked in proportion to their power
+    BVH,   // a few lights picked by a light hierarchy, by power and orientation
+};
+
+/// Picks the lights that direct lighting is estimated from. Lights picked at random are weighted by the reciprocal of
+/// their probability, which keeps the estimate unbiased.
+class LightSampler {
+  public:
+    LightSampler() = default;
+
+    /// Rebuilds the structures for the requested type, must be called whenever the lights change.
+    void Build(const std::vector<Light> &lights, LightSamplingType requested);
+
+    LightSamplingType GetType() const { return m_Type; }
+
+    /**
+     * Picks a light to sample at a surface point, only valid when the type isn't All.
+     * @param position Point being lit.
+     * @param normal Surface normal at the point.
+     * @param u Uniform random number in [0, 1].
+     * @param pdf Set to the probability of the light picked.
+     * @return Index of the light, or -1 if none can light the point.
+     */
+    int Sample(const glm::vec3 &position, const glm::vec3 &normal, float u, float &pdf) const;
+
+  private:
+    LightSamplingType m_Type = LightSamplingType::All;
+    AliasTable m_PowerTable;
+    LightBVH m_Hierarchy;
+};
+
+namespace LightSampling {
+/// Picks the cheapest type that keeps the noise from many lights down.
+LightSamplingType Choose(size_t lightCount);
+
+const char *ToString(LightSamplingType type);
+std::optional<LightSamplingType> FromString(const std::string &name);
+} // namespace LightSampling
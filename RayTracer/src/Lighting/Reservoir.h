@@ -0,0 +1,47 @@
+#pragma once
+
+/// Light picked out of a stream of candidates by weighted reservoir sampling, for resampling direct lighting
+/// ("Spatiotemporal reservoir resampling for real-time ray tracing with dynamic direct lighting", Bitterli et al.
+/// 2020). Each candidate is kept with a chance proportional to its weight, so the reservoir holds one light but stands
+/// for every candidate it has seen, and merging reservoirs gives one that stands for the candidates of all of them.
+struct LightReservoir {
+    int LightIndex = -1;    // kept light, -1 if none
+    float Target = 0.0f;    // target function of the kept light at the surface the reservoir is for
+    float WeightSum = 0.0f; // of the candidates seen
+    float Count = 0.0f;     // candidates seen
+    float Weight = 0.0f;    // of the kept light's contribution, in place of one over its probability; set by Finalize
+
+    /**
+     * Streams a candidate through the reservoir.
+     * @param target Light the candidate would bring to the surface, up to a constant factor (the target function).
+     * @param weight Target function over the probability the candidate was drawn with.
+     * @param count Candidates it stands for.
+     * @param u Uniform random number in [0, 1].
+     */
+    void Update(int lightIndex, float target, float weight, float count, float u) {
+        WeightSum += weight;
+        Count += count;
+        if (weight > 0.0f && u * WeightSum < weight) {
+            LightIndex = lightIndex;
+            Target = target;
+        }
+    }
+
+    /**
+     * Streams the light kept by another reservoir through this one, standing for all the candidates that one saw.
+     * @param target Target function of the other reservoir's light at this reservoir's surface.
+     */
+    void Merge(const LightReservoir &other, float target, float u) {
+        Update(other.LightIndex, target, target * other.Weight * other.Count, other.Count, u);
+    }
+
+    /// Sets Weight once every candidate has been streamed, all of which could have been the kept light.
+    void Finalize() { Finalize(Count); }
+    /**
+     * Sets Weight once every candidate has been streamed, when merged reservoirs of other surfaces may hold candidates
+     * that could never have been the kept light here. Counting only those that could keeps the weight unbiased
+     * (the 1 / Z weights of Bitterli et al.).
+     * @param count Candidates drawn at surfaces that could have picked the kept light.
+     */
+    void Finalize(float count) { Weight = Target > 0.0f && count > 0.0f ? WeightSum / (count * Target) : 0.0f; }
+};
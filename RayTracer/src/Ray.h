@@ -1,8 +1,33 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <limits>
 
+/// Ray with the interval (TMin, TMax) in which hits are accepted. InverseDirection and Sign are derived from Direction,
+/// so set the direction with the constructor or SetDirection to keep them in sync.
 struct Ray {
-    glm::vec3 Origin;
-    glm::vec3 Direction;
+    glm::vec3 Origin{0.0f};
+    glm::vec3 Direction{0.0f, 0.0f, 1.0f};
+    float TMin = 0.0f;
+    float TMax = std::numeric_limits<float>::max();
+
+    glm::vec3 InverseDirection{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), 1.0f};
+    int Sign[3] = {0, 0, 0}; // 1 if the direction is negative along the axis
+
+    Ray() = default;
+    Ray(const glm::vec3 &origin, const glm::vec3 &direction, float tMin = 0.0f,
+        float tMax = std::numeric_limits<float>::max())
+        : Origin(origin), TMin(tMin), TMax(tMax) {
+        SetDirection(direction);
+    }
+
+    void SetDirection(const glm::vec3 &direction) {
+        Direction = direction;
+        InverseDirection = 1.0f / direction;
+        Sign[0] = InverseDirection.x < 0.0f;
+        Sign[1] = InverseDirection.y < 0.0f;
+        Sign[2] = InverseDirection.z < 0.0f;
+    }
+
+    glm::vec3 At(float t) const { return Origin + Direction * t; }
 };
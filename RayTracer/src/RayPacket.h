@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Ray.h"
+
+/// Pixels per packet along each axis. A packet is a block of neighbouring pixels, so its rays start at (or near) the
+/// camera and point in almost the same direction.
+#define PACKET_WIDTH 4
+#define PACKET_HEIGHT 2
+#define PACKET_SIZE (PACKET_WIDTH * PACKET_HEIGHT)
+
+/// PACKET_SIZE rays stored one array per component, lane i of every array belongs to ray i. Lanes past Count are
+/// padding with an empty interval, they never report a hit. See SIMD::KernelTable for the kernels.
+struct RayPacket {
+    alignas(32) float OriginX[PACKET_SIZE];
+    alignas(32) float OriginY[PACKET_SIZE];
+    alignas(32) float OriginZ[PACKET_SIZE];
+    alignas(32) float DirectionX[PACKET_SIZE];
+    alignas(32) float DirectionY[PACKET_SIZE];
+    alignas(32) float DirectionZ[PACKET_SIZE];
+    alignas(32) float InverseDirectionX[PACKET_SIZE];
+    alignas(32) float InverseDirectionY[PACKET_SIZE];
+    alignas(32) float InverseDirectionZ[PACKET_SIZE];
+    alignas(32) float TMin[PACKET_SIZE];
+    alignas(32) float TMax[PACKET_SIZE];
+    int Count = 0;
+
+    /// Fills the packet with the rays, count must not exceed PACKET_SIZE.
+    RayPacket(const Ray *rays, int count) : Count(count) {
+        for (int lane = 0; lane < PACKET_SIZE; lane++) {
+            const Ray &ray = rays[lane < count ? lane : 0];
+            OriginX[lane] = ray.Origin.x;
+            OriginY[lane] = ray.Origin.y;
+            OriginZ[lane] = ray.Origin.z;
+            DirectionX[lane] = ray.Direction.x;
+            DirectionY[lane] = ray.Direction.y;
+            DirectionZ[lane] = ray.Direction.z;
+            InverseDirectionX[lane] = ray.InverseDirection.x;
+            InverseDirectionY[lane] = ray.InverseDirection.y;
+            InverseDirectionZ[lane] = ray.InverseDirection.z;
+            TMin[lane] = lane < count ? ray.TMin : 0.0f;
+            TMax[lane] = lane < count ? ray.TMax : -1.0f;
+        }
+    }
+
+    /// Ray in the given lane, with its interval shrunk to the hits found so far.
+    Ray GetRay(int lane) const {
+        return Ray(glm::vec3(OriginX[lane], OriginY[lane], OriginZ[lane]),
+                   glm::vec3(DirectionX[lane], DirectionY[lane], DirectionZ[lane]), TMin[lane], TMax[lane]);
+    }
+
+    /// True if the ray in the lane points towards negative values along the axis.
+    bool IsNegative(int lane, int axis) const {
+        const float *inverseDirection[3] = {InverseDirectionX, InverseDirectionY, InverseDirectionZ};
+        return inverseDirection[axis][lane] < 0.0f;
+    }
+};
@@ -1,6 +1,8 @@
 #include "Camera.h"
 #include "Renderer.h"
+#include "SIMD/Kernels.h"
 #include "Scene.h"
+#include "Scheduling/NUMA.h"
 #include "Walnut/Application.h"
 #include "Walnut/EntryPoint.h"
 #include "Walnut/Image.h"
@@ -8,13 +10,21 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <glm/gtc/type_ptr.hpp>
 #include <memory>
 
 class MainLayer : public Walnut::Layer {
   public:
-    MainLayer() : m_Camera(SceneLoader::LoadCameraSettings("camera.toml")), m_Scene(SceneLoader::LoadScene("scene.toml")) {}
+    MainLayer(const std::string &scenePath)
+        : m_Camera(SceneLoader::LoadCameraSettings(scenePath)), m_Scene(SceneLoader::LoadScene(scenePath)) {
+        // ray directions are filled by the threads that render each row, keeping them in their node's memory
+        m_Camera.SetRowExecutor([this](uint32_t rowCount, const std::function<void(uint32_t)> &row) {
+            m_Renderer.ForEachRow(rowCount, row);
+        });
+    }
 
     virtual void OnUpdate(float deltaTime) override {
         if (m_Camera.OnUpdate(deltaTime)) { // if camera moved
@@ -28,11 +38,71 @@ class MainLayer : public Walnut::Layer {
         ImGui::Checkbox("Render", &m_ShouldRender);
         ImGui::Text("Last Render Time: %.3f ms", m_LastRenderTime);
         ImGui::Text("%.1f FPS", 1000.0f / m_LastRenderTime);
+        ImGui::Text("%.2f Mrays/s", m_Renderer.GetRayCount() / (m_LastRenderTime * 1000.0f));
         ImGui::Text("Render Resolution: %dx%d", m_ViewportWidth, m_ViewportHeight);
+        ImGui::Text("Acceleration: %s", Acceleration::ToString(m_Scene.Acceleration));
+        ImGui::Text("Light sampling: %s over %zu lights", LightSampling::ToString(m_Scene.LightSelection.GetType()),
+                    m_Scene.Lights.size());
+        if (m_Scene.LightSelection.GetType() != LightSamplingType::All) {
+            ImGui::SliderInt("Light Samples", &m_Renderer.GetSettings().LightSamples, 1, 16);
+        }
+        // the first hits are lit differently, so the samples accumulated so far are dropped
+        if (!m_Scene.Lights.empty() && ImGui::Checkbox("Reservoir Lighting", &m_Renderer.GetSettings().ReservoirLighting)) {
+            m_Renderer.ResetFrameIndex();
+        }
+        if (!m_Scene.Emitters.IsEmpty()) {
+            ImGui::Checkbox("Sample Emitters", &m_Renderer.GetSettings().SampleEmitters);
+        }
         ImGui::SliderFloat("Render Scale", &m_Renderer.GetSettings().RenderScale, 0.1f, 1.0f);
-        ImGui::SliderInt("Max Bounces", &m_Renderer.GetSettings().MaxBounces, 1, 10);
+        ImGui::SliderInt("Max Bounces", &m_Renderer.GetSettings().MaxBounces, 1, 64);
+        ImGui::Checkbox("Russian Roulette", &m_Renderer.GetSettings().RussianRoulette);
+        if (m_Renderer.GetSettings().RussianRoulette) {
+            ImGui::SliderInt("Roulette Depth", &m_Renderer.GetSettings().RouletteDepth, 1, 16);
+        }
+        ImGui::Text("Average path length: %.2f", m_Renderer.GetAveragePathLength());
+        ImGui::Checkbox("Path Guiding", &m_Renderer.GetSettings().PathGuiding);
+        if (m_Renderer.GetSettings().PathGuiding) {
+            ImGui::SliderFloat("Guiding Fraction", &m_Renderer.GetSettings().GuidingFraction, 0.0f, 0.9f);
+            const GuidingField &guiding = m_Renderer.GetGuidingField();
+            ImGui::Text("Guiding: %u iterations, %u regions, %zu direction nodes", guiding.GetIteration(),
+                        guiding.GetRegionCount(), guiding.GetDirectionNodeCount());
+        }
         ImGui::Checkbox("Accumulate", &m_Renderer.GetSettings().Accumulate);
         ImGui::Checkbox("Jitter", &m_Renderer.GetSettings().Jitter);
+        // the variance estimate needs every sample since the last reset
+        if (ImGui::Checkbox("Adaptive Sampling", &m_Renderer.GetSettings().AdaptiveSampling)) {
+            m_Renderer.ResetFrameIndex();
+        }
+        if (m_Renderer.GetSettings().AdaptiveSampling) {
+            ImGui::SliderInt("Min Samples", &m_Renderer.GetSettings().MinSamples, 2, 256);
+            ImGui::SliderFloat("Error Threshold", &m_Renderer.GetSettings().ErrorThreshold, 0.001f, 0.2f, "%.3f");
+            ImGui::Checkbox("Sample Density", &m_Renderer.GetSettings().ShowSampleDensity);
+            ImGui::Text("%.1f%% of pixels sampled", m_Renderer.GetSampledPixels() * 100.0f);
+        }
+        ImGui::Checkbox("Tile Culling", &m_Renderer.GetSettings().TileCulling);
+        ImGui::Checkbox("Ray Packets", &m_Renderer.GetSettings().RayPackets);
+        ImGui::Checkbox("Wavefront", &m_Renderer.GetSettings().Wavefront);
+        if (m_Renderer.GetSettings().Wavefront) {
+            ImGui::Checkbox("Sort Paths", &m_Renderer.GetSettings().SortPaths);
+        }
+        ImGui::SliderInt("Tile Size", &m_Renderer.GetSettings().TileSize, 0, 128, m_Renderer.GetSettings().TileSize ? "%d" : "Auto");
+        ImGui::SliderInt("Threads", &m_Renderer.GetSettings().ThreadCount, 0, 256, m_Renderer.GetSettings().ThreadCount ? "%d" : "Auto");
+        ImGui::Checkbox("Pin Threads", &m_Renderer.GetSettings().PinThreads);
+        ImGui::Checkbox("Reserve UI Core", &m_Renderer.GetSettings().ReserveUICore);
+        const TileScheduler::Statistics &tiles = m_Renderer.GetScheduler().GetStatistics();
+        ImGui::Text("Tiles: %zu of %upx on %u threads", m_Renderer.GetScheduler().GetTileTimes().size(), m_Renderer.GetTileSize(),
+                    tiles.WorkerCount);
+        ImGui::Text("Slowest tile %.2f ms, %u stolen, %.0f%% busy", tiles.SlowestTile, tiles.Steals, tiles.Utilisation * 100.0f);
+        ImGui::Checkbox("Huge Pages", &m_Renderer.GetSettings().HugePages);
+        if (NUMA::GetTopology().GetNodeCount() > 1) {
+            ImGui::Checkbox("Replicate Scene", &m_Renderer.GetSettings().ReplicateScene);
+        }
+        if (m_Renderer.GetRowPlacement() >= 0.0f) {
+            ImGui::Text("NUMA nodes: %u, %u remote tiles, %.0f%% rows placed on their node",
+                        NUMA::GetTopology().GetNodeCount(), tiles.RemoteTiles, m_Renderer.GetRowPlacement() * 100.0f);
+        } else {
+            ImGui::Text("NUMA nodes: %u, %u remote tiles", NUMA::GetTopology().GetNodeCount(), tiles.RemoteTiles);
+        }
         if (ImGui::Button("Reset")) {
             m_Renderer.ResetFrameIndex();
         }
@@ -150,8 +220,20 @@ Walnut::Application *Walnut::CreateApplication(int argc, char **argv) {
     Walnut::ApplicationSpecification spec;
     spec.Name = "Ray Tracer";
 
+    // the scene file can be given as an argument, and --isa=<name> forces the kernels' instruction set
+    std::string scenePath = "scene.toml";
+    const char *isa = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--isa=", 6) == 0) {
+            isa = argv[i] + 6;
+        } else {
+            scenePath = argv[i];
+        }
+    }
+    SIMD::SelectKernels(isa);
+
     Walnut::Application *app = new Walnut::Application(spec);
-    app->PushLayer<MainLayer>();
+    app->PushLayer(std::make_shared<MainLayer>(scenePath));
     app->SetMenubarCallback([app]() {
         if (ImGui::BeginMenu("File")) {
             if (ImGui::MenuItem("Exit")) {
@@ -1,25 +1,87 @@
 #include "Renderer.h"
 
+#include "Acceleration/Frustum.h"
 #include "RTRandom.h"
+#include "SIMD/Kernels.h"
 #include "glm/geometric.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
-#include <execution>
+#include <glm/gtc/constants.hpp>
 
-namespace Utils {
-/// Clamp a colour to the range [0, 1] and convert it to an RGBA integer.
-static uint32_t ConvertToRGBA(const glm::vec4 &color) {
-    glm::vec4 clampedColor = glm::clamp(color, 0.0f, 1.0f);
+#define JITTER_RADIUS 0.003f
+#define CULLING_TILE_SIZE 16
+// tile sizes are multiples of the packet size, so packets never straddle tiles
+#define MIN_TILE_SIZE 8
+#define MAX_TILE_SIZE 64
+#define TILES_PER_WORKER 8
+// image rows checked for their placement after a resize
+#define PLACEMENT_SAMPLES 64
+// adaptive sampling holds pixels darker than this to the error of this luminance, so they don't need endless samples
+#define MIN_ERROR_LUMINANCE 0.05f
+// shadow rays towards emitters stop this fraction of the distance short, so they don't hit the emitter itself
+#define EMITTER_SHADOW_EPSILON 0.0001f
+// bounce directions drawn together by the wavefront integrator
+#define BOUNCE_BATCH_SIZE 64
+// largest share of the bounces path guiding samples, the BSDF keeps the rest so light the guide hasn't seen is found
+#define MAX_GUIDING_FRACTION 0.9f
+// light candidates drawn for each camera ray's hit per frame, before any reuse
+#define RESERVOIR_CANDIDATES 4
+// a reservoir taken over from the last frame counts for at most this many times the candidates drawn in this one, so
+// old light choices give way to new ones
+#define RESERVOIR_HISTORY 20.0f
+// reservoirs of neighbouring pixels merged into each pixel's, picked within this many pixels of it; wider disks
+// reach lights that are blocked at the pixel more often, which darkens shadow edges
+#define RESERVOIR_NEIGHBOURS 5
+#define RESERVOIR_RADIUS 5
+// reservoirs are reused between hits whose normals are within about 25 degrees, and which lie within this fraction of
+// their distance to the camera from each other's plane
+#define RESERVOIR_NORMAL_SIMILARITY 0.9f
+#define RESERVOIR_DEPTH_SIMILARITY 0.05f
 
-    uint8_t r = (uint8_t)(clampedColor.r * 255.0f);
-    uint8_t g = (uint8_t)(clampedColor.g * 255.0f);
-    uint8_t b = (uint8_t)(clampedColor.b * 255.0f);
-    uint8_t a = (uint8_t)(clampedColor.a * 255.0f);
+namespace {
+// rays traced by the current thread since the last flush into m_RayCount
+thread_local uint64_t s_ThreadRayCount = 0;
+// paths started and path segments traced by the current thread, flushed like the ray count
+thread_local uint64_t s_ThreadPathCount = 0;
+thread_local uint64_t s_ThreadPathSegmentCount = 0;
 
-    return (a << 24) | (b << 16) | (g << 8) | r;
+// last geometry that blocked a shadow ray towards each light, per thread. Neighbouring pixels are rendered by the same
+// thread and are usually shadowed by the same object, so it is tested before anything else.
+#define OCCLUDER_CACHE_SIZE 8
+struct OccluderCache {
+    const Scene *ActiveScene = nullptr;
+    uint64_t Version = 0; // of the scene the indices belong to, a scene edited in place gets a new one
+    int GeometryIndex[OCCLUDER_CACHE_SIZE];
+};
+thread_local OccluderCache s_OccluderCache;
+
+// colours of the tile the current thread is rendering, resolved into the image once the tile is done
+thread_local std::vector<glm::vec4> s_TileColours;
+/// Multiple importance sampling weight of a sample from the first of two strategies (power heuristic, Veach 1997).
+float PowerHeuristic(float pdf, float otherPdf) { return pdf * pdf / (pdf * pdf + otherPdf * otherPdf); }
+/// Seed of the random numbers one pass of reservoir resampling draws for a pixel, different every frame.
+uint32_t ReservoirSeed(uint32_t pixel, uint32_t frame, uint32_t pass) {
+    return RTRandom::PCG_Hash(pixel ^ RTRandom::PCG_Hash(frame * 2 + pass));
+}
+/// Offsets to the pixels within RESERVOIR_RADIUS of a pixel, other than itself, that reservoirs are reused from.
+const std::vector<glm::ivec2> &ReservoirOffsets() {
+    static const std::vector<glm::ivec2> s_Offsets = [] {
+        std::vector<glm::ivec2> offsets;
+        for (int y = -RESERVOIR_RADIUS; y <= RESERVOIR_RADIUS; y++) {
+            for (int x = -RESERVOIR_RADIUS; x <= RESERVOIR_RADIUS; x++) {
+                if ((x != 0 || y != 0) && x * x + y * y <= RESERVOIR_RADIUS * RESERVOIR_RADIUS) {
+                    offsets.emplace_back(x, y);
+                }
+            }
+        }
+        return offsets;
+    }();
+    return s_Offsets;
 }
-} // namespace Utils
+} // namespace
 
 /// Resize the image data buffers and reset the frame index.
 void Renderer::OnResize(uint32_t width, uint32_t height) {
@@ -33,19 +95,70 @@ void Renderer::OnResize(uint32_t width, uint32_t height) {
         m_FinalImage = std::make_shared<Walnut::Image>(width, height, Walnut::ImageFormat::RGBA);
     }
 
-    delete[] m_ImageData;
-    m_ImageData = new uint32_t[width * height];
-
-    delete[] m_AccumulationData;
-    m_AccumulationData = new glm::vec4[width * height];
+    AllocateImageData(width, height);
 
     ResetFrameIndex(); // frame index is used to average the accumulation data
 
-    // create a vertical iterator for parallel rendering
-    m_ImageVerticalterator.resize(height);
-    for (uint32_t i = 0; i < height; i++) {
-        m_ImageVerticalterator[i] = i;
+    m_Tiles.clear(); // rebuilt for the new size by the next render
+}
+
+void Renderer::ForEachRow(uint32_t rowCount, const std::function<void(uint32_t y)> &row) {
+    UpdateThreadPool();
+
+    std::vector<uint32_t> owners = AssignRows(rowCount);
+    m_ThreadPool.Run([&](uint32_t worker) {
+        for (uint32_t y = 0; y < rowCount; y++) {
+            if (owners[y] == worker) {
+                row(y);
+            }
+        }
+    });
+}
+
+std::vector<uint32_t> Renderer::AssignRows(uint32_t rowCount) const {
+    uint32_t nodeCount = NUMA::GetTopology().GetNodeCount();
+    uint32_t workerCount = m_ThreadPool.GetWorkerCount();
+    std::vector<std::vector<uint32_t>> nodeWorkers(nodeCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        nodeWorkers[m_ThreadPool.GetWorkerNode(i)].push_back(i);
+    }
+
+    // same split into node bands as the tiles, see MakeTiles; nodes without workers share all of them
+    std::vector<uint32_t> owners(rowCount);
+    for (uint32_t y = 0; y < rowCount; y++) {
+        const std::vector<uint32_t> &workers = nodeWorkers[NUMA::NodeOfRow(y, rowCount, nodeCount)];
+        owners[y] = workers.empty() ? y % workerCount : workers[y % workers.size()];
+    }
+    return owners;
+}
+
+void Renderer::AllocateImageData(uint32_t width, uint32_t height) {
+    m_ImageData.Allocate((size_t)width * height, m_Settings.HugePages);
+    m_AccumulationData.Allocate((size_t)width * height, m_Settings.HugePages);
+    m_LuminanceSquares.Allocate((size_t)width * height, m_Settings.HugePages);
+
+    // nothing is placed until written, so each row lands on the node of the thread that clears it
+    ForEachRow(height, [&](uint32_t y) {
+        memset(m_ImageData.Data() + (size_t)y * width, 0, width * sizeof(uint32_t));
+        memset(m_AccumulationData.Data() + (size_t)y * width, 0, width * sizeof(glm::vec4));
+        memset(m_LuminanceSquares.Data() + (size_t)y * width, 0, width * sizeof(float));
+    });
+}
+
+void Renderer::MeasureRowPlacement() {
+    // the kernel may migrate pages at any time, so this is looked at again every frame
+    uint32_t width = m_FinalImage->GetWidth();
+    uint32_t height = m_FinalImage->GetHeight();
+    std::vector<uint32_t> owners = AssignRows(height);
+    uint32_t known = 0, local = 0;
+    for (uint32_t y = 0; y < height; y += std::max(height / PLACEMENT_SAMPLES, 1u)) {
+        int node = NUMA::GetPageNode(m_AccumulationData.Data() + (size_t)y * width);
+        if (node >= 0) {
+            known++;
+            local += (uint32_t)node == m_ThreadPool.GetWorkerNode(owners[y]);
+        }
     }
+    m_RowPlacement = known > 0 ? (float)local / (float)known : -1.0f;
 }
 
 /// Render the scene using the active camera.
@@ -53,26 +166,85 @@ void Renderer::Render(const Scene &scene, const Camera &camera) {
     m_ActiveScene = &scene;
     m_ActiveCamera = &camera;
 
-    // reset accumulation data after resize, movement, or reset
-    if (m_FrameIndex == 1) {
-        memset(m_AccumulationData, 0, m_FinalImage->GetWidth() * m_FinalImage->GetHeight() * sizeof(glm::vec4));
+    m_RayCount = 0;
+    m_SampledPixelCount = 0;
+    m_PathCount = 0;
+    m_PathSegmentCount = 0;
+
+    UpdateThreadPool();
+    if (m_ImageData.UsesHugePages() != m_Settings.HugePages) {
+        AllocateImageData(m_FinalImage->GetWidth(), m_FinalImage->GetHeight());
+        ResetFrameIndex();
     }
+    UpdateSceneReplicas(scene);
 
-    // clang-format off
-    std::for_each(std::execution::par, m_ImageVerticalterator.begin(), m_ImageVerticalterator.end(), [this](uint32_t y) {
-        for (uint32_t x = 0; x < m_FinalImage->GetWidth(); x++) {
-            glm::vec4 colour = PerPixel(x, y);
+    m_GuidingActive = m_Settings.PathGuiding;
+    if (m_GuidingActive) {
+        UpdateGuidingField(scene);
+    }
 
-            m_AccumulationData[y * m_FinalImage->GetWidth() + x] += colour;
+    // reusing which lights were found blocked leaves shadow edges a little dark, and reused samples are correlated from
+    // frame to frame: once the image accumulates, the lights are sampled as without reservoirs, so it converges to the
+    // unbiased image as fast as it would without them. The reservoirs are kept for when the camera moves again.
+    bool reservoirLighting = m_Settings.ReservoirLighting && !scene.Lights.empty();
+    m_ReservoirsActive = reservoirLighting && m_FrameIndex == 1;
+    if (reservoirLighting) {
+        UpdateReservoirs(scene);
+    } else if (m_Reservoirs.Hits.Size() > 0) {
+        m_Reservoirs = ReservoirBuffers();
+    }
 
-            glm::vec4 accumulatedColour = m_AccumulationData[y * m_FinalImage->GetWidth() + x] / (float)m_FrameIndex;
+    m_TileCullingActive = m_Settings.TileCulling && scene.Acceleration == AccelerationType::Linear;
+    if (m_TileCullingActive) {
+        CullTiles();
+    }
 
-            m_ImageData[y * m_FinalImage->GetWidth() + x] = Utils::ConvertToRGBA(accumulatedColour);
-        }
+    uint32_t tileSize = ChooseTileSize(m_ThreadPool.GetWorkerCount());
+    if (tileSize != m_TileSize || m_Tiles.empty()) {
+        m_Tiles = MakeTiles(m_FinalImage->GetWidth(), m_FinalImage->GetHeight(), tileSize,
+                            NUMA::GetTopology().GetNodeCount());
+        m_TileSize = tileSize;
+    }
+
+    // every pixel's reservoir is ready before any pixel reuses its neighbours'
+    if (m_ReservoirsActive) {
+        m_Scheduler.Run(m_Tiles, m_ThreadPool, [this](const Tile &tile) {
+            s_ThreadRayCount = 0;
+            GenerateReservoirs(tile);
+            m_RayCount += s_ThreadRayCount;
+        });
+    }
+
+    m_Scheduler.Run(m_Tiles, m_ThreadPool, [this](const Tile &tile) {
+        s_ThreadRayCount = 0;
+        s_ThreadPathCount = 0;
+        s_ThreadPathSegmentCount = 0;
+        RenderTile(tile);
+        m_RayCount += s_ThreadRayCount;
+        m_PathCount += s_ThreadPathCount;
+        m_PathSegmentCount += s_ThreadPathSegmentCount;
     });
-    // clang-format on
 
-    m_FinalImage->SetData(m_ImageData);
+    // the paths of every frame train the field, it only changes between frames so each frame samples one distribution
+    if (m_GuidingActive && m_Guiding.EndFrame()) {
+        m_Guiding.Refine(m_ThreadPool);
+    }
+
+    // this frame's reservoirs and hits become the history of the next one
+    if (m_ReservoirsActive) {
+        std::swap(m_Reservoirs.Previous, m_Reservoirs.Final);
+        std::swap(m_Reservoirs.PreviousHits, m_Reservoirs.Hits);
+        m_Reservoirs.PreviousViewProjection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+        m_Reservoirs.HasHistory = true;
+    }
+    m_ReservoirFrame++;
+
+    m_AveragePathLength = m_PathCount > 0 ? (float)m_PathSegmentCount / (float)m_PathCount : 0.0f;
+
+    m_SampledPixels = (float)m_SampledPixelCount / (float)(m_FinalImage->GetWidth() * m_FinalImage->GetHeight());
+
+    m_FinalImage->SetData(m_ImageData.Data());
+    MeasureRowPlacement();
 
     if (m_Settings.Accumulate) {
         m_FrameIndex++;
@@ -81,30 +253,287 @@ void Renderer::Render(const Scene &scene, const Camera &camera) {
     }
 }
 
+void Renderer::UpdateThreadPool() {
+    // the pool is restarted only when its settings change, between frames the workers just sleep
+    ThreadPool::Settings poolSettings;
+    poolSettings.WorkerCount = (uint32_t)std::max(m_Settings.ThreadCount, 0);
+    poolSettings.PinThreads = m_Settings.PinThreads;
+    poolSettings.ReserveCore = m_Settings.ReserveUICore;
+    if (!m_ThreadPool.IsRunning() || poolSettings != m_ThreadPool.GetSettings()) {
+        m_ThreadPool.Start(poolSettings);
+    }
+}
+
+void Renderer::UpdateSceneReplicas(const Scene &scene) {
+    uint32_t nodeCount = NUMA::GetTopology().GetNodeCount();
+    if (!m_Settings.ReplicateScene || nodeCount < 2) {
+        m_Replicas.clear();
+        return;
+    }
+    if (m_Replicas.size() == nodeCount && m_ReplicaVersion == scene.Version) {
+        return;
+    }
+
+    // each copy is made by a worker of its node so the node's memory holds it, nodes without workers get theirs from
+    // the first worker
+    std::vector<uint32_t> builders(nodeCount, 0);
+    for (uint32_t i = m_ThreadPool.GetWorkerCount(); i-- > 0;) {
+        builders[m_ThreadPool.GetWorkerNode(i)] = i;
+    }
+
+    m_Replicas.clear();
+    m_Replicas.resize(nodeCount);
+    m_ThreadPool.Run([&](uint32_t worker) {
+        for (uint32_t node = 0; node < nodeCount; node++) {
+            if (builders[node] == worker) {
+                auto replica = std::make_unique<SceneReplica>();
+                replica->Compiled = scene.Compiled;
+                replica->BoundingVolumes = scene.BoundingVolumes;
+                replica->Grid = scene.Grid;
+                m_Replicas[node] = std::move(replica);
+            }
+        }
+    });
+    m_ReplicaVersion = scene.Version;
+}
+
+void Renderer::UpdateGuidingField(const Scene &scene) {
+    if (!m_Guiding.IsEmpty() && m_GuidingVersion == scene.Version) {
+        return;
+    }
+
+    // unbounded geometry is left out, points on it beyond the bounds are guided by the nearest regions
+    Bounds bounds;
+    for (uint32_t i = 0; i < scene.Compiled.GetPrimitiveCount(); i++) {
+        if (scene.Compiled.GetBounds(i).IsFinite()) {
+            bounds.Grow(scene.Compiled.GetBounds(i));
+        }
+    }
+    m_Guiding.Reset(bounds);
+    m_GuidingVersion = scene.Version;
+}
+
+void Renderer::UpdateReservoirs(const Scene &scene) {
+    size_t pixelCount = (size_t)m_FinalImage->GetWidth() * m_FinalImage->GetHeight();
+    if (m_Reservoirs.Hits.Size() != pixelCount || m_Reservoirs.Hits.UsesHugePages() != m_Settings.HugePages) {
+        // every buffer is written by the first pass before it is read, which places each row on the node rendering it
+        bool hugePages = m_Settings.HugePages;
+        m_Reservoirs.Hits.Allocate(pixelCount, hugePages);
+        m_Reservoirs.PreviousHits.Allocate(pixelCount, hugePages);
+        m_Reservoirs.Temporal.Allocate(pixelCount, hugePages);
+        m_Reservoirs.Final.Allocate(pixelCount, hugePages);
+        m_Reservoirs.Previous.Allocate(pixelCount, hugePages);
+        m_Reservoirs.HasHistory = false;
+    }
+
+    // the lights kept for another scene mean nothing in this one
+    if (m_Reservoirs.Version != scene.Version) {
+        m_Reservoirs.HasHistory = false;
+        m_Reservoirs.Version = scene.Version;
+    }
+}
+
+Renderer::SceneView Renderer::GetLocalScene() const {
+    if (!m_Replicas.empty()) {
+        const SceneReplica &replica = *m_Replicas[ThreadPool::GetCurrentNode()];
+        return {replica.Compiled, replica.BoundingVolumes, replica.Grid};
+    }
+    return {m_ActiveScene->Compiled, m_ActiveScene->BoundingVolumes, m_ActiveScene->Grid};
+}
+
+uint32_t Renderer::ChooseTileSize(uint32_t workerCount) const {
+    if (m_Settings.TileSize > 0) {
+        return std::max(m_Settings.TileSize / MIN_TILE_SIZE, 1) * MIN_TILE_SIZE;
+    }
+
+    // largest tiles that still give every worker a few to balance the load with
+    uint32_t size = MAX_TILE_SIZE;
+    for (; size > MIN_TILE_SIZE; size /= 2) {
+        uint32_t tilesX = (m_FinalImage->GetWidth() + size - 1) / size;
+        uint32_t tilesY = (m_FinalImage->GetHeight() + size - 1) / size;
+        if (tilesX * tilesY >= TILES_PER_WORKER * workerCount) {
+            break;
+        }
+    }
+    return size;
+}
+
+void Renderer::RenderTile(const Tile &tile) {
+    s_TileColours.resize(tile.Width * tile.Height);
+    glm::vec4 *colours = s_TileColours.data();
+
+    // pixels skipped by adaptive sampling are left transparent black, which adds neither light nor a sample
+    bool adaptive = m_Settings.AdaptiveSampling;
+    if (adaptive) {
+        std::fill(s_TileColours.begin(), s_TileColours.end(), glm::vec4(0.0f));
+    }
+
+    if (m_Settings.Wavefront) {
+        RenderWavefront(tile, colours);
+    } else if (m_Settings.RayPackets && m_ActiveScene->Acceleration == AccelerationType::BVH && !m_ReservoirsActive) {
+        // with the linear backend the block kernels already test each ray against a block of primitives at a time,
+        // packets pay off when their rays share the BVH traversal; with reservoir lighting its first pass traces them
+        for (uint32_t y = tile.Y; y < tile.Y + tile.Height; y += PACKET_HEIGHT) {
+            for (uint32_t x = tile.X; x < tile.X + tile.Width; x += PACKET_WIDTH) {
+                if (PacketNeedsSample(tile, x, y)) {
+                    PerPacket(tile, x, y, colours);
+                }
+            }
+        }
+    } else {
+        for (uint32_t y = tile.Y; y < tile.Y + tile.Height; y++) {
+            for (uint32_t x = tile.X; x < tile.X + tile.Width; x++) {
+                if (NeedsSample(x, y)) {
+                    colours[(y - tile.Y) * tile.Width + x - tile.X] = PerPixel(x, y);
+                }
+            }
+        }
+    }
+
+    uint32_t sampled = tile.Width * tile.Height;
+    if (adaptive) {
+        sampled = (uint32_t)std::count_if(s_TileColours.begin(), s_TileColours.end(),
+                                          [](const glm::vec4 &colour) { return colour.a > 0.0f; });
+    }
+    m_SampledPixelCount += sampled;
+
+    for (uint32_t y = tile.Y; y < tile.Y + tile.Height; y++) {
+        uint32_t offset = y * m_FinalImage->GetWidth() + tile.X;
+        // reset accumulation data after resize, movement, or reset; done here so only the tile's thread touches it
+        if (m_FrameIndex == 1) {
+            memset(m_AccumulationData.Data() + offset, 0, tile.Width * sizeof(glm::vec4));
+            memset(m_LuminanceSquares.Data() + offset, 0, tile.Width * sizeof(float));
+        }
+
+        const glm::vec4 *rowColours = colours + (y - tile.Y) * tile.Width;
+        if (adaptive) {
+            SIMD::Kernels().ResolvePixelsAdaptive(m_AccumulationData.Data() + offset, m_LuminanceSquares.Data() + offset,
+                                                  rowColours, m_ImageData.Data() + offset, tile.Width);
+        } else {
+            SIMD::Kernels().ResolvePixels(m_AccumulationData.Data() + offset, rowColours, m_ImageData.Data() + offset,
+                                          tile.Width, (float)m_FrameIndex);
+        }
+
+        if (m_Settings.ShowSampleDensity) {
+            for (uint32_t i = offset; i < offset + tile.Width; i++) {
+                // share of the frames so far that sampled the pixel
+                float density = glm::clamp(m_AccumulationData[i].a / (float)m_FrameIndex, 0.0f, 1.0f);
+                glm::vec3 colour = glm::mix(glm::vec3(0.1f, 0.2f, 1.0f), glm::vec3(1.0f, 0.1f, 0.1f), density);
+                m_ImageData[i] = (uint32_t)(colour.r * 255.0f) | (uint32_t)(colour.g * 255.0f) << 8 |
+                                 (uint32_t)(colour.b * 255.0f) << 16 | 0xff000000u;
+            }
+        }
+    }
+}
+
+bool Renderer::NeedsSample(uint32_t x, uint32_t y) const {
+    // the accumulated data is only cleared once the first frame's tile is resolved
+    if (!m_Settings.AdaptiveSampling || m_FrameIndex == 1) {
+        return true;
+    }
+
+    size_t pixel = (size_t)y * m_FinalImage->GetWidth() + x;
+    const glm::vec4 &sum = m_AccumulationData[pixel];
+    float samples = sum.a;
+    if (samples < (float)std::max(m_Settings.MinSamples, 2)) {
+        return true;
+    }
+
+    // squared standard error of the mean, from the unbiased sample variance
+    float mean = SIMD::Luminance(glm::vec3(sum)) / samples;
+    float variance = std::max(m_LuminanceSquares[pixel] / samples - mean * mean, 0.0f) * samples / (samples - 1.0f);
+    float error = m_Settings.ErrorThreshold * std::max(mean, MIN_ERROR_LUMINANCE);
+    return variance / samples > error * error;
+}
+
+bool Renderer::PacketNeedsSample(const Tile &tile, uint32_t x, uint32_t y) const {
+    for (uint32_t py = y; py < y + PACKET_HEIGHT && py < tile.Y + tile.Height; py++) {
+        for (uint32_t px = x; px < x + PACKET_WIDTH && px < tile.X + tile.Width; px++) {
+            if (NeedsSample(px, py)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+Ray Renderer::GeneratePrimaryRay(uint32_t x, uint32_t y, Sampler &sampler) {
+    // each frame adds the next sample of the pixel's sequence
+    sampler = Sampler(x + y * m_FinalImage->GetWidth(), m_FrameIndex - 1);
+
+    glm::vec3 origin = m_ActiveCamera->GetSettings().Position;
+    if (m_Settings.Jitter) {
+        glm::vec2 u = sampler.Get2D();
+        float v = sampler.Get1D();
+        origin += (glm::vec3(u, v) * 2.0f - 1.0f) * JITTER_RADIUS;
+    }
+
+    return Ray(origin, m_ActiveCamera->GetRayDirections()[y * m_FinalImage->GetWidth() + x]);
+}
+
 /// Compute the colour for a specific pixel in the image.
 glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y) {
-    // make a "unique" seed for each pixel-frame index-bounce combination
-    uint32_t seed = x + y * m_FinalImage->GetWidth();
-    seed *= m_FrameIndex;
-    // add a time-based seed to introduce randomness
-    auto now = std::chrono::system_clock::now();
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
-    seed ^= ms;
-
-    Ray ray;
-    ray.Origin = m_ActiveCamera->GetSettings().Position;
-    if (m_Settings.Jitter) {
-        ray.Origin += RTRandom::Vec3(seed, -0.003f, 0.003f);
+    Sampler sampler;
+    Ray ray = GeneratePrimaryRay(x, y, sampler);
+
+    // with reservoir lighting the camera rays were traced by its first pass
+    if (m_ReservoirsActive) {
+        return TracePath(ray, m_Reservoirs.Hits[(size_t)y * m_FinalImage->GetWidth() + x], sampler, x, y);
+    }
+
+    // the camera ray stays inside the frustum of its tile, bounces don't
+    const std::vector<uint32_t> *candidates = nullptr;
+    if (m_TileCullingActive) {
+        candidates = &m_TileGeometry[(y / CULLING_TILE_SIZE) * m_TileCountX + x / CULLING_TILE_SIZE];
     }
-    ray.Direction = m_ActiveCamera->GetRayDirections()[y * m_FinalImage->GetWidth() + x];
 
+    return TracePath(ray, TraceRay(ray, candidates), sampler, x, y);
+}
+
+void Renderer::PerPacket(const Tile &tile, uint32_t x, uint32_t y, glm::vec4 *colours) {
+    // pixels of the block inside the tile, row by row
+    Ray rays[PACKET_SIZE];
+    Sampler samplers[PACKET_SIZE];
+    uint32_t pixelX[PACKET_SIZE];
+    uint32_t pixelY[PACKET_SIZE];
+    int count = 0;
+    for (uint32_t py = y; py < y + PACKET_HEIGHT && py < tile.Y + tile.Height; py++) {
+        for (uint32_t px = x; px < x + PACKET_WIDTH && px < tile.X + tile.Width; px++) {
+            rays[count] = GeneratePrimaryRay(px, py, samplers[count]);
+            pixelX[count] = px;
+            pixelY[count] = py;
+            count++;
+        }
+    }
+
+    RayPacket packet(rays, count);
+    Intersection hits[PACKET_SIZE];
+    TracePacket(packet, hits);
+
+    // the paths diverge after the first hit and continue one pixel at a time
+    for (int lane = 0; lane < count; lane++) {
+        HitPayload hit = hits[lane].GeometryIndex == -1 ? Miss(rays[lane]) : ClosestHit(rays[lane], hits[lane]);
+        colours[(pixelY[lane] - tile.Y) * tile.Width + pixelX[lane] - tile.X] =
+            TracePath(rays[lane], hit, samplers[lane], pixelX[lane], pixelY[lane]);
+    }
+}
+
+glm::vec4 Renderer::TracePath(Ray ray, HitPayload hit, Sampler sampler, uint32_t x, uint32_t y) {
     glm::vec3 light = glm::vec3(0.0f); // accumulated light for this pixel, increases with each bounce
     glm::vec3 contribution{1.0f};      // accumulated contribution for this pixel, decreases with each bounce
+    float bouncePdf = 0.0f;            // of the ray that found the hit, 0 for the camera ray
+    s_ThreadPathCount++;
 
-    for (int _i = 0; _i < m_Settings.MaxBounces; _i++) {
-        seed++;
+    // bounces recorded for path guiding, kept between paths so their storage is reused
+    static thread_local std::vector<GuidingVertex> guidingVertices;
+    guidingVertices.clear();
 
-        Renderer::HitPayload hit = TraceRay(ray);
+    for (int bounce = 0; bounce < m_Settings.MaxBounces; bounce++) {
+        s_ThreadPathSegmentCount++;
+
+        if (bounce > 0) {
+            hit = TraceRay(ray);
+        }
 
         // no hit
         if (hit.Intersection.GeometryIndex == -1) {
@@ -112,40 +541,451 @@ glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y) {
             break;
         }
 
-        // add light from all light sources (direct, point light)
-        for (const auto &lightSource : m_ActiveScene->Lights) {
-            glm::vec3 lightColour = CalculateLighting(hit, lightSource);
-            light += lightColour * contribution;
+        const Material &material = m_ActiveScene->Materials[hit.MaterialIndex];
+        BSDF bsdf(material, hit.WorldNormal, -glm::normalize(ray.Direction));
+        uint32_t region = m_GuidingActive ? m_Guiding.FindRegion(hit.WorldPosition) : 0;
+        const DirectionTree *guide = m_GuidingActive ? m_Guiding.GetGuide(region) : nullptr;
+
+        // add light from the light sources (direct, point light): all of them or a few picked at random, or at the
+        // camera ray's hit the one picked by reservoir resampling
+        if (bounce == 0 && m_ReservoirsActive) {
+            Ray shadowRay;
+            glm::vec3 reflected;
+            int lightIndex = SampleReservoirs(x, y, hit, bsdf, shadowRay, reflected);
+            if (lightIndex != -1) {
+                if (TraceShadowRay(shadowRay, (uint32_t)lightIndex)) {
+                    OccludeReservoir(x, y);
+                } else {
+                    light += reflected * contribution;
+                }
+            }
+        } else {
+            for (uint32_t sample = 0; sample < GetLightSampleCount(); sample++) {
+                LightChoice choice = ChooseLight(hit, sample, sampler);
+                if (choice.LightIndex != -1) {
+                    glm::vec3 lightColour = CalculateLighting(hit, bsdf, choice.LightIndex);
+                    light += lightColour * choice.Weight * contribution;
+                }
+            }
+        }
+
+        // add light from a point on an emissive sphere or box, which the next bounce could also find; after the last
+        // bounce there is nothing to weigh it against, so it isn't sampled
+        if (bounce + 1 < m_Settings.MaxBounces) {
+            Ray shadowRay;
+            glm::vec3 emitted;
+            int emitter = SampleEmitter(hit, bsdf, guide, sampler, shadowRay, emitted);
+            if (emitter != -1 && !TraceShadowRay(shadowRay, (uint32_t)m_ActiveScene->Lights.size() + emitter)) {
+                light += emitted * contribution;
+            }
         }
 
-        int materialIndex = m_ActiveScene->Geometry[hit.Intersection.GeometryIndex]->GetMaterialIndex(hit.WorldPosition);
-        Material material = m_ActiveScene->Materials[materialIndex];
+        // emitted light reaches the camera through the same surfaces as reflected light
+        light += material.GetEmission() * EmissionWeight(ray, hit, bouncePdf) * contribution;
 
-        light += material.GetEmission() * material.Albedo;
-        contribution *= material.Albedo;
+        // change ray for next bounce, the path ends where the surface can't reflect the sampled direction
+        ray = GenerateBounceRay(hit, bsdf, guide, SampleBounceDirection(bsdf, guide, sampler), contribution, bouncePdf);
+        if (bouncePdf <= 0.0f || !ContinuePath(contribution, bounce, sampler)) {
+            break;
+        }
 
-        // change ray for next bounce
-        ray.Origin = hit.WorldPosition + hit.WorldNormal * 0.0001f;
-        ray.Direction = glm::normalize(RTRandom::InUnitSphere(seed) + hit.WorldNormal);
+        // bounces after the last segment find no light, which isn't what arrives from their direction
+        if (m_GuidingActive && bounce + 1 < m_Settings.MaxBounces) {
+            guidingVertices.push_back({region, ray.Direction, light, contribution, bouncePdf, 0});
+        }
+    }
+
+    for (const GuidingVertex &vertex : guidingVertices) {
+        RecordGuidingVertex(vertex, light);
     }
 
     return glm::vec4(light, 1.0f);
 }
 
-Renderer::HitPayload Renderer::TraceRay(const Ray &ray) {
-    Intersection closestHit;
-    closestHit.T = std::numeric_limits<float>::max();
+void Renderer::RenderWavefront(const Tile &tile, glm::vec4 *colours) {
+    // queues are kept between tiles so their storage is reused
+    static thread_local WavefrontQueues queues;
 
-    for (uint32_t i = 0; i < m_ActiveScene->Geometry.size(); i++) {
-        const Geometry *geometry = m_ActiveScene->Geometry[i];
-        float t = geometry->Intersect(ray);
+    GeneratePaths(queues, tile);
+
+    for (int bounce = 0; bounce < m_Settings.MaxBounces && !queues.Active.empty(); bounce++) {
+        ExtendPaths(queues, bounce);
+        CompactPaths(queues);
+        if (m_Settings.SortPaths) {
+            SortPaths(queues);
+        }
+        TraceShadowRays(queues, bounce);
+        ShadePaths(queues, bounce);
+    }
+
+    for (const GuidingVertex &vertex : queues.GuidingVertices) {
+        RecordGuidingVertex(vertex, queues.Paths[vertex.Path].Light);
+    }
+
+    for (const PathState &path : queues.Paths) {
+        colours[(path.Y - tile.Y) * tile.Width + path.X - tile.X] = glm::vec4(path.Light, 1.0f);
+    }
+}
+
+void Renderer::GeneratePaths(WavefrontQueues &queues, const Tile &tile) {
+    queues.Paths.clear();
+    queues.PacketStarts.clear();
+    queues.GuidingVertices.clear();
+
+    auto generate = [&](uint32_t px, uint32_t py) {
+        PathState &path = queues.Paths.emplace_back();
+        path.NextRay = GeneratePrimaryRay(px, py, path.PathSampler);
+        path.Light = glm::vec3(0.0f);
+        path.Contribution = glm::vec3(1.0f);
+        path.BouncePdf = 0.0f;
+        path.X = px;
+        path.Y = py;
+    };
+
+    // primary rays are traced in packets like PerPacket does, so the paths of each packet are made contiguous
+    queues.Packets = m_Settings.RayPackets && m_ActiveScene->Acceleration == AccelerationType::BVH;
+    uint32_t x1 = tile.X + tile.Width;
+    uint32_t y1 = tile.Y + tile.Height;
+    if (queues.Packets) {
+        for (uint32_t y = tile.Y; y < y1; y += PACKET_HEIGHT) {
+            for (uint32_t x = tile.X; x < x1; x += PACKET_WIDTH) {
+                if (!PacketNeedsSample(tile, x, y)) {
+                    continue;
+                }
+                queues.PacketStarts.push_back((uint32_t)queues.Paths.size());
+                for (uint32_t py = y; py < y + PACKET_HEIGHT && py < y1; py++) {
+                    for (uint32_t px = x; px < x + PACKET_WIDTH && px < x1; px++) {
+                        generate(px, py);
+                    }
+                }
+            }
+        }
+        queues.PacketStarts.push_back((uint32_t)queues.Paths.size());
+    } else {
+        for (uint32_t py = tile.Y; py < y1; py++) {
+            for (uint32_t px = tile.X; px < x1; px++) {
+                if (NeedsSample(px, py)) {
+                    generate(px, py);
+                }
+            }
+        }
+    }
+
+    queues.Active.resize(queues.Paths.size());
+    for (uint32_t i = 0; i < queues.Active.size(); i++) {
+        queues.Active[i] = i;
+    }
+    s_ThreadPathCount += queues.Paths.size();
+}
 
-        if (t > 0.0f && t < closestHit.T) {
-            closestHit.T = t;
-            closestHit.GeometryIndex = i;
+void Renderer::ExtendPaths(WavefrontQueues &queues, int bounce) {
+    // misses gather the sky and end, hits are resolved into a surface for the later stages
+    auto resolve = [&](PathState &path, Intersection intersection) {
+        if (intersection.GeometryIndex == -1) {
+            path.Hit = Miss(path.NextRay);
+            path.Light += m_ActiveScene->SkyColour * path.Contribution;
+        } else {
+            path.Hit = ClosestHit(path.NextRay, intersection);
         }
+    };
+
+    s_ThreadPathSegmentCount += queues.Active.size();
+
+    if (bounce == 0 && m_ReservoirsActive) {
+        // the first pass of reservoir lighting traced the camera rays
+        for (uint32_t i : queues.Active) {
+            PathState &path = queues.Paths[i];
+            path.Hit = m_Reservoirs.Hits[(size_t)path.Y * m_FinalImage->GetWidth() + path.X];
+            if (path.Hit.Intersection.GeometryIndex == -1) {
+                path.Light += m_ActiveScene->SkyColour * path.Contribution;
+            }
+        }
+        return;
+    }
+
+    if (bounce == 0 && queues.Packets) {
+        // nothing has been compacted yet, so the active paths are still in packet order
+        for (size_t p = 0; p + 1 < queues.PacketStarts.size(); p++) {
+            uint32_t first = queues.PacketStarts[p];
+            int count = (int)(queues.PacketStarts[p + 1] - first);
+
+            Ray rays[PACKET_SIZE];
+            for (int lane = 0; lane < count; lane++) {
+                rays[lane] = queues.Paths[first + lane].NextRay;
+            }
+            RayPacket packet(rays, count);
+            Intersection hits[PACKET_SIZE];
+            TracePacket(packet, hits);
+
+            for (int lane = 0; lane < count; lane++) {
+                resolve(queues.Paths[first + lane], hits[lane]);
+            }
+        }
+        return;
+    }
+
+    for (uint32_t i : queues.Active) {
+        PathState &path = queues.Paths[i];
+
+        // the camera ray stays inside the frustum of its tile, bounces don't
+        const std::vector<uint32_t> *candidates = nullptr;
+        if (bounce == 0 && m_TileCullingActive) {
+            candidates = &m_TileGeometry[(path.Y / CULLING_TILE_SIZE) * m_TileCountX + path.X / CULLING_TILE_SIZE];
+        }
+
+        resolve(path, IntersectScene(path.NextRay, candidates));
+    }
+}
+
+void Renderer::CompactPaths(WavefrontQueues &queues) {
+    auto end = std::remove_if(queues.Active.begin(), queues.Active.end(), [&](uint32_t i) {
+        return queues.Paths[i].Hit.Intersection.GeometryIndex == -1;
+    });
+    queues.Active.erase(end, queues.Active.end());
+}
+
+void Renderer::SortPaths(WavefrontQueues &queues) {
+    // counting sort, there are few materials and the order within a material is kept
+    size_t materialCount = m_ActiveScene->Materials.size();
+    queues.MaterialOffsets.assign(materialCount + 1, 0);
+    for (uint32_t i : queues.Active) {
+        queues.MaterialOffsets[queues.Paths[i].Hit.MaterialIndex + 1]++;
+    }
+    for (size_t m = 1; m <= materialCount; m++) {
+        queues.MaterialOffsets[m] += queues.MaterialOffsets[m - 1];
     }
 
+    queues.Sorted.resize(queues.Active.size());
+    for (uint32_t i : queues.Active) {
+        queues.Sorted[queues.MaterialOffsets[queues.Paths[i].Hit.MaterialIndex]++] = i;
+    }
+    std::swap(queues.Active, queues.Sorted);
+}
+
+void Renderer::TraceShadowRays(WavefrontQueues &queues, int bounce) {
+    // the surfaces are kept for ShadePaths, which bounces off them
+    queues.Surfaces.clear();
+    queues.Regions.clear();
+    queues.Guides.clear();
+    for (uint32_t i : queues.Active) {
+        const PathState &path = queues.Paths[i];
+        queues.Surfaces.emplace_back(m_ActiveScene->Materials[path.Hit.MaterialIndex], path.Hit.WorldNormal,
+                                     -glm::normalize(path.NextRay.Direction));
+        uint32_t region = m_GuidingActive ? m_Guiding.FindRegion(path.Hit.WorldPosition) : 0;
+        queues.Regions.push_back(region);
+        queues.Guides.push_back(m_GuidingActive ? m_Guiding.GetGuide(region) : nullptr);
+    }
+
+    // one light (or light sample) at a time, so consecutive rays share the occluder cache entry of their light when
+    // every light is traced; the camera rays' hits trace one to the light reservoir resampling picked when it is on
+    bool reservoirs = bounce == 0 && m_ReservoirsActive;
+    queues.Shadows.clear();
+    if (reservoirs) {
+        for (size_t active = 0; active < queues.Active.size(); active++) {
+            uint32_t i = queues.Active[active];
+            const PathState &path = queues.Paths[i];
+            ShadowQuery query{};
+            int lightIndex =
+                SampleReservoirs(path.X, path.Y, path.Hit, queues.Surfaces[active], query.ShadowRay, query.Light);
+            if (lightIndex != -1) {
+                query.Path = i;
+                query.LightIndex = (uint32_t)lightIndex;
+                queues.Shadows.push_back(query);
+            }
+        }
+    } else {
+        for (uint32_t sample = 0; sample < GetLightSampleCount(); sample++) {
+            for (size_t active = 0; active < queues.Active.size(); active++) {
+                uint32_t i = queues.Active[active];
+                PathState &path = queues.Paths[i];
+                LightChoice choice = ChooseLight(path.Hit, sample, path.PathSampler);
+                if (choice.LightIndex != -1) {
+                    Ray shadowRay = GenerateShadowRay(path.Hit, choice.LightIndex);
+                    glm::vec3 light =
+                        DirectLighting(queues.Surfaces[active], choice.LightIndex, shadowRay) * choice.Weight;
+                    queues.Shadows.push_back({shadowRay, light, i, (uint32_t)choice.LightIndex, false});
+                }
+            }
+        }
+    }
+
+    // then one emitter per path, like TracePath
+    if (bounce + 1 < m_Settings.MaxBounces) {
+        for (size_t active = 0; active < queues.Active.size(); active++) {
+            uint32_t i = queues.Active[active];
+            PathState &path = queues.Paths[i];
+            ShadowQuery query{};
+            int emitter = SampleEmitter(path.Hit, queues.Surfaces[active], queues.Guides[active], path.PathSampler,
+                                        query.ShadowRay, query.Light);
+            if (emitter != -1) {
+                query.Path = i;
+                query.LightIndex = (uint32_t)m_ActiveScene->Lights.size() + emitter;
+                queues.Shadows.push_back(query);
+            }
+        }
+    }
+
+    for (ShadowQuery &query : queues.Shadows) {
+        query.Occluded = TraceShadowRay(query.ShadowRay, query.LightIndex);
+        if (reservoirs && query.Occluded && query.LightIndex < m_ActiveScene->Lights.size()) {
+            OccludeReservoir(queues.Paths[query.Path].X, queues.Paths[query.Path].Y);
+        }
+    }
+}
+
+void Renderer::ShadePaths(WavefrontQueues &queues, int bounce) {
+    // the queries of each path are in sample order, so its light adds up in the same order as in TracePath
+    for (const ShadowQuery &query : queues.Shadows) {
+        if (!query.Occluded) {
+            PathState &path = queues.Paths[query.Path];
+            path.Light += query.Light * path.Contribution;
+        }
+    }
+
+    for (uint32_t i : queues.Active) {
+        PathState &path = queues.Paths[i];
+        const Material &material = m_ActiveScene->Materials[path.Hit.MaterialIndex];
+        path.Light += material.GetEmission() * EmissionWeight(path.NextRay, path.Hit, path.BouncePdf) * path.Contribution;
+    }
+
+    // the bounces are drawn a batch at a time: the lobe of each path, then their samples and the cosine-weighted
+    // directions of the diffuse ones with kernels filling whole registers
+    const SIMD::KernelTable &kernels = SIMD::Kernels();
+    SamplerState samplers[BOUNCE_BATCH_SIZE];
+    glm::vec2 samples[BOUNCE_BATCH_SIZE];
+    BounceLobe lobes[BOUNCE_BATCH_SIZE];
+    glm::vec2 diffuseSamples[BOUNCE_BATCH_SIZE];
+    glm::vec3 normals[BOUNCE_BATCH_SIZE];
+    glm::vec3 directions[BOUNCE_BATCH_SIZE];
+
+    // paths that end are dropped from the active queue, which is rewritten in place
+    uint32_t pathCount = (uint32_t)queues.Active.size();
+    uint32_t activeCount = 0;
+    for (uint32_t first = 0; first < pathCount; first += BOUNCE_BATCH_SIZE) {
+        uint32_t count = std::min(pathCount - first, (uint32_t)BOUNCE_BATCH_SIZE);
+        for (uint32_t i = 0; i < count; i++) {
+            PathState &path = queues.Paths[queues.Active[first + i]];
+            lobes[i] = ChooseBounceLobe(queues.Surfaces[first + i], queues.Guides[first + i], path.PathSampler.Get1D());
+            samplers[i] = path.PathSampler.GetState();
+        }
+        kernels.Sample2D(samplers, samples, count);
+
+        uint32_t diffuseCount = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (lobes[i] == BounceLobe::Diffuse) {
+                diffuseSamples[diffuseCount] = samples[i];
+                normals[diffuseCount] = queues.Surfaces[first + i].GetNormal();
+                diffuseCount++;
+            }
+        }
+        kernels.CosineHemisphere(diffuseSamples, normals, directions, diffuseCount);
+
+        uint32_t diffuse = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index = queues.Active[first + i];
+            PathState &path = queues.Paths[index];
+            const BSDF &bsdf = queues.Surfaces[first + i];
+            const DirectionTree *guide = queues.Guides[first + i];
+            path.PathSampler.GetState() = samplers[i];
+
+            glm::vec3 direction;
+            if (lobes[i] == BounceLobe::Diffuse) {
+                direction = directions[diffuse++];
+            } else {
+                direction = lobes[i] == BounceLobe::Specular ? bsdf.SampleSpecular(samples[i])
+                                                              : guide->SampleHemisphere(samples[i], bsdf.GetNormal());
+            }
+            path.NextRay = GenerateBounceRay(path.Hit, bsdf, guide, direction, path.Contribution, path.BouncePdf);
+            if (path.BouncePdf > 0.0f && ContinuePath(path.Contribution, bounce, path.PathSampler)) {
+                queues.Active[activeCount++] = index;
+                if (m_GuidingActive && bounce + 1 < m_Settings.MaxBounces) {
+                    queues.GuidingVertices.push_back(
+                        {queues.Regions[first + i], direction, path.Light, path.Contribution, path.BouncePdf, index});
+                }
+            }
+        }
+    }
+    queues.Active.resize(activeCount);
+}
+
+bool Renderer::ContinuePath(glm::vec3 &contribution, int bounce, Sampler &sampler) const {
+    if (!m_Settings.RussianRoulette || bounce + 1 < m_Settings.RouletteDepth) {
+        return true;
+    }
+
+    // survival chance follows the throughput, paths carrying as much light as they started with always go on
+    float survival = std::min(std::max(contribution.r, std::max(contribution.g, contribution.b)), 1.0f);
+    if (sampler.Get1D() >= survival) {
+        return false;
+    }
+    contribution /= survival;
+    return true;
+}
+
+Renderer::BounceLobe Renderer::ChooseBounceLobe(const BSDF &bsdf, const DirectionTree *guide, float u) const {
+    // one number picks the guide or the BSDF, then what is left of it picks the BSDF's lobe
+    if (guide) {
+        float fraction = std::min(std::max(m_Settings.GuidingFraction, 0.0f), MAX_GUIDING_FRACTION);
+        if (u < fraction) {
+            return BounceLobe::Guided;
+        }
+        u = (u - fraction) / (1.0f - fraction);
+    }
+    return u < bsdf.GetSpecularProbability() ? BounceLobe::Specular : BounceLobe::Diffuse;
+}
+
+glm::vec3 Renderer::SampleBounceDirection(const BSDF &bsdf, const DirectionTree *guide, Sampler &sampler) const {
+    // Get2D gives the same bits as the Sample2D kernel, so paths bounce the same way whichever integrator traces them
+    BounceLobe lobe = ChooseBounceLobe(bsdf, guide, sampler.Get1D());
+    glm::vec2 sample = sampler.Get2D();
+    if (lobe == BounceLobe::Specular) {
+        return bsdf.SampleSpecular(sample);
+    }
+    if (lobe == BounceLobe::Guided) {
+        return guide->SampleHemisphere(sample, bsdf.GetNormal());
+    }
+
+    glm::vec3 direction;
+    SIMD::Kernels().CosineHemisphere(&sample, &bsdf.GetNormal(), &direction, 1);
+    return direction;
+}
+
+float Renderer::BouncePdf(const BSDF &bsdf, const DirectionTree *guide, const glm::vec3 &direction) const {
+    // neither the guide nor the BSDF pick directions below the surface
+    float pdf = bsdf.Pdf(direction);
+    if (guide && pdf > 0.0f) {
+        float fraction = std::min(std::max(m_Settings.GuidingFraction, 0.0f), MAX_GUIDING_FRACTION);
+        pdf = fraction * guide->HemispherePdf(direction, bsdf.GetNormal()) + (1.0f - fraction) * pdf;
+    }
+    return pdf;
+}
+
+Ray Renderer::GenerateBounceRay(const HitPayload &hit, const BSDF &bsdf, const DirectionTree *guide,
+                                const glm::vec3 &direction, glm::vec3 &contribution, float &pdf) const {
+    Ray ray(hit.WorldPosition + hit.WorldNormal * 0.0001f, direction);
+    pdf = BouncePdf(bsdf, guide, direction);
+    if (pdf > 0.0f) {
+        contribution *= bsdf.Evaluate(direction) / pdf;
+    }
+    return ray;
+}
+
+void Renderer::RecordGuidingVertex(const GuidingVertex &vertex, const glm::vec3 &pathLight) {
+    // what the path gathered after the bounce, without the weight the bounce and later ones gave it, arrived from
+    // the bounce's direction
+    glm::vec3 found = pathLight - vertex.Light;
+    glm::vec3 radiance(0.0f);
+    for (int c = 0; c < 3; c++) {
+        if (vertex.Contribution[c] > 0.0f) {
+            radiance[c] = found[c] / vertex.Contribution[c];
+        }
+    }
+    m_Guiding.Record(vertex.Region, vertex.Direction, SIMD::Luminance(radiance), vertex.Pdf);
+}
+
+Renderer::HitPayload Renderer::TraceRay(Ray ray, const std::vector<uint32_t> *candidates) {
+    Intersection closestHit = IntersectScene(ray, candidates);
+
     // no hit
     if (closestHit.GeometryIndex == -1) {
         return Miss(ray);
@@ -154,57 +994,433 @@ Renderer::HitPayload Renderer::TraceRay(const Ray &ray) {
     return ClosestHit(ray, closestHit);
 }
 
-Renderer::HitPayload Renderer::ClosestHit(const Ray &ray, Intersection intersection) {
-    const Geometry &closestGeometry = *m_ActiveScene->Geometry[intersection.GeometryIndex];
+Intersection Renderer::IntersectScene(Ray ray, const std::vector<uint32_t> *candidates) {
+    s_ThreadRayCount++;
 
+    // the interval shrinks to each closer hit, so later primitives only report hits in front of it
+
+    Intersection closestHit;
+    closestHit.T = ray.TMax;
+
+    SceneView scene = GetLocalScene();
+    const CompiledScene &compiled = scene.Compiled;
+    auto intersect = [&](uint32_t i) { return compiled.Intersect(i, ray); };
+
+    if (candidates) {
+        compiled.Intersect(*candidates, ray, closestHit);
+    } else {
+        switch (m_ActiveScene->Acceleration) {
+        case AccelerationType::BVH:
+            compiled.Intersect(m_ActiveScene->UnboundedGeometry, ray, closestHit); // not part of the acceleration structure
+            scene.BoundingVolumes.Intersect(ray, closestHit, intersect);
+            break;
+        case AccelerationType::Grid:
+            compiled.Intersect(m_ActiveScene->UnboundedGeometry, ray, closestHit);
+            scene.Grid.Intersect(ray, closestHit, intersect);
+            break;
+        default:
+            compiled.Intersect(ray, closestHit);
+            break;
+        }
+    }
+
+    return closestHit;
+}
+
+void Renderer::TracePacket(RayPacket &packet, Intersection *hits) {
+    s_ThreadRayCount += packet.Count;
+
+    SceneView scene = GetLocalScene();
+    const CompiledScene &compiled = scene.Compiled;
+
+    if (m_ActiveScene->Acceleration == AccelerationType::BVH) {
+        compiled.Intersect(m_ActiveScene->UnboundedGeometry, packet, hits);
+        scene.BoundingVolumes.Intersect(
+            packet, hits, [&](uint32_t i) { compiled.Intersect(i, packet, hits); },
+            [&](uint32_t i, const Ray &ray) { return compiled.Intersect(i, ray); });
+        return;
+    }
+
+    // the uniform grid has no packet traversal
+    for (int lane = 0; lane < packet.Count; lane++) {
+        Ray ray = packet.GetRay(lane);
+        if (m_ActiveScene->Acceleration == AccelerationType::Grid) {
+            compiled.Intersect(m_ActiveScene->UnboundedGeometry, ray, hits[lane]);
+            scene.Grid.Intersect(ray, hits[lane], [&](uint32_t i) { return compiled.Intersect(i, ray); });
+        } else {
+            compiled.Intersect(ray, hits[lane]);
+        }
+    }
+}
+
+Renderer::HitPayload Renderer::ClosestHit(const Ray &ray, Intersection intersection) {
     Renderer::HitPayload payload;
     payload.Intersection = intersection;
-    payload.WorldPosition = ray.Origin + intersection.T * ray.Direction;
-    payload.WorldNormal = closestGeometry.GetNormal(payload.WorldPosition);
+
+    // normal and material are looked up once here and reused by the lighting and the next bounce
+    SurfaceInteraction interaction =
+        GetLocalScene().Compiled.GetSurfaceInteraction(intersection.GeometryIndex, ray.Origin + intersection.T * ray.Direction);
+    payload.WorldPosition = interaction.Position;
+    payload.WorldNormal = interaction.Normal;
+    payload.LocalPosition = interaction.LocalPosition;
+    payload.MaterialIndex = interaction.MaterialIndex;
 
     return payload;
 }
 
 Renderer::HitPayload Renderer::Miss(const Ray &ray) {
-    return HitPayload{Intersection{-1.0f, -1}, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+    return HitPayload{Intersection{-1.0f, -1}, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, -1};
 }
 
-bool Renderer::TraceShadowRay(const Ray &ray) {
-    for (const auto geometry : m_ActiveScene->Geometry) {
-        float t = geometry->Intersect(ray);
+bool Renderer::TraceShadowRay(const Ray &ray, uint32_t lightIndex) {
+    s_ThreadRayCount++;
+
+    if (s_OccluderCache.ActiveScene != m_ActiveScene || s_OccluderCache.Version != m_ActiveScene->Version) {
+        s_OccluderCache.ActiveScene = m_ActiveScene;
+        s_OccluderCache.Version = m_ActiveScene->Version;
+        std::fill(std::begin(s_OccluderCache.GeometryIndex), std::end(s_OccluderCache.GeometryIndex), -1);
+    }
 
-        if (t > 0.0f) {
+    SceneView scene = GetLocalScene();
+    const CompiledScene &compiled = scene.Compiled;
+    int &cachedOccluder = s_OccluderCache.GeometryIndex[lightIndex % OCCLUDER_CACHE_SIZE];
+    if (cachedOccluder != -1 && compiled.Occluded(cachedOccluder, ray)) {
+        return true;
+    }
+
+    auto occluded = [&](uint32_t i) {
+        if ((int)i == cachedOccluder || !compiled.Occluded(i, ray)) {
+            return false;
+        }
+        cachedOccluder = (int)i;
+        return true;
+    };
+
+    if (m_ActiveScene->Acceleration == AccelerationType::Linear) {
+        int occluder = compiled.FindOccluder(ray);
+        if (occluder == -1) {
+            return false;
+        }
+        cachedOccluder = occluder;
+        return true;
+    }
+
+    for (uint32_t i : m_ActiveScene->UnboundedGeometry) {
+        if (occluded(i)) {
             return true;
         }
     }
 
-    return false;
+    if (m_ActiveScene->Acceleration == AccelerationType::Grid) {
+        return scene.Grid.Occluded(ray, occluded);
+    }
+    return scene.BoundingVolumes.Occluded(ray, occluded);
 }
 
-glm::vec3 Renderer::CalculateLighting(const HitPayload &hit, const Light &light) {
-    // shadow
+void Renderer::CullTiles() {
+    uint32_t width = m_FinalImage->GetWidth();
+    uint32_t height = m_FinalImage->GetHeight();
+    m_TileCountX = (width + CULLING_TILE_SIZE - 1) / CULLING_TILE_SIZE;
+    uint32_t tileCount = m_TileCountX * ((height + CULLING_TILE_SIZE - 1) / CULLING_TILE_SIZE);
+
+    // vectors are kept between frames so their storage is reused
+    m_TileGeometry.resize(tileCount);
+
+    const glm::vec3 &origin = m_ActiveCamera->GetSettings().Position;
+    const glm::vec3 *directions = m_ActiveCamera->GetRayDirections();
+    // jitter moves the origin anywhere in a cube around the camera position
+    float margin = m_Settings.Jitter ? JITTER_RADIUS * 1.7321f : 0.0f;
+
+    m_ThreadPool.ParallelFor(tileCount, [&](uint32_t tile) {
+        uint32_t x0 = (tile % m_TileCountX) * CULLING_TILE_SIZE;
+        uint32_t y0 = (tile / m_TileCountX) * CULLING_TILE_SIZE;
+        uint32_t x1 = std::min(x0 + CULLING_TILE_SIZE, width) - 1;
+        uint32_t y1 = std::min(y0 + CULLING_TILE_SIZE, height) - 1;
+
+        // directions are interpolated over the image plane, so the corner rays bound all rays of the tile
+        glm::vec3 corners[4] = {directions[y0 * width + x0], directions[y0 * width + x1], directions[y1 * width + x1],
+                                directions[y1 * width + x0]};
+        Frustum frustum(origin, corners, margin);
+
+        const CompiledScene &compiled = GetLocalScene().Compiled;
+        std::vector<uint32_t> &tileGeometry = m_TileGeometry[tile];
+        tileGeometry.clear();
+        for (uint32_t i = 0; i < compiled.GetPrimitiveCount(); i++) {
+            if (frustum.Overlaps(compiled.GetBounds(i))) {
+                tileGeometry.push_back(i);
+            }
+        }
+    });
+}
+
+glm::vec3 Renderer::CalculateLighting(const HitPayload &hit, const BSDF &bsdf, uint32_t lightIndex) {
+    Ray shadowRay = GenerateShadowRay(hit, lightIndex);
+    if (TraceShadowRay(shadowRay, lightIndex)) {
+        return glm::vec3(0.0f);
+    }
+
+    return DirectLighting(bsdf, lightIndex, shadowRay);
+}
+
+uint32_t Renderer::GetLightSampleCount() const {
+    if (m_ActiveScene->LightSelection.GetType() == LightSamplingType::All) {
+        return (uint32_t)m_ActiveScene->Lights.size();
+    }
+    return m_ActiveScene->Lights.empty() ? 0 : (uint32_t)std::max(m_Settings.LightSamples, 1);
+}
+
+Renderer::LightChoice Renderer::ChooseLight(const HitPayload &hit, uint32_t sample, Sampler &sampler) const {
+    if (m_ActiveScene->LightSelection.GetType() == LightSamplingType::All) {
+        return {(int)sample, 1.0f};
+    }
+
+    // dividing by the probability of the light makes each sample an unbiased estimate of the light from all of them,
+    // and the samples are averaged
+    float pdf;
+    int lightIndex = m_ActiveScene->LightSelection.Sample(hit.WorldPosition, hit.WorldNormal, sampler.Get1D(), pdf);
+    if (lightIndex == -1 || pdf <= 0.0f) {
+        return {-1, 0.0f};
+    }
+    return {lightIndex, 1.0f / (pdf * GetLightSampleCount())};
+}
+
+Ray Renderer::GenerateShadowRay(const HitPayload &hit, uint32_t lightIndex) const {
+    const Light &light = m_ActiveScene->Lights[lightIndex];
+
+    // shadow, geometry behind a point light doesn't block it
     Ray shadowRay;
     shadowRay.Origin = hit.WorldPosition + hit.WorldNormal * 0.0001f;
 
     if (light.Type == LightType::Point) {
-        shadowRay.Direction = glm::normalize(light.Position - hit.WorldPosition);
+        glm::vec3 toLight = light.Position - shadowRay.Origin;
+        shadowRay.SetDirection(glm::normalize(toLight));
+        shadowRay.TMax = glm::length(toLight);
     } else if (light.Type == LightType::Directional) {
-        shadowRay.Direction = -light.Direction;
+        shadowRay.SetDirection(-light.Direction);
     }
 
-    if (TraceShadowRay(shadowRay)) {
-        return glm::vec3(0.0f);
+    return shadowRay;
+}
+
+int Renderer::SampleEmitter(const HitPayload &hit, const BSDF &bsdf, const DirectionTree *guide, Sampler &sampler,
+                            Ray &shadowRay, glm::vec3 &light) const {
+    const EmitterSampler &emitters = m_ActiveScene->Emitters;
+    if (!m_Settings.SampleEmitters || emitters.IsEmpty()) {
+        return -1;
+    }
+
+    glm::vec3 origin = hit.WorldPosition + hit.WorldNormal * 0.0001f;
+    float uEmitter = sampler.Get1D();
+    glm::vec2 u = sampler.Get2D();
+    EmitterSampler::EmitterSample sample;
+    if (!emitters.Sample(origin, uEmitter, u, sample)) {
+        return -1;
+    }
+    if (glm::dot(hit.WorldNormal, sample.Direction) <= 0.0f) {
+        return -1;
+    }
+
+    shadowRay = Ray(origin, sample.Direction, 0.0f, sample.Distance * (1.0f - EMITTER_SHADOW_EPSILON));
+
+    // weighed against a bounce ray sampled from the BSDF and guide finding the same point
+    light = bsdf.Evaluate(sample.Direction) * sample.Emission / sample.Pdf *
+            PowerHeuristic(sample.Pdf, BouncePdf(bsdf, guide, sample.Direction));
+    return (int)sample.Emitter;
+}
+
+float Renderer::EmissionWeight(const Ray &ray, const HitPayload &hit, float bouncePdf) const {
+    if (!m_Settings.SampleEmitters || bouncePdf <= 0.0f) {
+        return 1.0f;
     }
 
-    glm::vec3 lightDir = glm::normalize(shadowRay.Direction);
-    float lambert = glm::max(0.0f, glm::dot(hit.WorldNormal, lightDir));
-    glm::vec3 halfVector = glm::normalize(lightDir - glm::normalize(hit.WorldPosition - hit.WorldPosition));
-    float specular = 0.5 * glm::pow(glm::max(0.0f, glm::dot(hit.WorldNormal, halfVector)), 100.0f);
+    float emitterPdf =
+        m_ActiveScene->Emitters.Pdf(hit.Intersection.GeometryIndex, ray.Origin, hit.WorldPosition, hit.WorldNormal);
+    return emitterPdf > 0.0f ? PowerHeuristic(bouncePdf, emitterPdf) : 1.0f;
+}
+
+glm::vec3 Renderer::DirectLighting(const BSDF &bsdf, uint32_t lightIndex, const Ray &shadowRay) const {
+    const Light &light = m_ActiveScene->Lights[lightIndex];
+
+    // lights are as bright as the light a white diffuse surface facing them reflects, which is albedo / pi of it
+    glm::vec3 reflected = bsdf.Evaluate(glm::normalize(shadowRay.Direction)) * glm::pi<float>();
+    return reflected * light.Colour * light.Intensity;
+}
 
-    int materialIndex = m_ActiveScene->Geometry[hit.Intersection.GeometryIndex]->GetMaterialIndex(hit.WorldPosition);
-    Material material = m_ActiveScene->Materials[materialIndex];
+void Renderer::GenerateReservoirs(const Tile &tile) {
+    uint32_t width = m_FinalImage->GetWidth();
+    const LightSampler &lightSelection = m_ActiveScene->LightSelection;
+    int lightCount = (int)m_ActiveScene->Lights.size();
+
+    auto resample = [&](uint32_t pixel, const HitPayload &hit) {
+        LightReservoir reservoir;
+        if (hit.Intersection.GeometryIndex == -1) {
+            return reservoir;
+        }
+        uint32_t seed = ReservoirSeed(pixel, m_ReservoirFrame, 0);
+
+        // candidates from the scene's light sampler, or uniform when it traces every light, kept in proportion to the
+        // light they bring if unblocked
+        for (int candidate = 0; candidate < RESERVOIR_CANDIDATES; candidate++) {
+            float u = RTRandom::Float(seed);
+            float pdf = 1.0f / (float)lightCount;
+            int lightIndex = lightSelection.GetType() == LightSamplingType::All
+                                 ? std::min((int)(u * (float)lightCount), lightCount - 1)
+                                 : lightSelection.Sample(hit.WorldPosition, hit.WorldNormal, u, pdf);
+            float target = lightIndex != -1 && pdf > 0.0f ? ReservoirTarget(hit, lightIndex) : 0.0f;
+            reservoir.Update(lightIndex, target, target > 0.0f ? target / pdf : 0.0f, 1.0f, RTRandom::Float(seed));
+        }
+
+        // then the reservoir of the last frame at the same point, so what earlier frames found carries over; its
+        // candidates only count if its surface could have picked the light kept
+        int previous = m_Reservoirs.HasHistory ? ReprojectPixel(hit.WorldPosition) : -1;
+        if (previous != -1 && IsReusable(hit, m_Reservoirs.PreviousHits[previous])) {
+            LightReservoir history = m_Reservoirs.Previous[previous];
+            history.Count = std::min(history.Count, RESERVOIR_HISTORY * reservoir.Count);
+            float candidates = reservoir.Count;
+            reservoir.Merge(history, ReservoirTarget(hit, history.LightIndex), RTRandom::Float(seed));
+            bool reachable = ReservoirTarget(m_Reservoirs.PreviousHits[previous], reservoir.LightIndex) > 0.0f;
+            reservoir.Finalize(reachable ? reservoir.Count : candidates);
+            return reservoir;
+        }
+        reservoir.Finalize();
+        return reservoir;
+    };
+
+    bool packets = m_Settings.RayPackets && m_ActiveScene->Acceleration == AccelerationType::BVH;
+    for (uint32_t y = tile.Y; y < tile.Y + tile.Height; y += PACKET_HEIGHT) {
+        for (uint32_t x = tile.X; x < tile.X + tile.Width; x += PACKET_WIDTH) {
+            // the camera rays of each block of pixels, traced together where PerPacket would
+            Ray rays[PACKET_SIZE];
+            uint32_t pixelX[PACKET_SIZE];
+            uint32_t pixelY[PACKET_SIZE];
+            int count = 0;
+            for (uint32_t py = y; py < y + PACKET_HEIGHT && py < tile.Y + tile.Height; py++) {
+                for (uint32_t px = x; px < x + PACKET_WIDTH && px < tile.X + tile.Width; px++) {
+                    Sampler sampler;
+                    rays[count] = GeneratePrimaryRay(px, py, sampler);
+                    pixelX[count] = px;
+                    pixelY[count] = py;
+                    count++;
+                }
+            }
+
+            Intersection hits[PACKET_SIZE];
+            if (packets) {
+                RayPacket packet(rays, count);
+                TracePacket(packet, hits);
+            } else {
+                for (int lane = 0; lane < count; lane++) {
+                    const std::vector<uint32_t> *candidates = nullptr;
+                    if (m_TileCullingActive) {
+                        candidates = &m_TileGeometry[(pixelY[lane] / CULLING_TILE_SIZE) * m_TileCountX +
+                                                     pixelX[lane] / CULLING_TILE_SIZE];
+                    }
+                    hits[lane] = IntersectScene(rays[lane], candidates);
+                }
+            }
+
+            // pixels the second pass doesn't sample keep this reservoir for the next frame
+            for (int lane = 0; lane < count; lane++) {
+                uint32_t pixel = pixelY[lane] * width + pixelX[lane];
+                HitPayload &hit = m_Reservoirs.Hits[pixel];
+                hit = hits[lane].GeometryIndex == -1 ? Miss(rays[lane]) : ClosestHit(rays[lane], hits[lane]);
+                m_Reservoirs.Temporal[pixel] = resample(pixel, hit);
+                m_Reservoirs.Final[pixel] = m_Reservoirs.Temporal[pixel];
+            }
+        }
+    }
+}
+
+int Renderer::ReprojectPixel(const glm::vec3 &position) const {
+    glm::vec4 clip = m_Reservoirs.PreviousViewProjection * glm::vec4(position, 1.0f);
+    if (clip.w <= 0.0f) {
+        return -1;
+    }
 
-    glm::vec3 colour = material.Albedo * light.Colour * light.Intensity * (lambert + specular);
+    // inverse of the camera's mapping of pixel x to x / width * 2 - 1, rounded to the nearest pixel
+    int width = (int)m_FinalImage->GetWidth();
+    int height = (int)m_FinalImage->GetHeight();
+    int x = (int)std::floor((clip.x / clip.w * 0.5f + 0.5f) * (float)width + 0.5f);
+    int y = (int)std::floor((clip.y / clip.w * 0.5f + 0.5f) * (float)height + 0.5f);
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return -1;
+    }
+    return y * width + x;
+}
+
+bool Renderer::IsReusable(const HitPayload &hit, const HitPayload &other) const {
+    if (other.Intersection.GeometryIndex == -1 || other.MaterialIndex != hit.MaterialIndex) {
+        return false;
+    }
+    float planeDistance = std::abs(glm::dot(other.WorldPosition - hit.WorldPosition, hit.WorldNormal));
+    return glm::dot(hit.WorldNormal, other.WorldNormal) >= RESERVOIR_NORMAL_SIMILARITY &&
+           planeDistance <= RESERVOIR_DEPTH_SIMILARITY * hit.Intersection.T;
+}
+
+float Renderer::ReservoirTarget(const HitPayload &hit, int lightIndex) const {
+    if (lightIndex < 0 || lightIndex >= (int)m_ActiveScene->Lights.size()) {
+        return 0.0f;
+    }
+    // DirectLighting for a white diffuse BSDF, whose value is the cosine over pi
+    const Light &light = m_ActiveScene->Lights[lightIndex];
+    glm::vec3 direction =
+        light.Type == LightType::Point ? glm::normalize(light.Position - hit.WorldPosition) : -light.Direction;
+    return std::max(glm::dot(hit.WorldNormal, direction), 0.0f) * SIMD::Luminance(light.Colour) * light.Intensity;
+}
+
+int Renderer::SampleReservoirs(uint32_t x, uint32_t y, const HitPayload &hit, const BSDF &bsdf, Ray &shadowRay,
+                               glm::vec3 &light) {
+    int width = (int)m_FinalImage->GetWidth();
+    int height = (int)m_FinalImage->GetHeight();
+    uint32_t pixel = y * (uint32_t)width + x;
+    uint32_t seed = ReservoirSeed(pixel, m_ReservoirFrame, 1);
+
+    // the pixel's own reservoir, whose target is already for this hit, then those of neighbours picked uniformly in a
+    // disk around it; every reservoir stands for its candidates, so the light is picked out of all of them
+    LightReservoir reservoir;
+    const LightReservoir &own = m_Reservoirs.Temporal[pixel];
+    reservoir.Merge(own, own.Target, RTRandom::Float(seed));
+    const std::vector<glm::ivec2> &offsets = ReservoirOffsets();
+    uint32_t merged[RESERVOIR_NEIGHBOURS];
+    int mergedCount = 0;
+    for (int neighbour = 0; neighbour < RESERVOIR_NEIGHBOURS; neighbour++) {
+        glm::ivec2 offset = offsets[std::min((size_t)(RTRandom::Float(seed) * offsets.size()), offsets.size() - 1)];
+        int nx = (int)x + offset.x;
+        int ny = (int)y + offset.y;
+        if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+            continue;
+        }
+
+        uint32_t other = (uint32_t)(ny * width + nx);
+        if (IsReusable(hit, m_Reservoirs.Hits[other])) {
+            const LightReservoir &candidate = m_Reservoirs.Temporal[other];
+            reservoir.Merge(candidate, ReservoirTarget(hit, candidate.LightIndex), RTRandom::Float(seed));
+            merged[mergedCount++] = other;
+        }
+    }
+
+    // the candidates of neighbours whose surface could never have picked the light kept leave the count
+    float count = own.Count;
+    for (int i = 0; i < mergedCount; i++) {
+        const LightReservoir &other = m_Reservoirs.Temporal[merged[i]];
+        bool reachable = other.LightIndex == reservoir.LightIndex ||
+                         ReservoirTarget(m_Reservoirs.Hits[merged[i]], reservoir.LightIndex) > 0.0f;
+        if (reachable) {
+            count += other.Count;
+        }
+    }
+    reservoir.Finalize(count);
+    m_Reservoirs.Final[pixel] = reservoir;
+
+    if (reservoir.Weight <= 0.0f) {
+        return -1;
+    }
+    shadowRay = GenerateShadowRay(hit, (uint32_t)reservoir.LightIndex);
+    light = DirectLighting(bsdf, (uint32_t)reservoir.LightIndex, shadowRay) * reservoir.Weight;
+    return reservoir.LightIndex;
+}
 
-    return colour;
+void Renderer::OccludeReservoir(uint32_t x, uint32_t y) {
+    // the light it found blocked counts as a candidate that brought nothing, which the next frame reuses
+    m_Reservoirs.Final[(size_t)y * m_FinalImage->GetWidth() + x].Weight = 0.0f;
 }
@@ -1,10 +1,19 @@
 #pragma once
 
 #include "Camera.h"
+#include "Guiding/GuidingField.h"
+#include "Lighting/Reservoir.h"
 #include "Ray.h"
+#include "RayPacket.h"
+#include "Sampling/Sampler.h"
+#include "Shading/BSDF.h"
 #include "Scene.h"
+#include "Scheduling/NUMA.h"
+#include "Scheduling/TileScheduler.h"
 #include "Walnut/Image.h"
 
+#include <atomic>
+#include <functional>
 #include <glm/glm.hpp>
 #include <memory>
 #include <toml++/toml.hpp>
@@ -16,6 +25,54 @@ class Renderer {
         int MaxBounces = 5;
         float RenderScale = 0.5f;
         bool Jitter = true;
+        // end paths at random once they have RouletteDepth bounces, with a chance that falls with their throughput;
+        // the paths that go on are weighted up so the image stays unbiased
+        bool RussianRoulette = true;
+        int RouletteDepth = 5;
+        // test primary rays only against the geometry overlapping their screen tile, when not using an acceleration
+        // structure
+        bool TileCulling = true;
+        // trace primary rays in packets of neighbouring pixels when using the BVH
+        bool RayPackets = true;
+        // advance a batch of paths one stage at a time (intersection, shadows, shading) instead of one path at a time
+        bool Wavefront = false;
+        // group the wavefront's paths by material before the shadow and shading stages
+        bool SortPaths = true;
+        // width and height of the tiles the image is split into for the worker threads, rounded down to a multiple of 8;
+        // 0 picks it from the image size and the number of threads
+        int TileSize = 0;
+        // render threads, 0 uses one per core except the one reserved for the UI thread
+        int ThreadCount = 0;
+        // bind each render thread to its own core
+        bool PinThreads = false;
+        // keep the render threads off the first core, leaving it to the application's main loop
+        bool ReserveUICore = true;
+        // back the image buffers with 2 MiB pages where the OS supports them
+        bool HugePages = false;
+        // on machines with several NUMA nodes, give each node its own copy of the geometry and acceleration structures
+        bool ReplicateScene = true;
+        // once a pixel has MinSamples samples, keep sampling it only while the standard error of its mean luminance is
+        // above ErrorThreshold times that luminance; reset the frame index when turning it on
+        bool AdaptiveSampling = false;
+        int MinSamples = 16;
+        float ErrorThreshold = 0.01f;
+        // show how often each pixel was sampled (blue: rarely, red: every frame) instead of the image
+        bool ShowSampleDensity = false;
+        // shadow rays per bounce when the scene's lights are sampled at random instead of all being traced
+        int LightSamples = 1;
+        // at every bounce, also trace a shadow ray to a point picked on an emissive sphere or box, and weigh it against
+        // the bounce rays that find the same emitters (multiple importance sampling)
+        bool SampleEmitters = true;
+        // sample part of the bounces towards where earlier frames found light to come from (path guiding), the rest
+        // from the BSDF; what is learnt is kept while the camera moves and dropped when the scene changes
+        bool PathGuiding = false;
+        // share of the bounces sampled from the learnt light, where some was recorded
+        float GuidingFraction = 0.5f;
+        // light the camera rays' hits with one shadow ray each, towards a light picked from candidates that are reused
+        // across neighbouring pixels and, through reprojection, across frames (reservoir resampling, ReSTIR); direct
+        // lighting stays close to converged while the camera moves, a little dark near shadow edges; once the image
+        // accumulates the lights are sampled as without it, so it converges to the unbiased image
+        bool ReservoirLighting = false;
     };
 
   public:
@@ -29,32 +86,321 @@ class Renderer {
     void ResetFrameIndex() { m_FrameIndex = 1; }
 
     Settings &GetSettings() { return m_Settings; }
-    uint32_t *GetImageData() { return m_ImageData; }
+    uint32_t *GetImageData() { return m_ImageData.Data(); }
+    /// Number of rays (camera, bounce and shadow) traced during the last frame.
+    uint64_t GetRayCount() const { return m_RayCount; }
+    /// Average number of segments (camera ray and bounces) of the paths traced during the last frame.
+    float GetAveragePathLength() const { return m_AveragePathLength; }
+    /// Fraction of the pixels sampled during the last frame, below 1 with adaptive sampling.
+    float GetSampledPixels() const { return m_SampledPixels; }
+    /// Tile size used for the last frame, and how its tiles were spread over the threads.
+    uint32_t GetTileSize() const { return m_TileSize; }
+    const TileScheduler &GetScheduler() const { return m_Scheduler; }
+    /// Fraction of a sample of the image rows whose memory was on the node meant to render them at the end of the last
+    /// frame, -1 when the OS can't tell. It shows where the pages are, not how often they were accessed remotely.
+    float GetRowPlacement() const { return m_RowPlacement; }
+    /// Light learnt for path guiding, empty until guiding is first turned on.
+    const GuidingField &GetGuidingField() const { return m_Guiding; }
+
+    /**
+     * Runs a function over the rows of an image of the current size on the render threads. Each row goes to a thread of
+     * the node that renders it, so buffers filled this way for the first time are placed in that node's memory.
+     * @param rowCount Rows of the image.
+     */
+    void ForEachRow(uint32_t rowCount, const std::function<void(uint32_t y)> &row);
 
   private:
     struct HitPayload {
         Intersection Intersection;
         glm::vec3 WorldPosition;
         glm::vec3 WorldNormal;
+        glm::vec3 LocalPosition;
+        int MaterialIndex;
+    };
+
+    /// Path of one pixel, carried between the stages of the wavefront integrator.
+    struct PathState {
+        Ray NextRay; // traced by the next extend stage
+        HitPayload Hit;
+        glm::vec3 Light;        // gathered so far
+        glm::vec3 Contribution; // of the light gathered at the next hit
+        float BouncePdf;        // of NextRay per unit solid angle, 0 for the camera ray
+        Sampler PathSampler;
+        uint32_t X, Y;
+    };
+
+    /// Bounce of a path recorded for path guiding, which learns the light it found once the path ends.
+    struct GuidingVertex {
+        uint32_t Region;        // of the guiding field holding the hit
+        glm::vec3 Direction;
+        glm::vec3 Light;        // gathered by the path before the bounce
+        glm::vec3 Contribution; // of the light found by the bounce
+        float Pdf;              // of the direction per unit solid angle
+        uint32_t Path;          // with the wavefront integrator
+    };
+
+    /// Distribution a bounce direction is sampled from.
+    enum class BounceLobe { Diffuse, Specular, Guided };
+
+    /// Per-pixel state of reservoir resampling, kept across frames.
+    struct ReservoirBuffers {
+        NUMA::PageBuffer<HitPayload> Hits;         // of the camera rays of this frame
+        NUMA::PageBuffer<HitPayload> PreviousHits; // of the last frame
+        NUMA::PageBuffer<LightReservoir> Temporal; // after reusing the last frame's, read by the neighbours
+        NUMA::PageBuffer<LightReservoir> Final;    // after reusing the neighbours', blocked lights dropped
+        NUMA::PageBuffer<LightReservoir> Previous; // Final of the last frame
+        glm::mat4 PreviousViewProjection{1.0f};    // of the camera during the last frame
+        bool HasHistory = false;                   // Previous and PreviousHits hold the last frame
+        uint64_t Version = 0;                      // of the scene the reservoirs were made for
+    };
+
+    /// Light picked for one shadow ray, its light is scaled by the weight.
+    struct LightChoice {
+        int LightIndex; // -1 if no light can reach the hit
+        float Weight;
+    };
+
+    /// Shadow ray from a path's hit towards one light or emitter.
+    struct ShadowQuery {
+        Ray ShadowRay;
+        glm::vec3 Light; // reaching the path's hit if the ray is unoccluded, already weighted
+        uint32_t Path;
+        uint32_t LightIndex; // lights, then emitters
+        bool Occluded;
+    };
+
+    /// Path states and the queues of paths each stage works on, indices into Paths.
+    struct WavefrontQueues {
+        std::vector<PathState> Paths;
+        std::vector<uint32_t> Active; // paths that are still bouncing
+        std::vector<BSDF> Surfaces;   // at the hit of each active path, in the order of Active
+        // for path guiding, the region of the guiding field holding the same hits and the light learnt there, nullptr
+        // where there is none
+        std::vector<uint32_t> Regions;
+        std::vector<const DirectionTree *> Guides;
+        std::vector<GuidingVertex> GuidingVertices;
+        std::vector<uint32_t> Sorted;
+        std::vector<uint32_t> MaterialOffsets;
+        std::vector<ShadowQuery> Shadows;
+        bool Packets = false;               // primary rays are traced in packets
+        std::vector<uint32_t> PacketStarts; // first path of each packet, plus the path count
+    };
+
+    /// Copy of the scene's tracing data in the memory of one NUMA node.
+    struct SceneReplica {
+        CompiledScene Compiled;
+        BVH BoundingVolumes;
+        UniformGrid Grid;
+    };
+
+    /// Tracing data used by the calling thread.
+    struct SceneView {
+        const CompiledScene &Compiled;
+        const BVH &BoundingVolumes;
+        const UniformGrid &Grid;
     };
 
     glm::vec4 PerPixel(uint32_t x, uint32_t y); // ray gen shader
-    HitPayload TraceRay(const Ray &ray);
+    /**
+     * Renders the PACKET_WIDTH x PACKET_HEIGHT block of pixels starting at (x, y), tracing their primary rays together.
+     * @param tile Tile the block belongs to, pixels outside it are skipped.
+     * @param colours Colours of the tile, row by row.
+     */
+    void PerPacket(const Tile &tile, uint32_t x, uint32_t y, glm::vec4 *colours);
+    /**
+     * Camera ray through the pixel.
+     * @param sampler Set to the pixel's sampler for this frame, past the dimensions the camera ray used.
+     */
+    Ray GeneratePrimaryRay(uint32_t x, uint32_t y, Sampler &sampler);
+    /**
+     * Follows the path from its first hit and returns the light it gathers.
+     * @param x, y Pixel of the path, whose reservoir lights the first hit with reservoir lighting.
+     */
+    glm::vec4 TracePath(Ray ray, HitPayload hit, Sampler sampler, uint32_t x, uint32_t y);
+    /**
+     * Renders the tile with the wavefront integrator: the paths of all its pixels go through each stage of a bounce
+     * together, so each stage's code and data stay in cache across the batch.
+     * @param colours Colours of the tile, row by row.
+     */
+    void RenderWavefront(const Tile &tile, glm::vec4 *colours);
+    /// Creates a path per pixel of the tile, all of them active.
+    void GeneratePaths(WavefrontQueues &queues, const Tile &tile);
+    /// Finds the next hit of every active path, paths that miss gather the sky.
+    void ExtendPaths(WavefrontQueues &queues, int bounce);
+    /// Drops the paths that missed from the active queue.
+    void CompactPaths(WavefrontQueues &queues);
+    /// Orders the active queue by material.
+    void SortPaths(WavefrontQueues &queues);
+    /// Builds the surface at every active path's hit and traces its shadow rays, to its lights and to an emitter.
+    void TraceShadowRays(WavefrontQueues &queues, int bounce);
+    /// Adds the direct and emitted light of every active path and starts its next bounce, or ends it.
+    void ShadePaths(WavefrontQueues &queues, int bounce);
+    /**
+     * Russian roulette after the given bounce of a path.
+     * @param contribution Throughput of the path, weighted up if it goes on.
+     * @return false if the path ends.
+     */
+    bool ContinuePath(glm::vec3 &contribution, int bounce, Sampler &sampler) const;
+    /**
+     * Picks what to sample a bounce from.
+     * @param guide Light learnt at the hit, nullptr to sample the BSDF only.
+     * @param u Uniform random number in [0, 1).
+     */
+    BounceLobe ChooseBounceLobe(const BSDF &bsdf, const DirectionTree *guide, float u) const;
+    /// Direction sampled from one of the BSDF's lobes or the guide, the diffuse one with the kernel the wavefront
+    /// integrator uses.
+    glm::vec3 SampleBounceDirection(const BSDF &bsdf, const DirectionTree *guide, Sampler &sampler) const;
+    /// Probability per unit solid angle of sampling the bounce direction, 0 where the surface doesn't reflect it.
+    float BouncePdf(const BSDF &bsdf, const DirectionTree *guide, const glm::vec3 &direction) const;
+    /**
+     * Bounce off the hit's surface in a direction sampled from its BSDF and guide.
+     * @param contribution Throughput of the path, weighted by the BSDF over the direction's probability.
+     * @param pdf Set to the probability of the direction per unit solid angle, 0 if the surface doesn't reflect it.
+     */
+    Ray GenerateBounceRay(const HitPayload &hit, const BSDF &bsdf, const DirectionTree *guide,
+                          const glm::vec3 &direction, glm::vec3 &contribution, float &pdf) const;
+    /// Teaches the guiding field the light a bounce found, from the light its path had gathered when it ended.
+    void RecordGuidingVertex(const GuidingVertex &vertex, const glm::vec3 &pathLight);
+    /// Starts learning the scene's light over when it changed since the field was reset.
+    void UpdateGuidingField(const Scene &scene);
+    /// Allocates the reservoirs for the current image size, and drops their history when it no longer applies.
+    void UpdateReservoirs(const Scene &scene);
+    /**
+     * First pass of reservoir resampling over the tile: traces the camera rays, and streams light candidates and the
+     * last frame's reservoir at the same point into each pixel's reservoir.
+     */
+    void GenerateReservoirs(const Tile &tile);
+    /// Pixel of the last frame that saw the point, -1 if it was outside the image.
+    int ReprojectPixel(const glm::vec3 &position) const;
+    /// Whether one of two camera ray hits can reuse the light picked for the other, being on a similar surface.
+    bool IsReusable(const HitPayload &hit, const HitPayload &other) const;
+    /**
+     * Target function of reservoir resampling: luminance a white diffuse surface at the hit would reflect from the
+     * light if it isn't blocked. It is much cheaper than the BSDF, and only 0 where the light can't reach the surface.
+     */
+    float ReservoirTarget(const HitPayload &hit, int lightIndex) const;
+    /**
+     * Picks the light of a camera ray's hit out of the reservoirs of its pixel and a few neighbours, the pixel keeps
+     * the result for the next frame.
+     * @param shadowRay Set to the ray towards the light.
+     * @param light Set to the light the surface reflects if the ray is unoccluded, weighted.
+     * @return Index of the light, or -1 if no reservoir holds one.
+     */
+    int SampleReservoirs(uint32_t x, uint32_t y, const HitPayload &hit, const BSDF &bsdf, Ray &shadowRay,
+                         glm::vec3 &light);
+    /// Drops the light the pixel keeps for the next frame, after its shadow ray was found blocked.
+    void OccludeReservoir(uint32_t x, uint32_t y);
+    /// Tile size from the settings, or the largest that gives each worker several tiles.
+    uint32_t ChooseTileSize(uint32_t workerCount) const;
+    /// Renders the tile's pixels, adds them to the accumulated colours and updates that part of the image.
+    void RenderTile(const Tile &tile);
+    /// False once adaptive sampling considers the pixel converged.
+    bool NeedsSample(uint32_t x, uint32_t y) const;
+    /// Whether any pixel of the tile's packet starting at (x, y) needs a sample, packets are traced as a whole.
+    bool PacketNeedsSample(const Tile &tile, uint32_t x, uint32_t y) const;
+    /**
+     * Finds the closest hit along the ray.
+     * @param ray Ray to trace.
+     * @param candidates Geometry the ray can hit, or nullptr to test the whole scene.
+     */
+    HitPayload TraceRay(Ray ray, const std::vector<uint32_t> *candidates = nullptr);
+    /// Same as TraceRay without resolving the hit.
+    Intersection IntersectScene(Ray ray, const std::vector<uint32_t> *candidates = nullptr);
+    /**
+     * Finds the closest hit of every ray of a packet.
+     * @param hits Set to the closest hit of each ray, GeometryIndex is -1 for a miss.
+     */
+    void TracePacket(RayPacket &packet, Intersection *hits);
     HitPayload ClosestHit(const Ray &ray, Intersection intersection);
     HitPayload Miss(const Ray &ray);
-    bool TraceShadowRay(const Ray &ray);
-    glm::vec3 CalculateLighting(const HitPayload &hit, const Light &light);
+    bool TraceShadowRay(const Ray &ray, uint32_t lightIndex);
+    glm::vec3 CalculateLighting(const HitPayload &hit, const BSDF &bsdf, uint32_t lightIndex);
+    /// Number of shadow rays traced at each hit: one per light, or LightSamples when the lights are sampled.
+    uint32_t GetLightSampleCount() const;
+    /**
+     * Light for one of the GetLightSampleCount() shadow rays at a hit.
+     * @param sample Which of the shadow rays, the light with that index when every light is traced.
+     * @param sampler Sampler of the path, advanced when the light is picked at random.
+     */
+    LightChoice ChooseLight(const HitPayload &hit, uint32_t sample, Sampler &sampler) const;
+    /// Ray from the hit towards the light, its interval ends at point lights.
+    Ray GenerateShadowRay(const HitPayload &hit, uint32_t lightIndex) const;
+    /// Light the surface reflects from an unoccluded light.
+    glm::vec3 DirectLighting(const BSDF &bsdf, uint32_t lightIndex, const Ray &shadowRay) const;
+    /**
+     * Picks a point on an emissive sphere or box to light the hit with (next event estimation).
+     * @param shadowRay Set to the ray towards the point, its interval ends just before the emitter.
+     * @param light Set to the light the surface reflects if the ray is unoccluded, weighted against bounce rays.
+     * @return Index of the emitter, or -1 if there's nothing to sample.
+     */
+    int SampleEmitter(const HitPayload &hit, const BSDF &bsdf, const DirectionTree *guide, Sampler &sampler,
+                      Ray &shadowRay, glm::vec3 &light) const;
+    /**
+     * Weight of the emission found by a bounce ray, against SampleEmitter picking the same point. It is exactly 1 where
+     * SampleEmitter can't pick the point (emissive SDFs, planes and transformed geometry) and when Sample Emitters is
+     * off. The emission is still scaled by the throughput of the path that reaches it, like reflected light.
+     * @param ray Ray that found the hit.
+     * @param bouncePdf Probability of the ray's direction per unit solid angle, 0 for camera rays which aren't weighted.
+     */
+    float EmissionWeight(const Ray &ray, const HitPayload &hit, float bouncePdf) const;
+    /// Builds the list of geometry overlapping the frustum of each screen tile.
+    void CullTiles();
+    /// Restarts the thread pool if its settings changed.
+    void UpdateThreadPool();
+    /// Allocates the image buffers and fills them from the threads that render each row.
+    void AllocateImageData(uint32_t width, uint32_t height);
+    /// Samples where the pages of the image rows are, see GetRowPlacement.
+    void MeasureRowPlacement();
+    /// Worker whose node renders each row, see ForEachRow.
+    std::vector<uint32_t> AssignRows(uint32_t rowCount) const;
+    /// Copies the scene into each node's memory when it changed since the last copy.
+    void UpdateSceneReplicas(const Scene &scene);
+    /// Replica of the calling thread's node, or the scene itself when it isn't replicated.
+    SceneView GetLocalScene() const;
 
   private:
     Settings m_Settings;
 
     std::shared_ptr<Walnut::Image> m_FinalImage;
-    uint32_t *m_ImageData = nullptr;
-    glm::vec4 *m_AccumulationData = nullptr;
+    // pages are placed by the first thread to touch them, see AllocateImageData
+    NUMA::PageBuffer<uint32_t> m_ImageData;
+    NUMA::PageBuffer<glm::vec4> m_AccumulationData; // alpha counts the samples of each pixel
+    NUMA::PageBuffer<float> m_LuminanceSquares;     // for the variance of each pixel, with adaptive sampling
+    float m_RowPlacement = -1.0f;
 
     uint32_t m_FrameIndex = 1;
+    std::atomic<uint64_t> m_RayCount = 0;
+    std::atomic<uint64_t> m_SampledPixelCount = 0;
+    std::atomic<uint64_t> m_PathCount = 0;
+    std::atomic<uint64_t> m_PathSegmentCount = 0;
+    float m_AveragePathLength = 0.0f;
+    float m_SampledPixels = 1.0f;
+
+    // tiles in scheduling order, rebuilt when the image or the tile size changes
+    uint32_t m_TileSize = 0;
+    std::vector<Tile> m_Tiles;
+    TileScheduler m_Scheduler;
+    // workers are started with the first frame and sleep between frames
+    ThreadPool m_ThreadPool;
+
+    // geometry that primary rays of each tile can hit, tiles are stored row by row
+    bool m_TileCullingActive = false;
+    uint32_t m_TileCountX = 0;
+    std::vector<std::vector<uint32_t>> m_TileGeometry;
+
+    // one per NUMA node when there are several, empty otherwise
+    std::vector<std::unique_ptr<SceneReplica>> m_Replicas;
+    uint64_t m_ReplicaVersion = 0;
+
+    // light learnt for path guiding, kept across frames and camera moves
+    GuidingField m_Guiding;
+    uint64_t m_GuidingVersion = 0;
+    bool m_GuidingActive = false; // during the current frame
 
-    std::vector<uint32_t> m_ImageVerticalterator;
+    // reservoirs of reservoir lighting, freed when it is turned off
+    ReservoirBuffers m_Reservoirs;
+    bool m_ReservoirsActive = false; // during the current frame
+    uint32_t m_ReservoirFrame = 0;   // seeds the choices of each frame, unlike the frame index it isn't reset
 
     const Scene *m_ActiveScene = nullptr;
     const Camera *m_ActiveCamera = nullptr;
@@ -0,0 +1,144 @@
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+const SIMD::KernelTable *SIMD::Detail::ActiveKernels = &SIMD::Detail::ScalarKernels;
+
+namespace {
+using SIMD::ISA;
+
+#if defined(SIMD_X86)
+void CPUID(int leaf, int subleaf, unsigned int registers[4]) {
+#if defined(_MSC_VER)
+    __cpuidex(reinterpret_cast<int *>(registers), leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+/// Register state the OS saves on context switches, AVX registers are only usable if it saves them.
+uint64_t XGETBV() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int low, high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return ((uint64_t)high << 32) | low;
+#endif
+}
+#endif
+
+/// Widest instruction set supported by both the CPU and the OS.
+ISA DetectISA() {
+#if defined(SIMD_X86)
+    unsigned int registers[4]; // eax, ebx, ecx, edx
+    CPUID(0, 0, registers);
+    unsigned int maxLeaf = registers[0];
+
+    CPUID(1, 0, registers);
+    bool sse2 = registers[3] & (1u << 26);
+    bool fma = registers[2] & (1u << 12);
+    bool osxsave = registers[2] & (1u << 27);
+    bool avx = registers[2] & (1u << 28);
+    if (!sse2) {
+        return ISA::Scalar;
+    }
+    if (!osxsave || !avx || maxLeaf < 7) {
+        return ISA::SSE2;
+    }
+
+    uint64_t osState = XGETBV();
+    bool osAVX = (osState & 0x6) == 0x6;      // SSE and AVX state
+    bool osAVX512 = (osState & 0xe6) == 0xe6; // plus opmask and upper ZMM state
+
+    CPUID(7, 0, registers);
+    bool avx2 = registers[1] & (1u << 5);
+    bool avx512 = (registers[1] & (1u << 16)) && (registers[1] & (1u << 17)) && (registers[1] & (1u << 30)) &&
+                  (registers[1] & (1u << 31)); // F, DQ, BW, VL
+
+    if (osAVX512 && avx512 && avx2 && fma) {
+        return ISA::AVX512;
+    }
+    if (osAVX && avx2 && fma) {
+        return ISA::AVX2;
+    }
+    return ISA::SSE2;
+#else
+    return ISA::Scalar;
+#endif
+}
+
+const SIMD::KernelTable *GetKernels(ISA isa) {
+    switch (isa) {
+    case ISA::AVX512:
+        return SIMD::Detail::GetAVX512Kernels();
+    case ISA::AVX2:
+        return SIMD::Detail::GetAVX2Kernels();
+    case ISA::SSE2:
+        return SIMD::Detail::GetSSE2Kernels();
+    case ISA::Scalar:
+        return &SIMD::Detail::ScalarKernels;
+    }
+    return nullptr;
+}
+
+bool ParseISA(std::string name, ISA &isa) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    name.erase(std::remove(name.begin(), name.end(), '-'), name.end());
+
+    if (name == "scalar") {
+        isa = ISA::Scalar;
+    } else if (name == "sse2") {
+        isa = ISA::SSE2;
+    } else if (name == "avx2") {
+        isa = ISA::AVX2;
+    } else if (name == "avx512") {
+        isa = ISA::AVX512;
+    } else {
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+void SIMD::SelectKernels(const char *requested) {
+    ISA supported = DetectISA();
+    ISA isa = supported;
+
+    if (!requested) {
+        requested = std::getenv("RAYTRACER_ISA");
+    }
+    if (requested && *requested) {
+        ISA requestedISA;
+        if (!ParseISA(requested, requestedISA)) {
+            std::cerr << "Unknown instruction set: " << requested << ". skipping..." << std::endl;
+        } else if (requestedISA > supported) {
+            std::cerr << "Instruction set " << requested << " not supported by this CPU. skipping..." << std::endl;
+        } else {
+            isa = requestedISA;
+        }
+    }
+
+    // fall back to narrower kernels if the wider ones weren't built, e.g. for other architectures
+    const KernelTable *kernels = GetKernels(isa);
+    while (!kernels) {
+        isa = (ISA)((int)isa - 1);
+        kernels = GetKernels(isa);
+    }
+
+    Detail::ActiveKernels = kernels;
+    std::cout << "Kernels: " << kernels->Name << std::endl;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct BoxBlock;
+struct BoxPrimitive;
+struct Bounds;
+struct PlanePrimitive;
+struct Ray;
+struct RayPacket;
+struct SamplerState;
+struct SDFInstruction;
+struct SphereBlock;
+struct SpherePrimitive;
+
+namespace SIMD {
+enum class ISA { Scalar, SSE2, AVX2, AVX512 };
+
+/// Entry points of the vectorised kernels. The same kernels are built once per instruction set, each in its own
+/// translation unit compiled for that target, and the table for the best one the CPU supports is picked at startup.
+struct KernelTable {
+    ISA Target;
+    const char *Name;
+
+    /**
+     * Closest hit among the spheres of the blocks.
+     * @param ray Ray to trace, its TMax is shrunk to the hit.
+     * @return Index of the sphere hit (block * SIMD_BLOCK_WIDTH + lane), or -1 if none is hit within the interval.
+     */
+    int (*IntersectSpheres)(const SphereBlock *blocks, uint32_t blockCount, Ray &ray);
+    int (*IntersectBoxes)(const BoxBlock *blocks, uint32_t blockCount, Ray &ray);
+    /// Index of any sphere of the blocks blocking the ray, or -1.
+    int (*OccludedSpheres)(const SphereBlock *blocks, uint32_t blockCount, const Ray &ray);
+    int (*OccludedBoxes)(const BoxBlock *blocks, uint32_t blockCount, const Ray &ray);
+
+    /// Tests every ray of the packet against the primitive, shrinking the interval of the rays that hit it.
+    /// @return Bit i is set if ray i hit it.
+    uint32_t (*IntersectSpherePacket)(RayPacket &packet, const SpherePrimitive &sphere);
+    uint32_t (*IntersectBoxPacket)(RayPacket &packet, const BoxPrimitive &box);
+    uint32_t (*IntersectPlanePacket)(RayPacket &packet, const PlanePrimitive &plane);
+    /// Bit i is set if ray i overlaps the bounds within its interval.
+    uint32_t (*OverlapBoundsPacket)(const RayPacket &packet, const Bounds &bounds);
+
+    /// Distance of the flattened SDF program at each of the points.
+    void (*EvaluateSDF)(const SDFInstruction *program, uint32_t instructionCount, const glm::vec3 *points,
+                        float *distances, uint32_t pointCount);
+
+    /// Adds the colours to the accumulated colours and writes the averages over frameIndex frames as RGBA8.
+    void (*ResolvePixels)(glm::vec4 *accumulation, const glm::vec4 *colours, uint32_t *image, uint32_t count,
+                          float frameIndex);
+    /**
+     * Same as ResolvePixels, averaging each pixel over its own samples, counted in the accumulated alpha. Colours with
+     * alpha 0 are pixels that weren't sampled this frame.
+     * @param luminanceSquares Sum of the squared luminance of each pixel's samples, updated with the new colours.
+     */
+    void (*ResolvePixelsAdaptive)(glm::vec4 *accumulation, float *luminanceSquares, const glm::vec4 *colours,
+                                  uint32_t *image, uint32_t count);
+
+    /// Next 2D sample of each sampler, the same bits Sampler::Get2D gives, moving the samplers to their next dimension.
+    void (*Sample2D)(SamplerState *samplers, glm::vec2 *samples, uint32_t count);
+    // the Warp mappings of each sample, with polynomial sines and cosines, so they agree with Warp to a few ulps
+    void (*UniformDisk)(const glm::vec2 *samples, glm::vec2 *points, uint32_t count);
+    void (*UniformSphere)(const glm::vec2 *samples, glm::vec3 *directions, uint32_t count);
+    /// Cosine-weighted directions around the normals, one normal per sample.
+    void (*CosineHemisphere)(const glm::vec2 *samples, const glm::vec3 *normals, glm::vec3 *directions,
+                             uint32_t count);
+};
+
+/**
+ * Picks the kernels for this CPU and logs the choice.
+ * @param requested Name of the instruction set to use instead (scalar, sse2, avx2 or avx512), or nullptr to use the
+ * RAYTRACER_ISA environment variable if set. Ignored with a warning if the CPU doesn't support it.
+ */
+void SelectKernels(const char *requested = nullptr);
+
+namespace Detail {
+extern const KernelTable *ActiveKernels;
+extern const KernelTable ScalarKernels;
+
+// one getter per translation unit, nullptr if that unit wasn't compiled for its instruction set
+const KernelTable *GetSSE2Kernels();
+const KernelTable *GetAVX2Kernels();
+const KernelTable *GetAVX512Kernels();
+} // namespace Detail
+
+/// Kernels chosen by SelectKernels, the scalar ones until it is called.
+inline const KernelTable &Kernels() { return *Detail::ActiveKernels; }
+
+/// Luminance of a linear RGB colour, Rec. 709 weights.
+inline float Luminance(const glm::vec3 &colour) { return glm::dot(colour, glm::vec3(0.2126f, 0.7152f, 0.0722f)); }
+
+/// Index of the lowest set bit, bits must not be 0.
+inline int FirstLane(uint32_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+} // namespace SIMD
@@ -0,0 +1,632 @@
+#pragma once
+
+#include "../Compiled/PrimitiveBlocks.h"
+#include "../Geometry/Bounds.h"
+#include "../Geometry/Primitives.h"
+#include "../Geometry/SDF/SDFProgram.h"
+#include "../RayPacket.h"
+#include "../Sampling/SamplerState.h"
+#include "Kernels.h"
+#include "SIMD.h"
+
+#include <math.h>
+
+// Kernel bodies, included once by each Kernels_<ISA>.cpp and compiled for that unit's instruction set.
+//
+// Inline functions defined outside this file (glm, the standard library, the primitives' methods) have one copy in the
+// program, and the linker may keep the one compiled here, with instructions the CPU might not support. So the kernels
+// only read fields of those types and use constants and C library functions, never their inline functions.
+
+static_assert(SIMD_BLOCK_WIDTH % SIMD_WIDTH == 0, "blocks must be a whole number of registers");
+static_assert(PACKET_SIZE % SIMD_WIDTH == 0, "packets must be a whole number of registers");
+
+namespace {
+using SIMD::Float;
+using SIMD::Int;
+using SIMD::Mask;
+
+constexpr float INF = std::numeric_limits<float>::infinity();
+
+/// Ray broadcast to every lane, set up once per ray and shared by all blocks it's tested against.
+struct RayLanes {
+    Float OriginX, OriginY, OriginZ;
+    Float DirectionX, DirectionY, DirectionZ;
+    Float InverseDirectionX, InverseDirectionY, InverseDirectionZ;
+    Float DirectionLengthSquared;
+    Float TMin;
+    const int *Sign;
+
+    explicit RayLanes(const Ray &ray)
+        : OriginX(Float::Broadcast(ray.Origin.x)), OriginY(Float::Broadcast(ray.Origin.y)),
+          OriginZ(Float::Broadcast(ray.Origin.z)), DirectionX(Float::Broadcast(ray.Direction.x)),
+          DirectionY(Float::Broadcast(ray.Direction.y)), DirectionZ(Float::Broadcast(ray.Direction.z)),
+          InverseDirectionX(Float::Broadcast(ray.InverseDirection.x)),
+          InverseDirectionY(Float::Broadcast(ray.InverseDirection.y)),
+          InverseDirectionZ(Float::Broadcast(ray.InverseDirection.z)),
+          DirectionLengthSquared(Float::Broadcast(ray.Direction.x * ray.Direction.x + ray.Direction.y * ray.Direction.y +
+                                                  ray.Direction.z * ray.Direction.z)),
+          TMin(Float::Broadcast(ray.TMin)), Sign(ray.Sign) {}
+};
+
+/// Nearest of two sorted roots inside (tMin, tMax), infinity where neither is.
+Float NearestInInterval(Float tNear, Float tFar, Float tMin, Float tMax) {
+    Mask nearInside = (tNear > tMin) & (tNear < tMax);
+    Mask farInside = (tFar > tMin) & (tFar < tMax);
+    return SIMD::Select(nearInside, tNear, SIMD::Select(farInside, tFar, Float::Broadcast(INF)));
+}
+
+/// Roots of |o + t d - c|^2 = r^2 computed as in SpherePrimitive::Intersect, the nearest inside the interval or infinity.
+Float IntersectSphere(Float ocX, Float ocY, Float ocZ, Float dX, Float dY, Float dZ, Float a, Float radiusSquared,
+                      Float tMin, Float tMax) {
+    Float halfB = dX * ocX + dY * ocY + dZ * ocZ;
+    Float c = ocX * ocX + ocY * ocY + ocZ * ocZ - radiusSquared;
+
+    Float k = halfB / a;
+    Float closestX = ocX - k * dX;
+    Float closestY = ocY - k * dY;
+    Float closestZ = ocZ - k * dZ;
+    Float discriminant = a * (radiusSquared - (closestX * closestX + closestY * closestY + closestZ * closestZ));
+
+    Mask hit = discriminant >= Float::Broadcast(0.0f);
+    Float root = SIMD::Sqrt(SIMD::Max(discriminant, Float::Broadcast(0.0f)));
+    Float q = -(halfB + SIMD::Select(halfB >= Float::Broadcast(0.0f), root, -root));
+    Float t0 = q / a;
+    Float t1 = SIMD::Select(q != Float::Broadcast(0.0f), c / q, t0);
+
+    Float t = NearestInInterval(SIMD::Min(t0, t1), SIMD::Max(t0, t1), tMin, tMax);
+    return SIMD::Select(hit, t, Float::Broadcast(INF));
+}
+
+// block kernels: one ray against the lanes [offset, offset + SIMD_WIDTH) of a block
+
+Float IntersectSphereLanes(const SphereBlock &block, int offset, const RayLanes &ray, Float tMax) {
+    return IntersectSphere(ray.OriginX - Float::Load(block.X + offset), ray.OriginY - Float::Load(block.Y + offset),
+                           ray.OriginZ - Float::Load(block.Z + offset), ray.DirectionX, ray.DirectionY, ray.DirectionZ,
+                           ray.DirectionLengthSquared, Float::Load(block.RadiusSquared + offset), ray.TMin, tMax);
+}
+
+/// Branch-free slab test: the near and far planes are picked once from the ray's sign, not per box.
+Float IntersectBoxLanes(const BoxBlock &block, int offset, const RayLanes &ray, Float tMax) {
+    const float(*planes[2])[SIMD_BLOCK_WIDTH] = {block.Min, block.Max};
+
+    Float tXLow = (Float::Load(planes[ray.Sign[0]][0] + offset) - ray.OriginX) * ray.InverseDirectionX;
+    Float tXHigh = (Float::Load(planes[1 - ray.Sign[0]][0] + offset) - ray.OriginX) * ray.InverseDirectionX;
+    Float tYLow = (Float::Load(planes[ray.Sign[1]][1] + offset) - ray.OriginY) * ray.InverseDirectionY;
+    Float tYHigh = (Float::Load(planes[1 - ray.Sign[1]][1] + offset) - ray.OriginY) * ray.InverseDirectionY;
+    Float tZLow = (Float::Load(planes[ray.Sign[2]][2] + offset) - ray.OriginZ) * ray.InverseDirectionZ;
+    Float tZHigh = (Float::Load(planes[1 - ray.Sign[2]][2] + offset) - ray.OriginZ) * ray.InverseDirectionZ;
+
+    Float tLow = SIMD::Max(SIMD::Max(tXLow, tYLow), tZLow);
+    Float tHigh = SIMD::Min(SIMD::Min(tXHigh, tYHigh), tZHigh);
+
+    // entering the box, or leaving it if the ray starts inside
+    Float t = NearestInInterval(tLow, tHigh, ray.TMin, tMax);
+    return SIMD::Select(tLow <= tHigh, t, Float::Broadcast(INF));
+}
+
+template <typename Block, Float (*Kernel)(const Block &, int, const RayLanes &, Float)>
+int IntersectBlocks(const Block *blocks, uint32_t blockCount, Ray &ray) {
+    RayLanes lanes(ray);
+    int closest = -1;
+
+    for (uint32_t block = 0; block < blockCount; block++) {
+        for (int offset = 0; offset < SIMD_BLOCK_WIDTH; offset += SIMD_WIDTH) {
+            Float tMax = Float::Broadcast(ray.TMax);
+            Float t = Kernel(blocks[block], offset, lanes, tMax);
+            if (!(t < tMax).Any()) {
+                continue;
+            }
+
+            float tClosest = SIMD::HorizontalMin(t);
+            ray.TMax = tClosest;
+            int lane = SIMD::FirstLane((t == Float::Broadcast(tClosest)).Bits());
+            closest = (int)(block * SIMD_BLOCK_WIDTH) + offset + lane;
+        }
+    }
+
+    return closest;
+}
+
+template <typename Block, Float (*Kernel)(const Block &, int, const RayLanes &, Float)>
+int OccludedBlocks(const Block *blocks, uint32_t blockCount, const Ray &ray) {
+    RayLanes lanes(ray);
+    Float tMax = Float::Broadcast(ray.TMax);
+
+    for (uint32_t block = 0; block < blockCount; block++) {
+        for (int offset = 0; offset < SIMD_BLOCK_WIDTH; offset += SIMD_WIDTH) {
+            uint32_t bits = (Kernel(blocks[block], offset, lanes, tMax) < tMax).Bits();
+            if (bits != 0) {
+                return (int)(block * SIMD_BLOCK_WIDTH) + offset + SIMD::FirstLane(bits);
+            }
+        }
+    }
+
+    return -1;
+}
+
+// packet kernels: the rays in lanes [offset, offset + SIMD_WIDTH) of a packet against one primitive
+
+Float IntersectSpherePacketLanes(const RayPacket &packet, int offset, const SpherePrimitive &sphere) {
+    Float dX = Float::Load(packet.DirectionX + offset);
+    Float dY = Float::Load(packet.DirectionY + offset);
+    Float dZ = Float::Load(packet.DirectionZ + offset);
+
+    return IntersectSphere(Float::Load(packet.OriginX + offset) - Float::Broadcast(sphere.Position.x),
+                           Float::Load(packet.OriginY + offset) - Float::Broadcast(sphere.Position.y),
+                           Float::Load(packet.OriginZ + offset) - Float::Broadcast(sphere.Position.z), dX, dY, dZ,
+                           dX * dX + dY * dY + dZ * dZ, Float::Broadcast(sphere.Radius * sphere.Radius),
+                           Float::Load(packet.TMin + offset), Float::Load(packet.TMax + offset));
+}
+
+/// The rays' direction signs can differ, so each lane orders its own slab distances.
+Float IntersectBoxPacketLanes(const RayPacket &packet, int offset, const BoxPrimitive &box) {
+    Float oX = Float::Load(packet.OriginX + offset), invX = Float::Load(packet.InverseDirectionX + offset);
+    Float oY = Float::Load(packet.OriginY + offset), invY = Float::Load(packet.InverseDirectionY + offset);
+    Float oZ = Float::Load(packet.OriginZ + offset), invZ = Float::Load(packet.InverseDirectionZ + offset);
+    Float tX0 = (Float::Broadcast(box.Min.x) - oX) * invX, tX1 = (Float::Broadcast(box.Max.x) - oX) * invX;
+    Float tY0 = (Float::Broadcast(box.Min.y) - oY) * invY, tY1 = (Float::Broadcast(box.Max.y) - oY) * invY;
+    Float tZ0 = (Float::Broadcast(box.Min.z) - oZ) * invZ, tZ1 = (Float::Broadcast(box.Max.z) - oZ) * invZ;
+
+    Float tLow = SIMD::Max(SIMD::Max(SIMD::Min(tX0, tX1), SIMD::Min(tY0, tY1)), SIMD::Min(tZ0, tZ1));
+    Float tHigh = SIMD::Min(SIMD::Min(SIMD::Max(tX0, tX1), SIMD::Max(tY0, tY1)), SIMD::Max(tZ0, tZ1));
+
+    Float t = NearestInInterval(tLow, tHigh, Float::Load(packet.TMin + offset), Float::Load(packet.TMax + offset));
+    return SIMD::Select(tLow <= tHigh, t, Float::Broadcast(INF));
+}
+
+Float IntersectPlanePacketLanes(const RayPacket &packet, int offset, const PlanePrimitive &plane) {
+    Float nX = Float::Broadcast(plane.Normal.x);
+    Float nY = Float::Broadcast(plane.Normal.y);
+    Float nZ = Float::Broadcast(plane.Normal.z);
+
+    Float denom = Float::Load(packet.DirectionX + offset) * nX + Float::Load(packet.DirectionY + offset) * nY +
+                  Float::Load(packet.DirectionZ + offset) * nZ;
+    Float distance = (Float::Broadcast(plane.Position.x) - Float::Load(packet.OriginX + offset)) * nX +
+                     (Float::Broadcast(plane.Position.y) - Float::Load(packet.OriginY + offset)) * nY +
+                     (Float::Broadcast(plane.Position.z) - Float::Load(packet.OriginZ + offset)) * nZ;
+    Float t = distance / denom;
+
+    Mask hit = (SIMD::Abs(denom) > Float::Broadcast(1e-6f)) & (t > Float::Load(packet.TMin + offset)) &
+               (t < Float::Load(packet.TMax + offset));
+    return SIMD::Select(hit, t, Float::Broadcast(INF));
+}
+
+template <typename Primitive, Float (*Kernel)(const RayPacket &, int, const Primitive &)>
+uint32_t IntersectPacket(RayPacket &packet, const Primitive &primitive) {
+    uint32_t hits = 0;
+
+    for (int offset = 0; offset < PACKET_SIZE; offset += SIMD_WIDTH) {
+        Float t = Kernel(packet, offset, primitive);
+        Float tMax = Float::Load(packet.TMax + offset);
+        Mask closer = t < tMax;
+
+        SIMD::Select(closer, t, tMax).Store(packet.TMax + offset);
+        hits |= closer.Bits() << offset;
+    }
+
+    return hits;
+}
+
+uint32_t OverlapBoundsPacket(const RayPacket &packet, const Bounds &bounds) {
+    uint32_t overlaps = 0;
+
+    for (int offset = 0; offset < PACKET_SIZE; offset += SIMD_WIDTH) {
+        Float oX = Float::Load(packet.OriginX + offset), invX = Float::Load(packet.InverseDirectionX + offset);
+        Float oY = Float::Load(packet.OriginY + offset), invY = Float::Load(packet.InverseDirectionY + offset);
+        Float oZ = Float::Load(packet.OriginZ + offset), invZ = Float::Load(packet.InverseDirectionZ + offset);
+        Float tX0 = (Float::Broadcast(bounds.Min.x) - oX) * invX, tX1 = (Float::Broadcast(bounds.Max.x) - oX) * invX;
+        Float tY0 = (Float::Broadcast(bounds.Min.y) - oY) * invY, tY1 = (Float::Broadcast(bounds.Max.y) - oY) * invY;
+        Float tZ0 = (Float::Broadcast(bounds.Min.z) - oZ) * invZ, tZ1 = (Float::Broadcast(bounds.Max.z) - oZ) * invZ;
+
+        Float tEntry = SIMD::Max(SIMD::Max(SIMD::Min(tX0, tX1), SIMD::Min(tY0, tY1)),
+                                 SIMD::Max(SIMD::Min(tZ0, tZ1), Float::Load(packet.TMin + offset)));
+        Float tExit = SIMD::Min(SIMD::Min(SIMD::Max(tX0, tX1), SIMD::Max(tY0, tY1)),
+                                SIMD::Min(SIMD::Max(tZ0, tZ1), Float::Load(packet.TMax + offset)));
+
+        overlaps |= (tEntry <= tExit).Bits() << offset;
+    }
+
+    return overlaps;
+}
+
+// SDF programs evaluated at SIMD_WIDTH points at once, with the same distance functions as SDFFunctions.h
+
+Float Length(Float x, Float y) { return SIMD::Sqrt(x * x + y * y); }
+Float Length(Float x, Float y, Float z) { return SIMD::Sqrt(x * x + y * y + z * z); }
+
+/// Smooth maximum, one lane at a time as there are no vector exp2 and log2 instructions.
+Float SmoothMax(Float a, Float b, float k) {
+    alignas(32) float left[SIMD_WIDTH];
+    alignas(32) float right[SIMD_WIDTH];
+    a.Store(left);
+    b.Store(right);
+    for (int lane = 0; lane < SIMD_WIDTH; lane++) {
+        left[lane] = log2f(exp2f(k * left[lane]) + exp2f(k * right[lane])) / k;
+    }
+    return Float::Load(left);
+}
+
+Float SmoothMin(Float a, Float b, float k) { return -SmoothMax(-a, -b, k); }
+
+Float EvaluateSDFLanes(const SDFInstruction *program, uint32_t count, Float x, Float y, Float z) {
+    using Opcode = SDFInstruction::Opcode;
+
+    Float stack[SDF_PROGRAM_STACK_SIZE];
+    int top = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SDFInstruction &instruction = program[i];
+        const float *p = &instruction.Parameters.x;
+        Float dX = x - Float::Broadcast(instruction.Position.x);
+        Float dY = y - Float::Broadcast(instruction.Position.y);
+        Float dZ = z - Float::Broadcast(instruction.Position.z);
+
+        switch (instruction.Op) {
+        case Opcode::Sphere:
+            stack[top++] = Length(dX, dY, dZ) - Float::Broadcast(p[0]);
+            continue;
+        case Opcode::Box: {
+            Float rounded = Float::Broadcast(p[3]);
+            Float qX = SIMD::Abs(dX) - Float::Broadcast(p[0]) + rounded;
+            Float qY = SIMD::Abs(dY) - Float::Broadcast(p[1]) + rounded;
+            Float qZ = SIMD::Abs(dZ) - Float::Broadcast(p[2]) + rounded;
+            Float zero = Float::Broadcast(0.0f);
+            Float outside = Length(SIMD::Max(qX, zero), SIMD::Max(qY, zero), SIMD::Max(qZ, zero));
+            Float inside = SIMD::Min(SIMD::Max(qX, SIMD::Max(qY, qZ)), zero);
+            stack[top++] = outside + inside - rounded;
+            continue;
+        }
+        case Opcode::HollowSphere: {
+            Float radius = Float::Broadcast(p[0]), thickness = Float::Broadcast(p[1]);
+            Float height = Float::Broadcast(p[2]), w = Float::Broadcast(p[3]);
+            Float qX = Length(dX, dZ);
+            Float qY = dY;
+            Float rim = Length(qX - w, qY - height);
+            Float shell = SIMD::Abs(Length(qX, qY) - radius) - thickness;
+            stack[top++] = SIMD::Select(height * qX < w * qY, rim, shell);
+            continue;
+        }
+        case Opcode::Plane:
+            stack[top++] = dX * Float::Broadcast(p[0]) + dY * Float::Broadcast(p[1]) + dZ * Float::Broadcast(p[2]);
+            continue;
+        default:
+            break;
+        }
+
+        Float right = stack[--top];
+        Float left = stack[top - 1];
+        if (instruction.Swapped) {
+            Float swapped = left;
+            left = right;
+            right = swapped;
+        }
+
+        Float &result = stack[top - 1];
+        switch (instruction.Op) {
+        case Opcode::Union:
+            result = SIMD::Min(left, right);
+            break;
+        case Opcode::SmoothUnion:
+            result = SmoothMin(left, right, p[0]);
+            break;
+        case Opcode::Intersection:
+            result = SIMD::Max(left, right);
+            break;
+        case Opcode::SmoothIntersection:
+            result = SmoothMax(left, right, p[0]);
+            break;
+        case Opcode::Difference:
+            result = SIMD::Max(left, -right);
+            break;
+        case Opcode::SmoothDifference:
+            result = SmoothMax(left, -right, p[0]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return stack[0];
+}
+
+void EvaluateSDF(const SDFInstruction *program, uint32_t instructionCount, const glm::vec3 *points, float *distances,
+                 uint32_t pointCount) {
+    for (uint32_t first = 0; first < pointCount; first += SIMD_WIDTH) {
+        // the last group is padded with copies of the last point
+        alignas(32) float x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH], d[SIMD_WIDTH];
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            const glm::vec3 &point = points[first + lane < pointCount ? first + lane : pointCount - 1];
+            x[lane] = point.x;
+            y[lane] = point.y;
+            z[lane] = point.z;
+        }
+
+        EvaluateSDFLanes(program, instructionCount, Float::Load(x), Float::Load(y), Float::Load(z)).Store(d);
+
+        for (uint32_t lane = 0; lane < SIMD_WIDTH && first + lane < pointCount; lane++) {
+            distances[first + lane] = d[lane];
+        }
+    }
+}
+
+// sampling: the hashes of Sampler on integer lanes, so the samples match it bit for bit, and the mappings of Warp with
+// selects in place of their branches
+
+/// RTRandom::PCG_Hash of every lane.
+Int PCGHash(Int input) {
+    Int state = input * Int::Broadcast(747796405u) + Int::Broadcast(2891336453u);
+    Int word = ((state >> ((state >> 28) + Int::Broadcast(4u))) ^ state) * Int::Broadcast(277803737u);
+    return (word >> 22) ^ word;
+}
+
+Int ReverseBits(Int x) {
+    x = ((x >> 1) & Int::Broadcast(0x55555555u)) | ((x & Int::Broadcast(0x55555555u)) << 1);
+    x = ((x >> 2) & Int::Broadcast(0x33333333u)) | ((x & Int::Broadcast(0x33333333u)) << 2);
+    x = ((x >> 4) & Int::Broadcast(0x0f0f0f0fu)) | ((x & Int::Broadcast(0x0f0f0f0fu)) << 4);
+    x = ((x >> 8) & Int::Broadcast(0x00ff00ffu)) | ((x & Int::Broadcast(0x00ff00ffu)) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+Int NestedUniformScramble(Int x, Int seed) {
+    x = ReverseBits(x);
+    x = x ^ (x * Int::Broadcast(0x3d20adeau));
+    x = x + seed;
+    x = x * ((seed >> 16) | Int::Broadcast(1u));
+    x = x ^ (x * Int::Broadcast(0x05526c56u));
+    x = x ^ (x * Int::Broadcast(0x53a22864u));
+    return ReverseBits(x);
+}
+
+/// Second Sobol dimension, until every lane has run out of index bits.
+Int SobolSecond(Int index) {
+    Int result = Int::Broadcast(0u);
+    for (uint32_t direction = 0x80000000u; index.Any(); index = index >> 1, direction ^= direction >> 1) {
+        // 0 - 1 sets every bit, so the direction is added where the index bit is set
+        result = result ^ (Int::Broadcast(direction) & (Int::Broadcast(0u) - (index & Int::Broadcast(1u))));
+    }
+    return result;
+}
+
+/// Top 24 bits, in [0, 1).
+Float ToUnitFloat(Int x) { return (x >> 8).ToFloat() * Float::Broadcast(1.0f / 16777216.0f); }
+
+/// Sine and cosine of angles in [-pi/4, pi/4], from Taylor polynomials which are within float precision there.
+void SinCos(Float angle, Float &sine, Float &cosine) {
+    Float a2 = angle * angle;
+    sine = angle * (Float::Broadcast(1.0f) +
+                    a2 * (Float::Broadcast(-1.0f / 6.0f) +
+                          a2 * (Float::Broadcast(1.0f / 120.0f) +
+                                a2 * (Float::Broadcast(-1.0f / 5040.0f) + a2 * Float::Broadcast(1.0f / 362880.0f)))));
+    cosine = Float::Broadcast(1.0f) +
+             a2 * (Float::Broadcast(-0.5f) +
+                   a2 * (Float::Broadcast(1.0f / 24.0f) +
+                         a2 * (Float::Broadcast(-1.0f / 720.0f) + a2 * Float::Broadcast(1.0f / 40320.0f))));
+}
+
+void UniformDiskLanes(Float u, Float v, Float &x, Float &y) {
+    Float offsetX = u * Float::Broadcast(2.0f) - Float::Broadcast(1.0f);
+    Float offsetY = v * Float::Broadcast(2.0f) - Float::Broadcast(1.0f);
+
+    // theta is a = pi/4 * ratio in the sectors around the x axis and pi/2 - a around the y axis, which swaps its sine
+    // and cosine; the centre has radius 0 and maps to itself whatever the ratio
+    Mask aroundX = SIMD::Abs(offsetX) > SIMD::Abs(offsetY);
+    Float radius = SIMD::Select(aroundX, offsetX, offsetY);
+    Float ratio = SIMD::Select(aroundX, offsetY, offsetX) / radius;
+    ratio = SIMD::Select(radius == Float::Broadcast(0.0f), Float::Broadcast(0.0f), ratio);
+
+    Float sine, cosine;
+    SinCos(Float::Broadcast(0.785398163f) * ratio, sine, cosine);
+    x = radius * SIMD::Select(aroundX, cosine, sine);
+    y = radius * SIMD::Select(aroundX, sine, cosine);
+}
+
+void UniformSphereLanes(Float u, Float v, Float &x, Float &y, Float &z) {
+    z = Float::Broadcast(1.0f) - Float::Broadcast(2.0f) * u;
+    Float r = SIMD::Sqrt(SIMD::Max(Float::Broadcast(0.0f), Float::Broadcast(1.0f) - z * z));
+
+    // phi = 2 pi v is split into k quarter turns, k in [0, 4], and an angle in [-pi/4, pi/4)
+    Float turns = v * Float::Broadcast(4.0f);
+    Float quarters = SIMD::Truncate(turns + Float::Broadcast(0.5f));
+    Float sine, cosine;
+    SinCos((turns - quarters) * Float::Broadcast(1.57079633f), sine, cosine);
+
+    // turning by k quarters maps (cos, sin) to (cos, sin), (-sin, cos), (-cos, -sin) and (sin, -cos)
+    Mask one = quarters == Float::Broadcast(1.0f);
+    Mask two = quarters == Float::Broadcast(2.0f);
+    Mask three = quarters == Float::Broadcast(3.0f);
+    Float cosPhi = SIMD::Select(one | three, sine, cosine);
+    Float sinPhi = SIMD::Select(one | three, cosine, sine);
+    x = r * SIMD::Select(one | two, -cosPhi, cosPhi);
+    y = r * SIMD::Select(two | three, -sinPhi, sinPhi);
+}
+
+void CosineHemisphereLanes(Float u, Float v, Float normalX, Float normalY, Float normalZ, Float &x, Float &y,
+                           Float &z) {
+    Float diskX, diskY;
+    UniformDiskLanes(u, v, diskX, diskY);
+    Float height =
+        SIMD::Sqrt(SIMD::Max(Float::Broadcast(0.0f), Float::Broadcast(1.0f) - (diskX * diskX + diskY * diskY)));
+
+    // tangents as in Warp::TangentFrame
+    Float sign = SIMD::CopySign(Float::Broadcast(1.0f), normalZ);
+    Float a = Float::Broadcast(-1.0f) / (sign + normalZ);
+    Float b = normalX * normalY * a;
+    Float tangentX = Float::Broadcast(1.0f) + sign * normalX * normalX * a;
+    Float tangentY = sign * b;
+    Float tangentZ = -(sign * normalX);
+    Float bitangentX = b;
+    Float bitangentY = sign + normalY * normalY * a;
+    Float bitangentZ = -normalY;
+
+    x = tangentX * diskX + bitangentX * diskY + normalX * height;
+    y = tangentY * diskX + bitangentY * diskY + normalY * height;
+    z = tangentZ * diskX + bitangentZ * diskY + normalZ * height;
+    Float inverseLength = Float::Broadcast(1.0f) / SIMD::Sqrt(x * x + y * y + z * z);
+    x = x * inverseLength;
+    y = y * inverseLength;
+    z = z * inverseLength;
+}
+
+// the array kernels pad their last group with copies of the last element, like EvaluateSDF
+
+void Sample2D(SamplerState *samplers, glm::vec2 *samples, uint32_t count) {
+    for (uint32_t first = 0; first < count; first += SIMD_WIDTH) {
+        alignas(32) uint32_t pixelSeeds[SIMD_WIDTH], indices[SIMD_WIDTH], dimensions[SIMD_WIDTH];
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            const SamplerState &sampler = samplers[first + lane < count ? first + lane : count - 1];
+            pixelSeeds[lane] = sampler.PixelSeed;
+            indices[lane] = sampler.Index;
+            dimensions[lane] = sampler.Dimension;
+        }
+
+        Int seed = PCGHash(Int::Load(pixelSeeds) ^ (Int::Load(dimensions) * Int::Broadcast(0x9e3779b9u)));
+        Int index = NestedUniformScramble(Int::Load(indices), seed);
+        alignas(32) float u[SIMD_WIDTH], v[SIMD_WIDTH];
+        ToUnitFloat(NestedUniformScramble(ReverseBits(index), PCGHash(seed))).Store(u);
+        ToUnitFloat(NestedUniformScramble(SobolSecond(index), PCGHash(seed + Int::Broadcast(1u)))).Store(v);
+
+        for (uint32_t lane = 0; lane < SIMD_WIDTH && first + lane < count; lane++) {
+            samples[first + lane].x = u[lane];
+            samples[first + lane].y = v[lane];
+            samplers[first + lane].Dimension++;
+        }
+    }
+}
+
+void UniformDisk(const glm::vec2 *samples, glm::vec2 *points, uint32_t count) {
+    for (uint32_t first = 0; first < count; first += SIMD_WIDTH) {
+        alignas(32) float u[SIMD_WIDTH], v[SIMD_WIDTH], x[SIMD_WIDTH], y[SIMD_WIDTH];
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            const glm::vec2 &sample = samples[first + lane < count ? first + lane : count - 1];
+            u[lane] = sample.x;
+            v[lane] = sample.y;
+        }
+
+        Float diskX, diskY;
+        UniformDiskLanes(Float::Load(u), Float::Load(v), diskX, diskY);
+        diskX.Store(x);
+        diskY.Store(y);
+
+        for (uint32_t lane = 0; lane < SIMD_WIDTH && first + lane < count; lane++) {
+            points[first + lane].x = x[lane];
+            points[first + lane].y = y[lane];
+        }
+    }
+}
+
+void UniformSphere(const glm::vec2 *samples, glm::vec3 *directions, uint32_t count) {
+    for (uint32_t first = 0; first < count; first += SIMD_WIDTH) {
+        alignas(32) float u[SIMD_WIDTH], v[SIMD_WIDTH], x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH];
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            const glm::vec2 &sample = samples[first + lane < count ? first + lane : count - 1];
+            u[lane] = sample.x;
+            v[lane] = sample.y;
+        }
+
+        Float directionX, directionY, directionZ;
+        UniformSphereLanes(Float::Load(u), Float::Load(v), directionX, directionY, directionZ);
+        directionX.Store(x);
+        directionY.Store(y);
+        directionZ.Store(z);
+
+        for (uint32_t lane = 0; lane < SIMD_WIDTH && first + lane < count; lane++) {
+            directions[first + lane].x = x[lane];
+            directions[first + lane].y = y[lane];
+            directions[first + lane].z = z[lane];
+        }
+    }
+}
+
+void CosineHemisphere(const glm::vec2 *samples, const glm::vec3 *normals, glm::vec3 *directions, uint32_t count) {
+    for (uint32_t first = 0; first < count; first += SIMD_WIDTH) {
+        alignas(32) float u[SIMD_WIDTH], v[SIMD_WIDTH], x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH];
+        for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+            uint32_t i = first + lane < count ? first + lane : count - 1;
+            u[lane] = samples[i].x;
+            v[lane] = samples[i].y;
+            x[lane] = normals[i].x;
+            y[lane] = normals[i].y;
+            z[lane] = normals[i].z;
+        }
+
+        Float directionX, directionY, directionZ;
+        CosineHemisphereLanes(Float::Load(u), Float::Load(v), Float::Load(x), Float::Load(y), Float::Load(z),
+                              directionX, directionY, directionZ);
+        directionX.Store(x);
+        directionY.Store(y);
+        directionZ.Store(z);
+
+        for (uint32_t lane = 0; lane < SIMD_WIDTH && first + lane < count; lane++) {
+            directions[first + lane].x = x[lane];
+            directions[first + lane].y = y[lane];
+            directions[first + lane].z = z[lane];
+        }
+    }
+}
+
+// pixel resolve, colours are handled as flat arrays of floats so every register is filled
+
+void ResolvePixels(glm::vec4 *accumulation, const glm::vec4 *colours, uint32_t *image, uint32_t count,
+                   float frameIndex) {
+    float *accumulated = reinterpret_cast<float *>(accumulation);
+    const float *added = reinterpret_cast<const float *>(colours);
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(image);
+    uint32_t floatCount = count * 4;
+
+    Float frames = Float::Broadcast(frameIndex);
+    uint32_t i = 0;
+    for (; i + SIMD_WIDTH <= floatCount; i += SIMD_WIDTH) {
+        Float sum = Float::LoadUnaligned(accumulated + i) + Float::LoadUnaligned(added + i);
+        sum.StoreUnaligned(accumulated + i);
+
+        Float average = SIMD::Min(SIMD::Max(sum / frames, Float::Broadcast(0.0f)), Float::Broadcast(1.0f));
+        (average * Float::Broadcast(255.0f)).StoreBytes(bytes + i);
+    }
+
+    for (; i < floatCount; i++) {
+        accumulated[i] += added[i];
+        float average = accumulated[i] / frameIndex;
+        average = average < 0.0f ? 0.0f : (average > 1.0f ? 1.0f : average);
+        bytes[i] = (uint8_t)(average * 255.0f);
+    }
+}
+
+/// Luminance of a linear RGB colour, same Rec. 709 weights as SIMD::Luminance.
+float Luminance(const float *colour) { return colour[0] * 0.2126f + colour[1] * 0.7152f + colour[2] * 0.0722f; }
+
+void ResolvePixelsAdaptive(glm::vec4 *accumulation, float *luminanceSquares, const glm::vec4 *colours, uint32_t *image,
+                           uint32_t count) {
+    // each pixel has its own divisor, so the four channels of one pixel are handled together
+    float *accumulated = reinterpret_cast<float *>(accumulation);
+    const float *added = reinterpret_cast<const float *>(colours);
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(image);
+    for (uint32_t i = 0; i < count; i++) {
+        float *sum = accumulated + i * 4;
+        const float *colour = added + i * 4;
+        for (int channel = 0; channel < 4; channel++) {
+            sum[channel] += colour[channel];
+        }
+        float luminance = Luminance(colour);
+        luminanceSquares[i] += luminance * luminance;
+
+        // the alpha channel counts the samples
+        float frames = sum[3];
+        for (int channel = 0; channel < 4; channel++) {
+            float average = frames > 0.0f ? sum[channel] / frames : 0.0f;
+            average = average < 0.0f ? 0.0f : (average > 1.0f ? 1.0f : average);
+            bytes[i * 4 + channel] = (uint8_t)(average * 255.0f);
+        }
+    }
+}
+} // namespace
+
+/// Kernel table of the translation unit including this file.
+#define SIMD_KERNEL_TABLE(target, name)                                                                                \
+    SIMD::KernelTable {                                                                                                \
+        target, name, IntersectBlocks<SphereBlock, IntersectSphereLanes>, IntersectBlocks<BoxBlock, IntersectBoxLanes>, \
+            OccludedBlocks<SphereBlock, IntersectSphereLanes>, OccludedBlocks<BoxBlock, IntersectBoxLanes>,            \
+            IntersectPacket<SpherePrimitive, IntersectSpherePacketLanes>,                                              \
+            IntersectPacket<BoxPrimitive, IntersectBoxPacketLanes>,                                                    \
+            IntersectPacket<PlanePrimitive, IntersectPlanePacketLanes>, OverlapBoundsPacket, EvaluateSDF,              \
+            ResolvePixels, ResolvePixelsAdaptive, Sample2D, UniformDisk, UniformSphere, CosineHemisphere               \
+    }
@@ -0,0 +1,11 @@
+// Built with AVX2 and FMA enabled, see CMakeLists.txt. Only called on CPUs that support them.
+#include "KernelsImpl.h"
+
+const SIMD::KernelTable *SIMD::Detail::GetAVX2Kernels() {
+#if defined(__AVX2__) && defined(__FMA__)
+    static const KernelTable table = SIMD_KERNEL_TABLE(ISA::AVX2, "AVX2");
+    return &table;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,12 @@
+// Built with AVX-512 (F, VL, DQ, BW) enabled, see CMakeLists.txt. Only called on CPUs that support it. Blocks and
+// packets are 8 wide, so the kernels use 256-bit registers and gain the extra registers and masked instructions.
+#include "KernelsImpl.h"
+
+const SIMD::KernelTable *SIMD::Detail::GetAVX512Kernels() {
+#if defined(__AVX512F__) && defined(__AVX512VL__)
+    static const KernelTable table = SIMD_KERNEL_TABLE(ISA::AVX512, "AVX-512");
+    return &table;
+#else
+    return nullptr;
+#endif
+}
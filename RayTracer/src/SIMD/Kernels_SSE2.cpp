@@ -0,0 +1,11 @@
+// Baseline x86-64 kernels, built with the default compiler flags.
+#include "KernelsImpl.h"
+
+const SIMD::KernelTable *SIMD::Detail::GetSSE2Kernels() {
+#if defined(SIMD_SSE)
+    static const KernelTable table = SIMD_KERNEL_TABLE(ISA::SSE2, "SSE2");
+    return &table;
+#else
+    return nullptr;
+#endif
+}
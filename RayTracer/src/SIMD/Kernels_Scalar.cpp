@@ -0,0 +1,5 @@
+// Plain C++ kernels, used on CPUs without SSE2 or when asked for with RAYTRACER_ISA=scalar.
+#define SIMD_FORCE_SCALAR
+#include "KernelsImpl.h"
+
+const SIMD::KernelTable SIMD::Detail::ScalarKernels = SIMD_KERNEL_TABLE(SIMD::ISA::Scalar, "scalar");
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cstdint>
+
+// Thin wrapper over the widest vector registers the translation unit is compiled for: 8 floats with AVX, 4 with SSE2
+// and 1 (plain floats) otherwise, or when SIMD_FORCE_SCALAR is defined. Kernels are written once against Float, Int
+// and Mask and process SIMD_WIDTH lanes at a time.
+//
+// Only the kernel translation units include this, each compiled for a different instruction set. Everything is in an
+// inline namespace named after that instruction set, so the copies built for different targets never get merged by the
+// linker.
+#if defined(SIMD_FORCE_SCALAR)
+#define SIMD_WIDTH 1
+#define SIMD_ISA Scalar
+#elif defined(__AVX__)
+#define SIMD_AVX
+#define SIMD_WIDTH 8
+#if defined(__AVX512F__)
+#define SIMD_ISA AVX512
+#elif defined(__AVX2__)
+#define SIMD_ISA AVX2
+#else
+#define SIMD_ISA AVX
+#endif
+#if defined(__AVX2__)
+#define SIMD_AVX2
+#endif
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE
+#define SIMD_WIDTH 4
+#define SIMD_ISA SSE2
+#include <emmintrin.h>
+#else
+#define SIMD_WIDTH 1
+#define SIMD_ISA Scalar
+#endif
+
+#if SIMD_WIDTH == 1
+#include <math.h>
+#endif
+
+namespace SIMD {
+inline namespace SIMD_ISA {
+#if defined(SIMD_AVX)
+using Register = __m256;
+using IntRegister = __m256i;
+#elif defined(SIMD_SSE)
+using Register = __m128;
+using IntRegister = __m128i;
+#else
+using Register = float;
+using IntRegister = uint32_t;
+#endif
+
+/// Result of a lane-wise comparison.
+struct Mask {
+    Register V;
+
+#if defined(SIMD_AVX)
+    Mask operator&(Mask other) const { return {_mm256_and_ps(V, other.V)}; }
+    Mask operator|(Mask other) const { return {_mm256_or_ps(V, other.V)}; }
+    /// Bit i is set if lane i is set.
+    uint32_t Bits() const { return (uint32_t)_mm256_movemask_ps(V); }
+#elif defined(SIMD_SSE)
+    Mask operator&(Mask other) const { return {_mm_and_ps(V, other.V)}; }
+    Mask operator|(Mask other) const { return {_mm_or_ps(V, other.V)}; }
+    uint32_t Bits() const { return (uint32_t)_mm_movemask_ps(V); }
+#else
+    Mask operator&(Mask other) const { return {(float)(V != 0.0f && other.V != 0.0f)}; }
+    Mask operator|(Mask other) const { return {(float)(V != 0.0f || other.V != 0.0f)}; }
+    uint32_t Bits() const { return V != 0.0f ? 1u : 0u; }
+#endif
+
+    bool Any() const { return Bits() != 0; }
+};
+
+/// SIMD_WIDTH floats.
+struct Float {
+    Register V;
+
+#if defined(SIMD_AVX)
+    static Float Broadcast(float value) { return {_mm256_set1_ps(value)}; }
+    /// Loads from an address aligned to the register size.
+    static Float Load(const float *values) { return {_mm256_load_ps(values)}; }
+    static Float LoadUnaligned(const float *values) { return {_mm256_loadu_ps(values)}; }
+    void Store(float *values) const { _mm256_store_ps(values, V); }
+    void StoreUnaligned(float *values) const { _mm256_storeu_ps(values, V); }
+
+    /// Truncates every lane, which must be in [0, 255], to a byte.
+    void StoreBytes(uint8_t *bytes) const {
+        __m256i integers = _mm256_cvttps_epi32(V);
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(integers), _mm256_extractf128_si256(integers, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(bytes), _mm_packus_epi16(words, words));
+    }
+
+    Float operator+(Float other) const { return {_mm256_add_ps(V, other.V)}; }
+    Float operator-(Float other) const { return {_mm256_sub_ps(V, other.V)}; }
+    Float operator*(Float other) const { return {_mm256_mul_ps(V, other.V)}; }
+    Float operator/(Float other) const { return {_mm256_div_ps(V, other.V)}; }
+    Float operator-() const { return {_mm256_xor_ps(V, _mm256_set1_ps(-0.0f))}; }
+
+    Mask operator<(Float other) const { return {_mm256_cmp_ps(V, other.V, _CMP_LT_OQ)}; }
+    Mask operator<=(Float other) const { return {_mm256_cmp_ps(V, other.V, _CMP_LE_OQ)}; }
+    Mask operator>(Float other) const { return {_mm256_cmp_ps(V, other.V, _CMP_GT_OQ)}; }
+    Mask operator>=(Float other) const { return {_mm256_cmp_ps(V, other.V, _CMP_GE_OQ)}; }
+    Mask operator==(Float other) const { return {_mm256_cmp_ps(V, other.V, _CMP_EQ_OQ)}; }
+    Mask operator!=(Float other) const { return {_mm256_cmp_ps(V, other.V, _CMP_NEQ_UQ)}; }
+#elif defined(SIMD_SSE)
+    static Float Broadcast(float value) { return {_mm_set1_ps(value)}; }
+    static Float Load(const float *values) { return {_mm_load_ps(values)}; }
+    static Float LoadUnaligned(const float *values) { return {_mm_loadu_ps(values)}; }
+    void Store(float *values) const { _mm_store_ps(values, V); }
+    void StoreUnaligned(float *values) const { _mm_storeu_ps(values, V); }
+
+    void StoreBytes(uint8_t *bytes) const {
+        __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(V), _mm_setzero_si128());
+        int packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        for (int i = 0; i < 4; i++) {
+            bytes[i] = (uint8_t)(packed >> (8 * i));
+        }
+    }
+
+    Float operator+(Float other) const { return {_mm_add_ps(V, other.V)}; }
+    Float operator-(Float other) const { return {_mm_sub_ps(V, other.V)}; }
+    Float operator*(Float other) const { return {_mm_mul_ps(V, other.V)}; }
+    Float operator/(Float other) const { return {_mm_div_ps(V, other.V)}; }
+    Float operator-() const { return {_mm_xor_ps(V, _mm_set1_ps(-0.0f))}; }
+
+    Mask operator<(Float other) const { return {_mm_cmplt_ps(V, other.V)}; }
+    Mask operator<=(Float other) const { return {_mm_cmple_ps(V, other.V)}; }
+    Mask operator>(Float other) const { return {_mm_cmpgt_ps(V, other.V)}; }
+    Mask operator>=(Float other) const { return {_mm_cmpge_ps(V, other.V)}; }
+    Mask operator==(Float other) const { return {_mm_cmpeq_ps(V, other.V)}; }
+    Mask operator!=(Float other) const { return {_mm_cmpneq_ps(V, other.V)}; }
+#else
+    static Float Broadcast(float value) { return {value}; }
+    static Float Load(const float *values) { return {*values}; }
+    static Float LoadUnaligned(const float *values) { return {*values}; }
+    void Store(float *values) const { *values = V; }
+    void StoreUnaligned(float *values) const { *values = V; }
+    void StoreBytes(uint8_t *bytes) const { *bytes = (uint8_t)V; }
+
+    Float operator+(Float other) const { return {V + other.V}; }
+    Float operator-(Float other) const { return {V - other.V}; }
+    Float operator*(Float other) const { return {V * other.V}; }
+    Float operator/(Float other) const { return {V / other.V}; }
+    Float operator-() const { return {-V}; }
+
+    Mask operator<(Float other) const { return {(float)(V < other.V)}; }
+    Mask operator<=(Float other) const { return {(float)(V <= other.V)}; }
+    Mask operator>(Float other) const { return {(float)(V > other.V)}; }
+    Mask operator>=(Float other) const { return {(float)(V >= other.V)}; }
+    Mask operator==(Float other) const { return {(float)(V == other.V)}; }
+    Mask operator!=(Float other) const { return {(float)(V != other.V)}; }
+#endif
+};
+
+/// SIMD_WIDTH unsigned 32-bit integers, wrapping around like uint32_t.
+struct Int {
+    IntRegister V;
+
+#if defined(SIMD_AVX2)
+    static Int Broadcast(uint32_t value) { return {_mm256_set1_epi32((int)value)}; }
+    /// Loads from an address aligned to the register size.
+    static Int Load(const uint32_t *values) { return {_mm256_load_si256(reinterpret_cast<const __m256i *>(values))}; }
+    void Store(uint32_t *values) const { _mm256_store_si256(reinterpret_cast<__m256i *>(values), V); }
+
+    Int operator+(Int other) const { return {_mm256_add_epi32(V, other.V)}; }
+    Int operator-(Int other) const { return {_mm256_sub_epi32(V, other.V)}; }
+    Int operator*(Int other) const { return {_mm256_mullo_epi32(V, other.V)}; }
+    Int operator&(Int other) const { return {_mm256_and_si256(V, other.V)}; }
+    Int operator|(Int other) const { return {_mm256_or_si256(V, other.V)}; }
+    Int operator^(Int other) const { return {_mm256_xor_si256(V, other.V)}; }
+    Int operator<<(int count) const { return {_mm256_slli_epi32(V, count)}; }
+    Int operator>>(int count) const { return {_mm256_srli_epi32(V, count)}; }
+    /// Each lane shifted right by the count in the same lane, counts must be below 32.
+    Int operator>>(Int counts) const { return {_mm256_srlv_epi32(V, counts.V)}; }
+
+    /// Lanes must be below 2^31.
+    Float ToFloat() const { return {_mm256_cvtepi32_ps(V)}; }
+    /// True if any lane isn't 0.
+    bool Any() const { return !_mm256_testz_si256(V, V); }
+#elif defined(SIMD_AVX)
+    // without AVX2 the lanes are loaded and stored as a register but operated on one at a time
+    static Int Broadcast(uint32_t value) { return {_mm256_set1_epi32((int)value)}; }
+    static Int Load(const uint32_t *values) { return {_mm256_load_si256(reinterpret_cast<const __m256i *>(values))}; }
+    void Store(uint32_t *values) const { _mm256_store_si256(reinterpret_cast<__m256i *>(values), V); }
+
+    Int operator+(Int other) const { return Lanes(other, [](uint32_t a, uint32_t b) { return a + b; }); }
+    Int operator-(Int other) const { return Lanes(other, [](uint32_t a, uint32_t b) { return a - b; }); }
+    Int operator*(Int other) const { return Lanes(other, [](uint32_t a, uint32_t b) { return a * b; }); }
+    Int operator&(Int other) const { return {_mm256_castps_si256(_mm256_and_ps(AsFloats(), other.AsFloats()))}; }
+    Int operator|(Int other) const { return {_mm256_castps_si256(_mm256_or_ps(AsFloats(), other.AsFloats()))}; }
+    Int operator^(Int other) const { return {_mm256_castps_si256(_mm256_xor_ps(AsFloats(), other.AsFloats()))}; }
+    Int operator<<(int count) const {
+        return Lanes(Broadcast((uint32_t)count), [](uint32_t a, uint32_t b) { return a << b; });
+    }
+    Int operator>>(int count) const { return *this >> Broadcast((uint32_t)count); }
+    Int operator>>(Int counts) const { return Lanes(counts, [](uint32_t a, uint32_t b) { return a >> b; }); }
+
+    Float ToFloat() const { return {_mm256_cvtepi32_ps(V)}; }
+    bool Any() const { return !_mm256_testz_si256(V, V); }
+
+  private:
+    __m256 AsFloats() const { return _mm256_castsi256_ps(V); }
+
+    template <typename Operation> Int Lanes(Int other, Operation operation) const {
+        alignas(32) uint32_t a[8], b[8];
+        Store(a);
+        other.Store(b);
+        for (int i = 0; i < 8; i++) {
+            a[i] = operation(a[i], b[i]);
+        }
+        return Load(a);
+    }
+#elif defined(SIMD_SSE)
+    static Int Broadcast(uint32_t value) { return {_mm_set1_epi32((int)value)}; }
+    static Int Load(const uint32_t *values) { return {_mm_load_si128(reinterpret_cast<const __m128i *>(values))}; }
+    void Store(uint32_t *values) const { _mm_store_si128(reinterpret_cast<__m128i *>(values), V); }
+
+    Int operator+(Int other) const { return {_mm_add_epi32(V, other.V)}; }
+    Int operator-(Int other) const { return {_mm_sub_epi32(V, other.V)}; }
+    Int operator&(Int other) const { return {_mm_and_si128(V, other.V)}; }
+    Int operator|(Int other) const { return {_mm_or_si128(V, other.V)}; }
+    Int operator^(Int other) const { return {_mm_xor_si128(V, other.V)}; }
+    Int operator<<(int count) const { return {_mm_slli_epi32(V, count)}; }
+    Int operator>>(int count) const { return {_mm_srli_epi32(V, count)}; }
+
+    /// SSE2 only multiplies the even lanes into 64 bits, so the odd lanes are shifted down and multiplied separately.
+    Int operator*(Int other) const {
+        __m128i even = _mm_mul_epu32(V, other.V);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(V, 32), _mm_srli_epi64(other.V, 32));
+        return {_mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                   _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)))};
+    }
+
+    /// SSE2 only shifts every lane by the same count, so the lanes are shifted one at a time.
+    Int operator>>(Int counts) const {
+        alignas(16) uint32_t values[4], shifts[4];
+        Store(values);
+        counts.Store(shifts);
+        for (int i = 0; i < 4; i++) {
+            values[i] >>= shifts[i];
+        }
+        return Load(values);
+    }
+
+    Float ToFloat() const { return {_mm_cvtepi32_ps(V)}; }
+    bool Any() const { return _mm_movemask_epi8(_mm_cmpeq_epi32(V, _mm_setzero_si128())) != 0xffff; }
+#else
+    static Int Broadcast(uint32_t value) { return {value}; }
+    static Int Load(const uint32_t *values) { return {*values}; }
+    void Store(uint32_t *values) const { *values = V; }
+
+    Int operator+(Int other) const { return {V + other.V}; }
+    Int operator-(Int other) const { return {V - other.V}; }
+    Int operator*(Int other) const { return {V * other.V}; }
+    Int operator&(Int other) const { return {V & other.V}; }
+    Int operator|(Int other) const { return {V | other.V}; }
+    Int operator^(Int other) const { return {V ^ other.V}; }
+    Int operator<<(int count) const { return {V << count}; }
+    Int operator>>(int count) const { return {V >> count}; }
+    Int operator>>(Int counts) const { return {V >> counts.V}; }
+
+    Float ToFloat() const { return {(float)V}; }
+    bool Any() const { return V != 0; }
+#endif
+};
+
+#if defined(SIMD_AVX)
+inline Float Min(Float a, Float b) { return {_mm256_min_ps(a.V, b.V)}; }
+inline Float Max(Float a, Float b) { return {_mm256_max_ps(a.V, b.V)}; }
+inline Float Sqrt(Float a) { return {_mm256_sqrt_ps(a.V)}; }
+/// Lane-wise mask ? a : b.
+inline Float Select(Mask mask, Float a, Float b) { return {_mm256_blendv_ps(b.V, a.V, mask.V)}; }
+/// Rounded towards zero, lanes must fit in an int32_t.
+inline Float Truncate(Float a) { return {_mm256_round_ps(a.V, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)}; }
+/// Magnitude of the first with the sign bit of the second.
+inline Float CopySign(Float magnitude, Float sign) {
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+    return {_mm256_or_ps(_mm256_andnot_ps(signBit, magnitude.V), _mm256_and_ps(signBit, sign.V))};
+}
+
+inline float HorizontalMin(Float a) {
+    __m128 m = _mm_min_ps(_mm256_castps256_ps128(a.V), _mm256_extractf128_ps(a.V, 1));
+    m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+#elif defined(SIMD_SSE)
+inline Float Min(Float a, Float b) { return {_mm_min_ps(a.V, b.V)}; }
+inline Float Max(Float a, Float b) { return {_mm_max_ps(a.V, b.V)}; }
+inline Float Sqrt(Float a) { return {_mm_sqrt_ps(a.V)}; }
+inline Float Select(Mask mask, Float a, Float b) { return {_mm_or_ps(_mm_and_ps(mask.V, a.V), _mm_andnot_ps(mask.V, b.V))}; }
+inline Float Truncate(Float a) { return {_mm_cvtepi32_ps(_mm_cvttps_epi32(a.V))}; }
+inline Float CopySign(Float magnitude, Float sign) {
+    __m128 signBit = _mm_set1_ps(-0.0f);
+    return {_mm_or_ps(_mm_andnot_ps(signBit, magnitude.V), _mm_and_ps(signBit, sign.V))};
+}
+
+inline float HorizontalMin(Float a) {
+    __m128 m = _mm_min_ps(a.V, _mm_movehl_ps(a.V, a.V));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+#else
+// same operand order as the SSE instructions: the second operand is returned when either is NaN
+inline Float Min(Float a, Float b) { return {a.V < b.V ? a.V : b.V}; }
+inline Float Max(Float a, Float b) { return {a.V > b.V ? a.V : b.V}; }
+inline Float Sqrt(Float a) { return {sqrtf(a.V)}; }
+inline Float Select(Mask mask, Float a, Float b) { return {mask.V != 0.0f ? a.V : b.V}; }
+inline Float Truncate(Float a) { return {truncf(a.V)}; }
+inline Float CopySign(Float magnitude, Float sign) { return {copysignf(magnitude.V, sign.V)}; }
+
+inline float HorizontalMin(Float a) { return a.V; }
+#endif
+
+inline Float Abs(Float a) { return Max(a, -a); }
+} // namespace SIMD_ISA
+} // namespace SIMD
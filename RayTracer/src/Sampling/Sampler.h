@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../RTRandom.h"
+#include "SamplerState.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/// Low-discrepancy samples for a pixel, indexed by the pixel, the sample index (one per frame) and the dimension.
+/// Every dimension draws from its own 2D Sobol sequence, Owen-scrambled and shuffled with a hash of the pixel and the
+/// dimension (Burley 2020, "Practical Hash-based Owen Scrambling"). The samples of a pixel stay stratified however many
+/// frames are accumulated, neighbouring pixels and dimensions are decorrelated, and the same inputs always give the same
+/// samples, so images are reproducible.
+///
+/// The sampler is a cursor over the dimensions of one sample: every Get call moves to the next dimension, so the
+/// integrators must draw in the same order for a path to see the same numbers.
+class Sampler {
+  public:
+    Sampler() = default;
+    /**
+     * @param pixel Identifies the pixel, e.g. its index in the image.
+     * @param sampleIndex Index of the sample in the pixel's sequence, consecutive indices are best stratified.
+     */
+    Sampler(uint32_t pixel, uint32_t sampleIndex) : m_State{RTRandom::PCG_Hash(pixel), sampleIndex, 0} {}
+
+    /// Next dimension, in [0, 1).
+    float Get1D() {
+        uint32_t seed = DimensionSeed(m_State.Dimension++);
+        uint32_t index = NestedUniformScramble(m_State.Index, seed);
+        return ToFloat(NestedUniformScramble(ReverseBits(index), RTRandom::PCG_Hash(seed)));
+    }
+
+    /// Next two dimensions, stratified together, in [0, 1)^2.
+    glm::vec2 Get2D() {
+        uint32_t seed = DimensionSeed(m_State.Dimension++);
+        uint32_t index = NestedUniformScramble(m_State.Index, seed);
+        return glm::vec2(ToFloat(NestedUniformScramble(ReverseBits(index), RTRandom::PCG_Hash(seed))),
+                         ToFloat(NestedUniformScramble(SobolSecond(index), RTRandom::PCG_Hash(seed + 1))));
+    }
+
+    uint32_t GetDimension() const { return m_State.Dimension; }
+    /// State for the batched kernels, which advance it like the Get calls do.
+    SamplerState &GetState() { return m_State; }
+
+  private:
+    uint32_t DimensionSeed(uint32_t dimension) const {
+        return RTRandom::PCG_Hash(m_State.PixelSeed ^ (dimension * 0x9e3779b9u));
+    }
+
+    /// Second dimension of the Sobol sequence, direction numbers from the polynomial x + 1.
+    static uint32_t SobolSecond(uint32_t index) {
+        uint32_t result = 0;
+        for (uint32_t direction = 0x80000000u; index != 0; index >>= 1, direction ^= direction >> 1) {
+            if (index & 1) {
+                result ^= direction;
+            }
+        }
+        return result;
+    }
+
+    static uint32_t ReverseBits(uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    /// Owen scrambling of the bits from the most significant down, as a hash that only lets each bit depend on the bits
+    /// above it (Laine-Karras permutation, with the constants improved by Vegdahl).
+    static uint32_t NestedUniformScramble(uint32_t x, uint32_t seed) {
+        x = ReverseBits(x);
+        x ^= x * 0x3d20adeau;
+        x += seed;
+        x *= (seed >> 16) | 1;
+        x ^= x * 0x05526c56u;
+        x ^= x * 0x53a22864u;
+        return ReverseBits(x);
+    }
+
+    /// Top 24 bits, so the result is below 1.
+    static float ToFloat(uint32_t x) { return (float)(x >> 8) * (1.0f / 16777216.0f); }
+
+  private:
+    SamplerState m_State;
+};
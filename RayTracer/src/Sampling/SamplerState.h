@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+/// Where a sampler is in its sequence. Plain data, so the batched kernels can draw the next samples of many samplers at
+/// once (see SIMD::KernelTable::Sample2D). Kept apart from Sampler so the kernel units don't include RTRandom, whose
+/// static functions are compiled into every unit that includes them.
+struct SamplerState {
+    uint32_t PixelSeed = 0;
+    uint32_t Index = 0;
+    uint32_t Dimension = 0;
+};
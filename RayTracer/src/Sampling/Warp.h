@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+/// Closed-form mappings from uniform samples in [0, 1)^2 to directions and points, so stratified samples stay
+/// stratified and nothing loops on rejection.
+namespace Warp {
+/// Unit disk, concentric mapping (Shirley and Chiu 1997), which keeps the strata compact.
+inline glm::vec2 UniformDisk(const glm::vec2 &u) {
+    glm::vec2 offset = 2.0f * u - 1.0f;
+    if (offset.x == 0.0f && offset.y == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    float radius, theta;
+    if (std::abs(offset.x) > std::abs(offset.y)) {
+        radius = offset.x;
+        theta = glm::quarter_pi<float>() * (offset.y / offset.x);
+    } else {
+        radius = offset.y;
+        theta = glm::half_pi<float>() - glm::quarter_pi<float>() * (offset.x / offset.y);
+    }
+    return radius * glm::vec2(std::cos(theta), std::sin(theta));
+}
+
+/// Unit sphere, uniform by area.
+inline glm::vec3 UniformSphere(const glm::vec2 &u) {
+    float z = 1.0f - 2.0f * u.x;
+    float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    float phi = glm::two_pi<float>() * u.y;
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/// Orthonormal tangents of a unit normal, without a branch on its direction (Duff et al. 2017).
+inline void TangentFrame(const glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent) {
+    float sign = std::copysign(1.0f, normal.z);
+    float a = -1.0f / (sign + normal.z);
+    float b = normal.x * normal.y * a;
+    tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+
+/// Hemisphere around the normal with density cos / pi, a disk sample lifted onto the hemisphere (Malley's method).
+inline glm::vec3 CosineHemisphere(const glm::vec2 &u, const glm::vec3 &normal) {
+    glm::vec2 disk = UniformDisk(u);
+    float z = std::sqrt(std::max(0.0f, 1.0f - glm::dot(disk, disk)));
+    glm::vec3 tangent, bitangent;
+    TangentFrame(normal, tangent, bitangent);
+    return glm::normalize(tangent * disk.x + bitangent * disk.y + normal * z);
+}
+} // namespace Warp
@@ -13,29 +13,43 @@
 #include "toml++/toml.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <iostream>
 #include <string>
 
+// relative tolerance when checking whether a transform is a uniform scale or axis aligned
+#define FLATTEN_EPSILON 1e-5f
+
+// state of one scene load that the geometry being parsed can refer to
+struct ParseContext {
+    // prototypes parsed so far, referenced by instance geometry
+    std::unordered_map<std::string, std::shared_ptr<const Geometry>> Prototypes;
+};
+
 // prototypes
 glm::vec3 ParseVec3(const toml::array *array);
 
 Material ParseMaterial(const toml::table *table);
 std::optional<Light> ParseLight(const toml::table *table);
 
-std::unique_ptr<Geometry> ParseGeometry(const toml::table *table);
+std::unique_ptr<Geometry> ParseGeometry(const toml::table *table, const ParseContext &context);
 std::unique_ptr<SDFGeometry> ParseSDFGeometry(const toml::table *table);
 
 std::unique_ptr<Sphere> ParseSphere(const toml::table *table);
 std::unique_ptr<Plane> ParsePlane(const toml::table *table);
 std::unique_ptr<AABB> ParseAABB(const toml::table *table);
-std::unique_ptr<Transform> ParseTransform(const toml::table *table);
+std::unique_ptr<Transform> ParseTransform(const toml::table *table, const ParseContext &context);
+std::unique_ptr<Transform> ParseInstance(const toml::table *table, const ParseContext &context);
 std::unique_ptr<SDFSphere> ParseSDFSphere(const toml::table *table);
 std::unique_ptr<SDFPlane> ParseSDFPlane(const toml::table *table);
 std::unique_ptr<SDFAABB> ParseSDFAABB(const toml::table *table);
 std::unique_ptr<SDFHollowSphere> ParseSDFHollowSphere(const toml::table *table);
 std::unique_ptr<SDFConstructive> ParseSDFConstructive(const toml::table *table);
 
+void FlattenGeometry(std::vector<std::unique_ptr<Geometry>> &geometry);
+std::unique_ptr<Geometry> BakeTransform(const Geometry &geometry, const glm::mat4 &transform);
+
 // implementations
 glm::vec3 ParseVec3(const toml::array *array) {
     glm::vec3 vec{0.0f};
@@ -82,6 +96,9 @@ std::optional<Light> ParseLight(const toml::table *table) {
         if (direction && intensity) {
             light.Direction = glm::normalize(ParseVec3(direction));
             light.Intensity = (float)intensity->get();
+            if (auto colour = table->get_as<toml::array>("colour")) {
+                light.Colour = ParseVec3(colour);
+            }
 
             return light;
         }
@@ -95,6 +112,9 @@ std::optional<Light> ParseLight(const toml::table *table) {
         if (position && intensity) {
             light.Position = ParseVec3(position);
             light.Intensity = (float)intensity->get();
+            if (auto colour = table->get_as<toml::array>("colour")) {
+                light.Colour = ParseVec3(colour);
+            }
 
             return light;
         }
@@ -105,7 +125,7 @@ std::optional<Light> ParseLight(const toml::table *table) {
     return std::nullopt;
 }
 
-std::unique_ptr<Geometry> ParseGeometry(const toml::table *table) {
+std::unique_ptr<Geometry> ParseGeometry(const toml::table *table, const ParseContext &context) {
     std::string type = table->get_as<std::string>("type")->value_or("");
     std::transform(type.begin(), type.end(), type.begin(), ::tolower);
 
@@ -116,7 +136,9 @@ std::unique_ptr<Geometry> ParseGeometry(const toml::table *table) {
     } else if (type == "aabb") {
         return ParseAABB(table);
     } else if (type == "transform") {
-        return ParseTransform(table);
+        return ParseTransform(table, context);
+    } else if (type == "instance") {
+        return ParseInstance(table, context);
     } else if (type == "sdfsphere" || type == "sdfhollowsphere" || type == "sdfplane" || type == "sdfconstructive" ||
                type == "sdfaabb") {
         return ParseSDFGeometry(table);
@@ -192,7 +214,7 @@ std::unique_ptr<AABB> ParseAABB(const toml::table *table) {
     return nullptr;
 }
 
-std::unique_ptr<Transform> ParseTransform(const toml::table *table) {
+std::unique_ptr<Transform> ParseTransform(const toml::table *table, const ParseContext &context) {
     auto translation = table->get_as<toml::array>("translation");
     glm::vec3 translationValid = translation ? ParseVec3(translation) : glm::vec3{0.0f};
     auto rotation = table->get_as<toml::array>("rotation");
@@ -202,7 +224,7 @@ std::unique_ptr<Transform> ParseTransform(const toml::table *table) {
     auto child = table->get_as<toml::table>("child");
 
     if (child) {
-        auto childParsed = ParseGeometry(child);
+        auto childParsed = ParseGeometry(child, context);
         if (childParsed) {
             return std::make_unique<Transform>(translationValid, rotationValid, scaleValid, std::move(childParsed));
         }
@@ -212,6 +234,28 @@ std::unique_ptr<Transform> ParseTransform(const toml::table *table) {
     return nullptr;
 }
 
+std::unique_ptr<Transform> ParseInstance(const toml::table *table, const ParseContext &context) {
+    auto translation = table->get_as<toml::array>("translation");
+    glm::vec3 translationValid = translation ? ParseVec3(translation) : glm::vec3{0.0f};
+    auto rotation = table->get_as<toml::array>("rotation");
+    glm::vec3 rotationValid = rotation ? ParseVec3(rotation) : glm::vec3{0.0f};
+    auto scale = table->get_as<toml::array>("scale");
+    glm::vec3 scaleValid = scale ? ParseVec3(scale) : glm::vec3{1.0f};
+    auto prototype = table->get_as<std::string>("prototype");
+
+    if (prototype) {
+        auto it = context.Prototypes.find(prototype->get());
+        if (it != context.Prototypes.end()) {
+            return std::make_unique<Transform>(translationValid, rotationValid, scaleValid, it->second);
+        }
+        std::cerr << "Unknown prototype: " << prototype->get() << ". skipping..." << std::endl;
+        return nullptr;
+    }
+
+    std::cerr << "Invalid instance geometry. skipping..." << std::endl;
+    return nullptr;
+}
+
 std::unique_ptr<SDFSphere> ParseSDFSphere(const toml::table *table) {
     auto position = table->get_as<toml::array>("position");
     auto radius = table->get_as<toml::value<double>>("radius");
@@ -309,14 +353,150 @@ std::unique_ptr<SDFConstructive> ParseSDFConstructive(const toml::table *table)
     return nullptr;
 }
 
+/// Collapses chains of nested transforms into one matrix, and removes the transform altogether when the primitive below
+/// can absorb it.
+void FlattenGeometry(std::vector<std::unique_ptr<Geometry>> &geometry) {
+    uint32_t baked = 0;
+    uint32_t collapsed = 0;
+
+    for (auto &g : geometry) {
+        auto transform = dynamic_cast<const Transform *>(g.get());
+        if (!transform) {
+            continue;
+        }
+
+        glm::mat4 matrix = transform->GetTransform();
+        std::shared_ptr<const Geometry> child = transform->GetChild();
+        bool nested = false;
+        while (auto inner = dynamic_cast<const Transform *>(child.get())) {
+            matrix = matrix * inner->GetTransform();
+            std::shared_ptr<const Geometry> next = inner->GetChild();
+            child = std::move(next);
+            nested = true;
+        }
+
+        if (auto bakedGeometry = BakeTransform(*child, matrix)) {
+            g = std::move(bakedGeometry);
+            baked++;
+        } else if (nested) {
+            g = std::make_unique<Transform>(matrix, std::move(child));
+            collapsed++;
+        }
+    }
+
+    if (baked > 0 || collapsed > 0) {
+        std::cout << "Flattened transforms: " << baked << " baked into primitives, " << collapsed << " chains collapsed"
+                  << std::endl;
+    }
+}
+
+/**
+ * Applies the transform to the primitive's parameters when the result is still the same kind of primitive: spheres
+ * under translation, rotation and uniform scale, boxes under translation and per-axis scale, and planes without a
+ * checkerboard under translation, rotation and uniform scale.
+ * @return The transformed primitive, or nullptr if the transform has to stay.
+ */
+std::unique_ptr<Geometry> BakeTransform(const Geometry &geometry, const glm::mat4 &transform) {
+    glm::mat3 linear = glm::mat3(transform);
+    auto apply = [&](const glm::vec3 &point) { return glm::vec3(transform * glm::vec4(point, 1.0f)); };
+
+    // columns of the linear part are orthogonal and of equal length for rotation with uniform scale
+    float scale = glm::length(linear[0]);
+    float tolerance = FLATTEN_EPSILON * scale;
+    bool uniform = true;
+    bool axisAligned = true;
+    for (int i = 0; i < 3; i++) {
+        uniform &= glm::abs(glm::length(linear[i]) - scale) <= tolerance;
+        uniform &= glm::abs(glm::dot(linear[i], linear[(i + 1) % 3])) <= tolerance * scale;
+        for (int j = 0; j < 3; j++) {
+            axisAligned &= i == j || glm::abs(linear[i][j]) <= FLATTEN_EPSILON * glm::length(linear[i]);
+        }
+    }
+
+    if (auto sphere = dynamic_cast<const Sphere *>(&geometry)) {
+        if (uniform) {
+            const SpherePrimitive &p = sphere->GetPrimitive();
+            return std::make_unique<Sphere>(apply(p.Position), p.Radius * scale, p.MaterialIndex);
+        }
+    } else if (auto box = dynamic_cast<const AABB *>(&geometry)) {
+        if (axisAligned) {
+            // a negative scale swaps the corners
+            const BoxPrimitive &p = box->GetPrimitive();
+            glm::vec3 a = apply(p.Min);
+            glm::vec3 b = apply(p.Max);
+            return std::make_unique<AABB>(glm::min(a, b), glm::max(a, b), p.MaterialIndex);
+        }
+    } else if (auto plane = dynamic_cast<const Plane *>(&geometry)) {
+        // the checkerboard pattern depends on the plane's axes and scale, only plain planes can be moved freely
+        const PlanePrimitive &p = plane->GetPrimitive();
+        if (uniform && p.Material.MaterialIndex2 == -1) {
+            return std::make_unique<Plane>(apply(p.Position), glm::normalize(linear * p.Normal), p.Material.MaterialIndex);
+        }
+    }
+
+    return nullptr;
+}
+
+void Scene::Compile() {
+    Compiled.Compile(Geometry);
+    BuildAccelerationStructure();
+    BuildLightSampler();
+}
+
+void Scene::BuildLightSampler() {
+    LightSelection.Build(Lights, RequestedLightSampling);
+    Emitters.Build(Compiled, Materials);
+}
+
+void Scene::BuildAccelerationStructure() {
+    static std::atomic<uint64_t> s_Versions = 0;
+    Version = ++s_Versions;
+
+    std::vector<Bounds> bounds;
+    std::vector<uint32_t> boundedGeometry;
+    bounds.reserve(Compiled.GetPrimitiveCount());
+    UnboundedGeometry.clear();
+
+    for (uint32_t i = 0; i < Compiled.GetPrimitiveCount(); i++) {
+        bounds.push_back(Compiled.GetBounds(i));
+
+        if (bounds.back().IsFinite()) {
+            boundedGeometry.push_back(i);
+        } else {
+            UnboundedGeometry.push_back(i);
+        }
+    }
+
+    // the grid is cheap to build and its occupancy feeds the cost model, so build it first when it may be used
+    AccelerationType type = RequestedAcceleration;
+    if (type == AccelerationType::Auto || type == AccelerationType::Grid) {
+        Grid.Build(bounds, boundedGeometry);
+    }
+    if (type == AccelerationType::Auto) {
+        type = Acceleration::Choose(boundedGeometry.size(), Grid.GetStatistics());
+    }
+    if (type != AccelerationType::Grid) {
+        Grid = UniformGrid();
+    }
+
+    BoundingVolumes = BVH();
+    if (type == AccelerationType::BVH) {
+        BoundingVolumes.Build(bounds, std::move(boundedGeometry));
+    }
+
+    Acceleration = type;
+    std::cout << "Acceleration structure: " << Acceleration::ToString(Acceleration)
+              << (RequestedAcceleration == AccelerationType::Auto ? " (auto)" : "") << std::endl;
+}
+
 Scene SceneLoader::LoadScene(const std::string &path) {
     toml::table table;
 
     // load scene file
     try {
-        table = toml::parse_file("scene.toml");
+        table = toml::parse_file(path);
     } catch (const toml::parse_error &err) {
-        std::cerr << "Failed to parse scene.toml: " << err << std::endl;
+        std::cerr << "Failed to parse " << path << ": " << err << std::endl;
         exit(1);
     }
 
@@ -326,6 +506,22 @@ Scene SceneLoader::LoadScene(const std::string &path) {
         scene.SkyColour = ParseVec3(skyColour);
     }
 
+    if (auto acceleration = table.get_as<std::string>("acceleration")) {
+        if (auto type = Acceleration::FromString(acceleration->get())) {
+            scene.RequestedAcceleration = *type;
+        } else {
+            std::cerr << "Unknown acceleration structure: " << acceleration->get() << ". using auto..." << std::endl;
+        }
+    }
+
+    if (auto lightSampling = table.get_as<std::string>("light_sampling")) {
+        if (auto type = LightSampling::FromString(lightSampling->get())) {
+            scene.RequestedLightSampling = *type;
+        } else {
+            std::cerr << "Unknown light sampling: " << lightSampling->get() << ". using auto..." << std::endl;
+        }
+    }
+
     // materials
     if (table["materials"].is_array()) {
         for (const auto &material : *table["materials"].as_array()) {
@@ -336,12 +532,30 @@ Scene SceneLoader::LoadScene(const std::string &path) {
         exit(1);
     }
 
+    // prototypes, must come before the geometry that instances them
+    ParseContext context;
+    if (table["prototypes"].is_array()) {
+        for (const auto &prototype : *table["prototypes"].as_array()) {
+            auto name = prototype.as_table()->get_as<std::string>("name");
+            auto geometry = prototype.as_table()->get_as<toml::table>("geometry");
+
+            if (!name || !geometry) {
+                std::cerr << "Invalid prototype, a name and a geometry are required. skipping..." << std::endl;
+                continue;
+            }
+
+            if (auto g = ParseGeometry(geometry, context)) {
+                context.Prototypes[name->get()] = std::move(g);
+            }
+        }
+    }
+
     // geometry
     if (table["geometry"].is_array()) {
         for (const auto &geometry : *table["geometry"].as_array()) {
-            auto g = ParseGeometry(geometry.as_table());
+            auto g = ParseGeometry(geometry.as_table(), context);
             if (g) {
-                scene.Geometry.push_back(g.release());
+                scene.Geometry.push_back(std::move(g));
             }
         }
     }
@@ -355,6 +569,11 @@ Scene SceneLoader::LoadScene(const std::string &path) {
         }
     }
 
+    scene.Prototypes = std::move(context.Prototypes);
+
+    FlattenGeometry(scene.Geometry);
+    scene.Compile();
+
     return scene;
 }
 
@@ -363,9 +582,9 @@ Camera SceneLoader::LoadCameraSettings(const std::string &path) {
 
     // load scene file
     try {
-        table = toml::parse_file("scene.toml");
+        table = toml::parse_file(path);
     } catch (const toml::parse_error &err) {
-        std::cerr << "Failed to parse scene.toml: " << err << std::endl;
+        std::cerr << "Failed to parse " << path << ": " << err << std::endl;
         exit(1);
     }
 
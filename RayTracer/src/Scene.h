@@ -1,19 +1,56 @@
 #pragma once
 
+#include "Acceleration/AccelerationStructure.h"
+#include "Acceleration/BVH.h"
+#include "Acceleration/UniformGrid.h"
 #include "Camera.h"
+#include "Compiled/CompiledScene.h"
 #include "Geometry/Geometry.h"
 #include "Light.h"
+#include "Lighting/EmitterSampler.h"
+#include "Lighting/LightSampler.h"
 #include "Material.h"
 #include "glm/glm.hpp"
 
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct Scene {
-    std::vector<Geometry *> Geometry;
+    std::vector<std::unique_ptr<Geometry>> Geometry;
     std::vector<Material> Materials;
     std::vector<Light> Lights;
     glm::vec3 SkyColour = {0.5f, 0.7f, 0.9f};
+
+    // named geometry shared by all instances that reference it
+    std::unordered_map<std::string, std::shared_ptr<const ::Geometry>> Prototypes;
+
+    // Geometry lowered for tracing, primitive indices below refer to it
+    CompiledScene Compiled;
+
+    // acceleration structure over the bounded geometry, unbounded geometry (e.g. planes) is tested separately
+    AccelerationType RequestedAcceleration = AccelerationType::Auto; // set by the scene file
+    AccelerationType Acceleration = AccelerationType::Linear;        // backend in use after the build
+    BVH BoundingVolumes;
+    UniformGrid Grid;
+    std::vector<uint32_t> UnboundedGeometry;
+    // changes with every build of the acceleration structures and is never shared by two scenes, so copies of the
+    // compiled scene can tell when they are stale
+    uint64_t Version = 0;
+
+    // picks the lights sampled at each bounce
+    LightSamplingType RequestedLightSampling = LightSamplingType::Auto; // set by the scene file
+    LightSampler LightSelection;
+    // emissive spheres and boxes, sampled directly at each bounce
+    EmitterSampler Emitters;
+
+    /// Recompile the geometry and rebuild the acceleration structures, must be called whenever Geometry changes.
+    void Compile();
+    /// Rebuild the acceleration structures over the compiled geometry.
+    void BuildAccelerationStructure();
+    /// Rebuild the light and emitter sampling structures, must be called whenever Lights or Materials change.
+    void BuildLightSampler();
 };
 
 namespace SceneLoader {
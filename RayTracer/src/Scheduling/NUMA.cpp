@@ -0,0 +1,191 @@
+#include "NUMA.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2u << 20)
+
+namespace {
+/// Parses a CPU list such as "0-7,16-23".
+std::vector<uint32_t> ParseCpuList(const std::string &list) {
+    std::vector<uint32_t> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            uint32_t first = (uint32_t)std::stoul(range.substr(0, dash));
+            uint32_t last = dash == std::string::npos ? first : (uint32_t)std::stoul(range.substr(dash + 1));
+            for (uint32_t cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception &) {
+            // blank or malformed entry
+        }
+    }
+    return cpus;
+}
+
+NUMA::Topology DetectTopology() {
+    NUMA::Topology topology;
+
+#if defined(__linux__)
+    std::error_code error;
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> nodes;
+    for (const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return std::isdigit((unsigned char)c); })) {
+            continue;
+        }
+
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        std::getline(file, list);
+        std::vector<uint32_t> cpus = ParseCpuList(list);
+        if (!cpus.empty()) { // memory-only nodes have no CPUs to run workers on
+            nodes.emplace_back((uint32_t)std::stoul(name.substr(4)), std::move(cpus));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+    for (auto &[node, cpus] : nodes) {
+        topology.NodeCpus.push_back(std::move(cpus));
+    }
+#endif
+
+    if (topology.NodeCpus.empty()) {
+        std::vector<uint32_t> cpus(std::max(std::thread::hardware_concurrency(), 1u));
+        for (uint32_t i = 0; i < cpus.size(); i++) {
+            cpus[i] = i;
+        }
+        topology.NodeCpus.push_back(std::move(cpus));
+    }
+
+    if (const char *simulated = std::getenv("RAYTRACER_NUMA_NODES")) {
+        uint32_t nodeCount = (uint32_t)std::max(std::atoi(simulated), 1);
+        std::vector<uint32_t> cpus;
+        for (const auto &node : topology.NodeCpus) {
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        }
+        topology.NodeCpus.assign(nodeCount, {});
+        for (uint32_t i = 0; i < cpus.size(); i++) {
+            topology.NodeCpus[(uint64_t)i * nodeCount / cpus.size()].push_back(cpus[i]);
+        }
+        // a node needs at least one CPU, they may repeat when simulating more nodes than there are CPUs
+        for (uint32_t node = 0; node < nodeCount; node++) {
+            if (topology.NodeCpus[node].empty()) {
+                topology.NodeCpus[node].push_back(cpus[node % cpus.size()]);
+            }
+        }
+    }
+
+    return topology;
+}
+} // namespace
+
+const NUMA::Topology &NUMA::GetTopology() {
+    static const Topology topology = [] {
+        Topology detected = DetectTopology();
+        std::cout << "NUMA nodes: " << detected.GetNodeCount() << std::endl;
+        return detected;
+    }();
+    return topology;
+}
+
+int NUMA::GetPageNode(const void *address) {
+#if defined(__linux__) && defined(SYS_move_pages)
+    // move_pages without target nodes only reports where each page is
+    void *page = reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(address) & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1));
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) != 0) {
+        return -1;
+    }
+    return status >= 0 ? status : -1;
+#else
+    (void)address;
+    return -1;
+#endif
+}
+
+void *NUMA::AllocatePages(size_t bytes, bool hugePages) {
+#if defined(__linux__)
+    if (!hugePages) {
+        void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    // mmap only aligns to the base page size, and huge pages can only back whole aligned 2 MiB blocks: map one block
+    // more than needed and unmap what lies outside the aligned range
+    bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    size_t mapped = bytes + HUGE_PAGE_SIZE;
+    void *mapping = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+    uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (aligned > start) {
+        munmap(mapping, aligned - start);
+    }
+    if (start + mapped > aligned + bytes) {
+        munmap(reinterpret_cast<void *>(aligned + bytes), start + mapped - (aligned + bytes));
+    }
+    void *memory = reinterpret_cast<void *>(aligned);
+#if defined(MADV_HUGEPAGE)
+    if (madvise(memory, bytes, MADV_HUGEPAGE) != 0) {
+        std::cerr << "Huge pages not available. skipping..." << std::endl;
+    }
+#endif
+    return memory;
+#elif defined(_WIN32)
+    // committed pages are only backed by memory once touched; large pages would be placed at allocation time instead,
+    // so they aren't used here
+    (void)hugePages;
+    void *memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+#else
+    (void)hugePages;
+    return ::operator new(bytes, std::align_val_t(4096));
+#endif
+}
+
+void NUMA::FreePages(void *memory, size_t bytes, bool hugePages) {
+#if defined(__linux__)
+    // the size must match the mapping, which AllocatePages rounded up to whole huge pages
+    if (hugePages) {
+        bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+    munmap(memory, bytes);
+#elif defined(_WIN32)
+    (void)bytes;
+    (void)hugePages;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    (void)bytes;
+    (void)hugePages;
+    ::operator delete(memory, std::align_val_t(4096));
+#endif
+}
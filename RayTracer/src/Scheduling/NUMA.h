@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace NUMA {
+/// Memory nodes and the CPUs attached to each. Machines without NUMA, and platforms where it isn't detected, have a
+/// single node with every CPU.
+struct Topology {
+    std::vector<std::vector<uint32_t>> NodeCpus;
+
+    uint32_t GetNodeCount() const { return (uint32_t)NodeCpus.size(); }
+};
+
+/// Topology of this machine, read from /sys/devices/system/node on Linux the first time it's needed. Setting the
+/// RAYTRACER_NUMA_NODES environment variable splits the CPUs into that many nodes instead, to exercise the node-aware
+/// scheduling on a single node machine (memory placement is unaffected).
+const Topology &GetTopology();
+
+/// Node whose memory holds the page containing the address, or -1 if unknown (the page hasn't been touched yet, or the
+/// platform can't tell).
+int GetPageNode(const void *address);
+
+/// Node owning row y of an image, the rows are split into one contiguous band per node.
+inline uint32_t NodeOfRow(uint32_t y, uint32_t height, uint32_t nodeCount) {
+    return height > 0 ? (uint32_t)((uint64_t)y * nodeCount / height) : 0;
+}
+
+/**
+ * Allocates page-aligned memory without touching it, so the OS places each page on the node of the thread that writes
+ * to it first.
+ * @param hugePages Ask for 2 MiB pages where the OS supports them transparently (Linux), fewer TLB misses over large
+ * buffers.
+ */
+void *AllocatePages(size_t bytes, bool hugePages);
+/// Releases memory from AllocatePages, with the same size and page kind.
+void FreePages(void *memory, size_t bytes, bool hugePages);
+
+/// Array in memory from AllocatePages. The elements start uninitialised: whoever writes them first decides where they
+/// live, so fill each part from a thread of the node that will use it.
+template <typename T> class PageBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "page buffers are filled and copied as raw memory");
+
+  public:
+    PageBuffer() = default;
+    ~PageBuffer() { Free(); }
+
+    PageBuffer(const PageBuffer &other) { *this = other; }
+    PageBuffer &operator=(const PageBuffer &other) {
+        if (this != &other) {
+            Allocate(other.m_Count, other.m_HugePages);
+            if (m_Count > 0) {
+                std::memcpy(m_Data, other.m_Data, m_Count * sizeof(T));
+            }
+        }
+        return *this;
+    }
+    PageBuffer(PageBuffer &&other) noexcept { *this = std::move(other); }
+    PageBuffer &operator=(PageBuffer &&other) noexcept {
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Count, other.m_Count);
+        std::swap(m_HugePages, other.m_HugePages);
+        return *this;
+    }
+
+    /// Replaces the contents with count uninitialised elements.
+    void Allocate(size_t count, bool hugePages = false) {
+        Free();
+        m_Data = count > 0 ? static_cast<T *>(AllocatePages(count * sizeof(T), hugePages)) : nullptr;
+        m_Count = count;
+        m_HugePages = hugePages;
+    }
+
+    void Free() {
+        if (m_Data) {
+            FreePages(m_Data, m_Count * sizeof(T), m_HugePages);
+        }
+        m_Data = nullptr;
+        m_Count = 0;
+    }
+
+    T *Data() { return m_Data; }
+    const T *Data() const { return m_Data; }
+    size_t Size() const { return m_Count; }
+    bool UsesHugePages() const { return m_HugePages; }
+
+    T &operator[](size_t i) { return m_Data[i]; }
+    const T &operator[](size_t i) const { return m_Data[i]; }
+
+  private:
+    T *m_Data = nullptr;
+    size_t m_Count = 0;
+    bool m_HugePages = false;
+};
+} // namespace NUMA
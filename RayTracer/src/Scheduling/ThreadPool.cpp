@@ -0,0 +1,198 @@
+#include "ThreadPool.h"
+
+#include "NUMA.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+thread_local uint32_t s_CurrentNode = 0;
+
+/// Restricts the thread to the CPUs, false if the platform doesn't support it.
+bool SetAffinity(std::thread::native_handle_type thread, const std::vector<uint32_t> &cpus) {
+#if defined(_WIN32)
+    // a plain affinity mask only covers the first 64 processors
+    DWORD_PTR mask = 0;
+    for (uint32_t cpu : cpus) {
+        if (cpu < 64) {
+            mask |= (DWORD_PTR)1 << cpu;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(thread, mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (uint32_t cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+#else
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
+}
+
+/// Handle of the calling thread, as SetAffinity takes it.
+std::thread::native_handle_type CurrentThread() {
+#if defined(_WIN32)
+    return GetCurrentThread();
+#elif defined(__linux__)
+    return pthread_self();
+#else
+    return std::thread::native_handle_type();
+#endif
+}
+
+/// The CPUs without the one given.
+std::vector<uint32_t> Without(std::vector<uint32_t> cpus, uint32_t cpu) {
+    cpus.erase(std::remove(cpus.begin(), cpus.end(), cpu), cpus.end());
+    return cpus;
+}
+} // namespace
+
+ThreadPool::~ThreadPool() { Stop(); }
+
+uint32_t ThreadPool::GetCurrentNode() { return s_CurrentNode; }
+
+void ThreadPool::Start(const Settings &settings) {
+    Stop();
+    m_Settings = settings;
+
+    // cores in node order, minus the first one if it's reserved for the main thread
+    const NUMA::Topology &topology = NUMA::GetTopology();
+    std::vector<std::pair<uint32_t, uint32_t>> cores; // core, node
+    std::vector<uint32_t> allCpus;
+    for (uint32_t node = 0; node < topology.GetNodeCount(); node++) {
+        for (uint32_t cpu : topology.NodeCpus[node]) {
+            cores.emplace_back(cpu, node);
+            allCpus.push_back(cpu);
+        }
+    }
+    bool reserve = settings.ReserveCore && cores.size() > 1;
+    uint32_t reservedCpu = cores.empty() ? 0 : cores.front().first;
+    if (reserve) {
+        cores.erase(cores.begin());
+    }
+    uint32_t workerCount = settings.WorkerCount > 0 ? settings.WorkerCount : (uint32_t)cores.size();
+
+    // spread evenly over the cores, so each node gets workers in proportion to its cores
+    std::vector<uint32_t> workerCores(workerCount);
+    m_WorkerNodes.resize(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        size_t core = workerCount <= cores.size() ? (uint64_t)i * cores.size() / workerCount : i % cores.size();
+        workerCores[i] = cores[core].first;
+        m_WorkerNodes[i] = cores[core].second;
+    }
+
+    m_Stopping = false;
+    m_Generation = 0;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        m_Threads.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+
+    // pinned workers stay on their core, otherwise they only stay on their node so their memory stays local; either
+    // way they are kept off the reserved core, or the scheduler would still run them there
+    bool bind = settings.PinThreads || topology.GetNodeCount() > 1 || reserve;
+    bool bound = true;
+    for (uint32_t i = 0; i < workerCount && bind; i++) {
+        if (settings.PinThreads) {
+            bound &= SetAffinity(m_Threads[i].native_handle(), {workerCores[i]});
+        } else {
+            const std::vector<uint32_t> &cpus = topology.GetNodeCount() > 1 ? topology.NodeCpus[m_WorkerNodes[i]] : allCpus;
+            std::vector<uint32_t> allowed = reserve ? Without(cpus, reservedCpu) : cpus;
+            bound &= SetAffinity(m_Threads[i].native_handle(), allowed.empty() ? cpus : allowed);
+        }
+    }
+    if (bind && !bound) {
+        std::cerr << "Could not bind render threads to their cores. skipping..." << std::endl;
+    }
+
+    // the calling thread runs the application's main loop, it gets the reserved core to itself, and is given every
+    // core back once nothing is reserved any more
+    if (reserve) {
+        m_CallerPinned = SetAffinity(CurrentThread(), {reservedCpu});
+    } else if (m_CallerPinned) {
+        SetAffinity(CurrentThread(), allCpus);
+        m_CallerPinned = false;
+    }
+
+    std::cout << "Render threads: " << workerCount << (settings.PinThreads && bound ? " (pinned)" : "")
+              << (m_CallerPinned ? ", main thread on core " + std::to_string(reservedCpu) : std::string()) << std::endl;
+}
+
+void ThreadPool::Stop() {
+    if (m_Threads.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_JobReady.notify_all();
+
+    for (std::thread &thread : m_Threads) {
+        thread.join();
+    }
+    m_Threads.clear();
+}
+
+void ThreadPool::Run(const std::function<void(uint32_t worker)> &job) {
+    if (m_Threads.empty()) {
+        Start(m_Settings);
+    }
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Job = &job;
+    m_Remaining = (uint32_t)m_Threads.size();
+    m_Generation++;
+    m_JobReady.notify_all();
+
+    m_JobDone.wait(lock, [this]() { return m_Remaining == 0; });
+    m_Job = nullptr;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)> &function) {
+    std::atomic<uint32_t> next = 0;
+    Run([&](uint32_t) {
+        for (uint32_t i = next++; i < count; i = next++) {
+            function(i);
+        }
+    });
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker) {
+    s_CurrentNode = m_WorkerNodes[worker];
+    uint64_t generation = 0;
+
+    while (true) {
+        const std::function<void(uint32_t)> *job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_JobReady.wait(lock, [&]() { return m_Stopping || m_Generation != generation; });
+            if (m_Stopping) {
+                return;
+            }
+            generation = m_Generation;
+            job = m_Job;
+        }
+
+        (*job)(worker);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (--m_Remaining == 0) {
+            m_JobDone.notify_one();
+        }
+    }
+}
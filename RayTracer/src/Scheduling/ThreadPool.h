@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Worker threads that live as long as the pool and sleep between jobs, so starting a job costs one wake-up per thread
+/// instead of creating threads or a parallel algorithm invocation per frame.
+class ThreadPool {
+  public:
+    struct Settings {
+        uint32_t WorkerCount = 0; // 0 uses every core, minus the reserved one
+        bool PinThreads = false;  // bind worker i to its own core, otherwise workers are only bound to their NUMA node
+        bool ReserveCore = true;  // leave the first core to the thread calling Start, and keep the workers off it
+
+        bool operator==(const Settings &other) const {
+            return WorkerCount == other.WorkerCount && PinThreads == other.PinThreads && ReserveCore == other.ReserveCore;
+        }
+        bool operator!=(const Settings &other) const { return !(*this == other); }
+    };
+
+  public:
+    ThreadPool() = default;
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// Stops the current workers, if any, and starts new ones with the settings. Must be called from the application's
+    /// main thread, which is bound to the reserved core.
+    void Start(const Settings &settings);
+    /// Runs job(worker) once on every worker and returns when all of them are done. The calling thread only waits.
+    void Run(const std::function<void(uint32_t worker)> &job);
+    /// Calls function(i) for every i in [0, count), spread over the workers.
+    void ParallelFor(uint32_t count, const std::function<void(uint32_t)> &function);
+
+    bool IsRunning() const { return !m_Threads.empty(); }
+    uint32_t GetWorkerCount() const { return (uint32_t)m_Threads.size(); }
+    /// NUMA node the worker runs on, workers are spread over the nodes in proportion to their cores.
+    uint32_t GetWorkerNode(uint32_t worker) const { return m_WorkerNodes[worker]; }
+    /// Node of the calling worker, 0 when called from a thread outside any pool.
+    static uint32_t GetCurrentNode();
+    const Settings &GetSettings() const { return m_Settings; }
+
+  private:
+    void Stop();
+    void WorkerLoop(uint32_t worker);
+
+  private:
+    Settings m_Settings;
+    std::vector<std::thread> m_Threads;
+    std::vector<uint32_t> m_WorkerNodes;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_JobReady;
+    std::condition_variable m_JobDone;
+    const std::function<void(uint32_t)> *m_Job = nullptr;
+    uint64_t m_Generation = 0; // incremented for every job, workers run each generation once
+    uint32_t m_Remaining = 0;  // workers still running the current job
+    bool m_Stopping = false;
+    // the thread calling Start was bound to the reserved core
+    bool m_CallerPinned = false;
+};
@@ -0,0 +1,189 @@
+#include "TileScheduler.h"
+
+#include "NUMA.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace {
+/// Distance along the Hilbert curve filling an n x n grid (n a power of two) of the cell (x, y).
+uint32_t HilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        // rotate the quadrant so the curve inside it starts and ends next to its neighbours
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+} // namespace
+
+std::vector<Tile> MakeTiles(uint32_t width, uint32_t height, uint32_t tileSize, uint32_t nodeCount) {
+    uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    uint32_t tilesY = (height + tileSize - 1) / tileSize;
+
+    // the curve covers the smallest power of two grid around the tiles, cells outside the image are skipped
+    uint32_t n = 1;
+    while (n < tilesX || n < tilesY) {
+        n *= 2;
+    }
+
+    std::vector<std::pair<uint32_t, Tile>> ordered;
+    ordered.reserve(tilesX * tilesY);
+    for (uint32_t ty = 0; ty < tilesY; ty++) {
+        for (uint32_t tx = 0; tx < tilesX; tx++) {
+            Tile tile;
+            tile.X = tx * tileSize;
+            tile.Y = ty * tileSize;
+            tile.Width = std::min(tileSize, width - tile.X);
+            tile.Height = std::min(tileSize, height - tile.Y);
+            tile.Node = NUMA::NodeOfRow(tile.Y, height, nodeCount);
+            ordered.emplace_back(HilbertIndex(n, tx, ty), tile);
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(ordered.size());
+    for (const auto &[index, tile] : ordered) {
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+void TileScheduler::Run(const std::vector<Tile> &tiles, ThreadPool &pool, const std::function<void(const Tile &)> &render) {
+    if (!pool.IsRunning()) {
+        pool.Start(pool.GetSettings());
+    }
+
+    uint32_t workerCount = pool.GetWorkerCount();
+    if (m_Workers.size() != workerCount) {
+        m_Workers.clear();
+        for (uint32_t i = 0; i < workerCount; i++) {
+            m_Workers.push_back(std::make_unique<Worker>());
+        }
+    }
+
+    // group the workers and the tiles by node, nodes without workers share all of them
+    uint32_t nodeCount = 1;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        nodeCount = std::max(nodeCount, pool.GetWorkerNode(i) + 1);
+    }
+    for (const Tile &tile : tiles) {
+        nodeCount = std::max(nodeCount, tile.Node + 1);
+    }
+    std::vector<std::vector<uint32_t>> nodeWorkers(nodeCount), nodeTiles(nodeCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        nodeWorkers[pool.GetWorkerNode(i)].push_back(i);
+    }
+    for (uint32_t tile = 0; tile < tiles.size(); tile++) {
+        nodeTiles[tiles[tile].Node].push_back(tile);
+    }
+    std::vector<uint32_t> allWorkers(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        allWorkers[i] = i;
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        Worker &worker = *m_Workers[i];
+        worker.Tiles.clear();
+        worker.BusyTime = 0.0;
+        worker.Steals = 0;
+        worker.RemoteTiles = 0;
+        worker.Node = pool.GetWorkerNode(i);
+    }
+
+    // contiguous runs of each node's part of the curve, so each worker renders one region and steals only at the end
+    for (uint32_t node = 0; node < nodeCount; node++) {
+        const std::vector<uint32_t> &owners = nodeWorkers[node].empty() ? allWorkers : nodeWorkers[node];
+        const std::vector<uint32_t> &own = nodeTiles[node];
+        for (size_t i = 0; i < owners.size(); i++) {
+            Worker &worker = *m_Workers[owners[i]];
+            for (size_t tile = own.size() * i / owners.size(); tile < own.size() * (i + 1) / owners.size(); tile++) {
+                worker.Tiles.push_back(own[tile]);
+            }
+        }
+    }
+    m_TileTimes.assign(tiles.size(), 0.0f);
+
+    auto start = std::chrono::steady_clock::now();
+
+    pool.Run([&](uint32_t worker) { Work(worker, tiles, render); });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    m_Statistics = Statistics();
+    m_Statistics.WorkerCount = workerCount;
+    double busyTime = 0.0;
+    for (const auto &worker : m_Workers) {
+        busyTime += worker->BusyTime;
+        m_Statistics.Steals += worker->Steals;
+        m_Statistics.RemoteTiles += worker->RemoteTiles;
+    }
+    if (!m_TileTimes.empty()) {
+        m_Statistics.SlowestTile = *std::max_element(m_TileTimes.begin(), m_TileTimes.end());
+    }
+    if (elapsed > 0.0) {
+        m_Statistics.Utilisation = (float)(busyTime / (elapsed * workerCount));
+    }
+}
+
+void TileScheduler::Work(uint32_t worker, const std::vector<Tile> &tiles,
+                         const std::function<void(const Tile &)> &render) {
+    uint32_t tile;
+    while (Pop(worker, tile) || Steal(worker, tile)) {
+        auto start = std::chrono::steady_clock::now();
+        render(tiles[tile]);
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        m_TileTimes[tile] = (float)(time * 1000.0);
+        m_Workers[worker]->BusyTime += time;
+        if (tiles[tile].Node != m_Workers[worker]->Node) {
+            m_Workers[worker]->RemoteTiles++;
+        }
+    }
+}
+
+bool TileScheduler::Pop(uint32_t worker, uint32_t &tile) {
+    Worker &own = *m_Workers[worker];
+    std::lock_guard<std::mutex> lock(own.Mutex);
+    if (own.Tiles.empty()) {
+        return false;
+    }
+    tile = own.Tiles.front();
+    own.Tiles.pop_front();
+    return true;
+}
+
+bool TileScheduler::Steal(uint32_t thief, uint32_t &tile) {
+    // tiles are never added during a run, so once every deque has been seen empty there is nothing left to do; victims
+    // on the thief's own node come first, their tiles are in local memory
+    uint32_t node = m_Workers[thief]->Node;
+    for (bool local : {true, false}) {
+        for (size_t i = 1; i < m_Workers.size(); i++) {
+            Worker &victim = *m_Workers[(thief + i) % m_Workers.size()];
+            if ((victim.Node == node) != local) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(victim.Mutex);
+            if (!victim.Tiles.empty()) {
+                // the back is farthest along the curve from where the victim is working
+                tile = victim.Tiles.back();
+                victim.Tiles.pop_back();
+                m_Workers[thief]->Steals++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Rectangle of pixels rendered as one task, square except at the right and bottom edges of the image.
+struct Tile {
+    uint32_t X, Y;
+    uint32_t Width, Height;
+    uint32_t Node = 0; // NUMA node whose memory holds the tile's rows
+};
+
+/**
+ * Splits the image into tiles, ordered along a Hilbert curve so that consecutive tiles are neighbours.
+ * @param tileSize Width and height of the tiles, in pixels.
+ * @param nodeCount NUMA nodes the rows of the image are split between, see NUMA::NodeOfRow.
+ */
+std::vector<Tile> MakeTiles(uint32_t width, uint32_t height, uint32_t tileSize, uint32_t nodeCount = 1);
+
+/// Runs a function over a list of tiles on the threads of a pool. Each worker starts with a contiguous run of the
+/// tiles of its NUMA node and takes them from the front of its own deque; a worker that runs out steals from the back of
+/// another's, trying workers of its own node first, so a few slow tiles don't leave the other threads idle.
+class TileScheduler {
+  public:
+    struct Statistics {
+        uint32_t WorkerCount = 0;
+        uint32_t Steals = 0;       // tiles run by a worker other than the one they were given to
+        uint32_t RemoteTiles = 0;  // tiles run by a worker on another NUMA node than the tile's
+        float SlowestTile = 0.0f;  // ms
+        float Utilisation = 0.0f;  // time the workers spent rendering over the time they were running
+    };
+
+  public:
+    /// Runs render on every tile with the pool's workers and returns once all of them are done.
+    void Run(const std::vector<Tile> &tiles, ThreadPool &pool, const std::function<void(const Tile &)> &render);
+
+    /// Time each tile of the last run took, in ms, in the order of the tiles.
+    const std::vector<float> &GetTileTimes() const { return m_TileTimes; }
+    const Statistics &GetStatistics() const { return m_Statistics; }
+
+  private:
+    struct Worker {
+        std::mutex Mutex;
+        std::deque<uint32_t> Tiles;
+        double BusyTime = 0.0; // seconds
+        uint32_t Steals = 0;
+        uint32_t RemoteTiles = 0;
+        uint32_t Node = 0;
+    };
+
+    /// Work loop of one worker, returns when no tiles are left anywhere.
+    void Work(uint32_t worker, const std::vector<Tile> &tiles, const std::function<void(const Tile &)> &render);
+    bool Pop(uint32_t worker, uint32_t &tile);
+    bool Steal(uint32_t thief, uint32_t &tile);
+
+  private:
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+    std::vector<float> m_TileTimes;
+    Statistics m_Statistics;
+};
@@ -0,0 +1,101 @@
+#include "BSDF.h"
+
+#include "../SIMD/Kernels.h"
+#include "../Sampling/Warp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+// specular reflectance of dielectrics at normal incidence, an index of refraction of 1.5
+#define DIELECTRIC_REFLECTANCE 0.04f
+// smoothest lobe, the distribution of perfect mirrors has no density to evaluate
+#define MIN_ALPHA 0.001f
+
+namespace {
+/// Schlick's approximation of the Fresnel reflectance.
+glm::vec3 Fresnel(const glm::vec3 &reflectance, float cosine) {
+    float m = 1.0f - std::min(std::max(cosine, 0.0f), 1.0f);
+    float m5 = m * m * m * m * m;
+    return reflectance + (1.0f - reflectance) * m5;
+}
+} // namespace
+
+BSDF::BSDF(const Material &material, const glm::vec3 &normal, const glm::vec3 &outgoing)
+    : m_Normal(normal), m_Outgoing(outgoing), m_CosOutgoing(glm::dot(normal, outgoing)) {
+    Warp::TangentFrame(normal, m_Tangent, m_Bitangent);
+
+    float metallic = glm::clamp(material.Metallic, 0.0f, 1.0f);
+    float roughness = glm::clamp(material.Roughness, 0.0f, 1.0f);
+    m_Diffuse = material.Albedo * (1.0f - metallic) * glm::one_over_pi<float>();
+    m_Reflectance = glm::mix(glm::vec3(DIELECTRIC_REFLECTANCE), material.Albedo, metallic);
+    m_Alpha = std::max(roughness * roughness, MIN_ALPHA);
+
+    // the lobes are picked by how much light they reflect towards the viewer; seen from below the surface (an edge
+    // hit at a grazing angle) the microfacets are all hidden and only the diffuse lobe is left
+    float specular = m_CosOutgoing > 0.0f ? SIMD::Luminance(Fresnel(m_Reflectance, m_CosOutgoing)) : 0.0f;
+    float diffuse = SIMD::Luminance(m_Diffuse) * glm::pi<float>() * (1.0f - specular);
+    m_SpecularProbability = specular + diffuse > 0.0f ? specular / (specular + diffuse) : 0.0f;
+}
+
+glm::vec3 BSDF::Evaluate(const glm::vec3 &incoming) const {
+    float cosIncoming = glm::dot(m_Normal, incoming);
+    if (cosIncoming <= 0.0f) {
+        return glm::vec3(0.0f);
+    }
+    if (m_CosOutgoing <= 0.0f) {
+        return m_Diffuse * cosIncoming;
+    }
+
+    // light the microfacets reflect is taken from the base
+    glm::vec3 halfVector = glm::normalize(m_Outgoing + incoming);
+    glm::vec3 fresnel = Fresnel(m_Reflectance, glm::dot(m_Outgoing, halfVector));
+    float shadowing = 1.0f / (1.0f + Lambda(m_CosOutgoing) + Lambda(cosIncoming));
+    glm::vec3 specular = fresnel * (Distribution(glm::dot(m_Normal, halfVector)) * shadowing /
+                                    (4.0f * m_CosOutgoing * cosIncoming));
+    return (m_Diffuse * (1.0f - fresnel) + specular) * cosIncoming;
+}
+
+float BSDF::Pdf(const glm::vec3 &incoming) const {
+    float cosIncoming = glm::dot(m_Normal, incoming);
+    if (cosIncoming <= 0.0f) {
+        return 0.0f;
+    }
+
+    float pdf = (1.0f - m_SpecularProbability) * cosIncoming * glm::one_over_pi<float>();
+    if (m_SpecularProbability > 0.0f) {
+        // visible normal density D * G1 * cos / cosOutgoing, over the 4 cos of the reflection's Jacobian
+        glm::vec3 halfVector = glm::normalize(m_Outgoing + incoming);
+        pdf += m_SpecularProbability * Distribution(glm::dot(m_Normal, halfVector)) /
+               ((1.0f + Lambda(m_CosOutgoing)) * 4.0f * m_CosOutgoing);
+    }
+    return pdf;
+}
+
+glm::vec3 BSDF::SampleSpecular(const glm::vec2 &u) const {
+    // outgoing direction in the frame of the normal, stretched so the lobe becomes a hemisphere
+    glm::vec3 local(glm::dot(m_Outgoing, m_Tangent), glm::dot(m_Outgoing, m_Bitangent), m_CosOutgoing);
+    glm::vec3 stretched = glm::normalize(glm::vec3(m_Alpha * local.x, m_Alpha * local.y, local.z));
+
+    // the visible normals of a hemisphere are the outgoing direction plus a uniform point on the spherical cap below it
+    float phi = glm::two_pi<float>() * u.x;
+    float z = (1.0f - u.y) * (1.0f + stretched.z) - stretched.z;
+    float sinTheta = std::sqrt(std::min(std::max(1.0f - z * z, 0.0f), 1.0f));
+    glm::vec3 halfVector = stretched + glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), z);
+    halfVector = glm::normalize(glm::vec3(m_Alpha * halfVector.x, m_Alpha * halfVector.y, halfVector.z));
+
+    glm::vec3 microfacet = m_Tangent * halfVector.x + m_Bitangent * halfVector.y + m_Normal * halfVector.z;
+    return glm::normalize(2.0f * glm::dot(m_Outgoing, microfacet) * microfacet - m_Outgoing);
+}
+
+float BSDF::Distribution(float cosine) const {
+    float alpha2 = m_Alpha * m_Alpha;
+    float d = cosine * cosine * (alpha2 - 1.0f) + 1.0f;
+    return alpha2 / (glm::pi<float>() * d * d);
+}
+
+float BSDF::Lambda(float cosine) const {
+    float cos2 = cosine * cosine;
+    float tan2 = std::max(1.0f - cos2, 0.0f) / cos2;
+    return 0.5f * (std::sqrt(1.0f + m_Alpha * m_Alpha * tan2) - 1.0f);
+}
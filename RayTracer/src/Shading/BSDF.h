@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../Material.h"
+
+#include <glm/glm.hpp>
+
+/// Reflection off an opaque surface with the metallic-roughness parameters of its material: a Lambertian base under a
+/// GGX microfacet lobe (Walter et al. 2007) with Schlick's Fresnel term. Dielectrics reflect 4% specularly at normal
+/// incidence and diffuse the rest, metals have no diffuse base and tint the specular lobe with their albedo.
+///
+/// Directions are unit vectors pointing away from the surface. The specular lobe is sampled by the normals visible from
+/// the outgoing direction, so the samples follow the lobe's shape whatever its roughness.
+class BSDF {
+  public:
+    /**
+     * @param normal Unit surface normal.
+     * @param outgoing Unit direction towards the viewer, the opposite of the ray that found the surface.
+     */
+    BSDF(const Material &material, const glm::vec3 &normal, const glm::vec3 &outgoing);
+
+    /// Reflected radiance per unit of radiance arriving from the incoming direction, times its cosine to the normal.
+    glm::vec3 Evaluate(const glm::vec3 &incoming) const;
+    /// Probability per unit solid angle of sampling the incoming direction, with both lobes combined.
+    float Pdf(const glm::vec3 &incoming) const;
+
+    /// Chance of sampling the specular lobe instead of the diffuse one, following their reflectance.
+    float GetSpecularProbability() const { return m_SpecularProbability; }
+    /// Mirror direction about a microfacet normal picked among those visible from the outgoing direction (Dupuy and
+    /// Benyoub 2023). It may point below the surface, where the BSDF is 0.
+    glm::vec3 SampleSpecular(const glm::vec2 &u) const;
+
+    const glm::vec3 &GetNormal() const { return m_Normal; }
+
+  private:
+    /// GGX distribution of microfacet normals, by the cosine of their angle to the normal.
+    float Distribution(float cosine) const;
+    /// Smith's Lambda for the direction, shadowing and masking are 1 / (1 + Lambda).
+    float Lambda(float cosine) const;
+
+  private:
+    glm::vec3 m_Normal, m_Tangent, m_Bitangent;
+    glm::vec3 m_Outgoing;
+    float m_CosOutgoing;
+
+    glm::vec3 m_Diffuse;     // albedo / pi of the base
+    glm::vec3 m_Reflectance; // specular reflectance at normal incidence
+    float m_Alpha;           // roughness squared
+    float m_SpecularProbability;
+};